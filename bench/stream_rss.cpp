@@ -0,0 +1,94 @@
+// Peak memory of a grid contoured as a stream of row strips: the grid, nrow x ncol values
+// (100000 x 100000 by default, 80 GB as doubles), is never held in memory; every strip is
+// generated just before it is pushed, and the rings taken after every push are only
+// counted. With a memory budget, the peak resident set depends on the budget and the
+// number of columns, but not on the number of rows; compare runs with different nrow.
+//
+// g++ -std=c++11 -O2 -pthread -Isrc bench/stream_rss.cpp src/isoband.cpp src/classify.cpp \
+//   src/polygon.cpp src/grid_file.cpp -o stream_rss
+// ./stream_rss [ncol] [nrow] [budget_mb] [n_bands]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <sys/resource.h>
+using namespace std;
+
+#include "isoband.h"
+
+// peak resident set size of the process in MB
+static double peak_rss_mb() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1048576.0;
+#else
+  return usage.ru_maxrss / 1024.0;
+#endif
+}
+
+int main(int argc, char **argv) {
+  int ncol = argc > 1 ? atoi(argv[1]) : 100000;
+  int nrow = argc > 2 ? atoi(argv[2]) : ncol;
+  long long budget = (argc > 3 ? atoll(argv[3]) : 256) << 20;
+  int n_bands = argc > 4 ? atoi(argv[4]) : 2;
+
+  // z = a(r) + b(c): a lattice of closed rings a few hundred grid points across, so that
+  // rings keep closing and the open boundary stays small
+  vector<double> x(ncol), y(nrow), a(nrow), b(ncol);
+  for (int r = 0; r < nrow; r++) {
+    y[r] = r;
+    a[r] = cos(r * 0.021) + 0.3 * sin(r * 0.0037);
+  }
+  for (int c = 0; c < ncol; c++) {
+    x[c] = c;
+    b[c] = cos(c * 0.017) + 0.3 * sin(c * 0.0051);
+  }
+  vector<double> lo(n_bands), hi(n_bands);
+  for (int i = 0; i < n_bands; i++) {
+    lo[i] = -2.6 + 5.2 * i / n_bands;
+    hi[i] = lo[i] + 2.6 / n_bands;
+  }
+
+  auto t0 = chrono::steady_clock::now();
+  isoband_stream *stream = isoband_stream_create(&x[0], ncol, &y[0], nrow, value_double, 0, 1, &lo[0], &hi[0], n_bands, budget);
+  if (!stream) {
+    fprintf(stderr, "%s\n", isoband_last_error());
+    return 1;
+  }
+
+  vector<double> strip;
+  long long points = 0, max_memory = 0;
+  int n_strips = 0, max_rows = 0;
+  for (int r0 = 0; r0 < nrow - 1; ) {
+    int n_rows = isoband_stream_strip_rows(stream);
+    strip.resize(static_cast<size_t>(n_rows) * ncol);
+    for (int r = 0; r < n_rows; r++) {
+      double *row = &strip[static_cast<size_t>(r) * ncol];
+      for (int c = 0; c < ncol; c++) row[c] = a[r0 + r] + b[c];
+    }
+
+    if (isoband_stream_push(stream, &strip[0], n_rows, ncol, 1) != stream_ok) {
+      fprintf(stderr, "row %d: %s\n", r0, isoband_last_error());
+      return 1;
+    }
+    resultStruct *rings = isoband_stream_take(stream);
+    for (int i = 0; i < n_bands; i++) points += rings[i].len;
+    isoband_free_results(rings, n_bands);
+
+    max_memory = max(max_memory, isoband_stream_memory(stream));
+    max_rows = max(max_rows, n_rows);
+    n_strips++;
+    r0 += n_rows - 1;
+  }
+  isoband_stream_destroy(stream);
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+  printf("grid %d x %d (%.1f GB as doubles), %d bands, budget %lld MB\n", nrow, ncol, 8.0 * nrow * ncol / 1e9, n_bands, budget >> 20);
+  printf("%d strips of up to %d rows, %lld ring points, %.1f s\n", n_strips, max_rows, points, seconds);
+  printf("peak stream memory %.1f MB, peak resident set %.1f MB\n", max_memory / 1048576.0, peak_rss_mb());
+  return 0;
+}
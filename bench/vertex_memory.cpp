@@ -0,0 +1,63 @@
+// Bytes the vertex store of the isoband engine takes per live vertex, for the hashed and
+// the dense store: a 1000 x 1000 grid (or n x n) of rough hills is contoured into 20
+// bands, and after each band the store's memory and its number of live vertices are
+// recorded. The program is compiled together with isoband.cpp, since the store is internal
+// to the engine.
+//
+// g++ -std=c++11 -O2 -pthread -Isrc bench/vertex_memory.cpp src/classify.cpp \
+//   src/polygon.cpp src/grid_file.cpp -o vertex_memory && ./vertex_memory [n]
+
+#include "../src/isoband.cpp"
+
+#include <cstdio>
+#include <cstdlib>
+
+// an isobander that reports on its vertex store
+class store_isobander : public isobander {
+public:
+  store_isobander(double *x, double *y, double *z, int n, store_mode store) :
+    isobander(x, n, y, n, z, n, n, 0, 0, store) {}
+
+  size_t store_memory() const {return polygon_grid.memory();}
+  size_t live_vertices() const {return polygon_grid.live();}
+};
+
+int main(int argc, char **argv) {
+  int n = argc > 1 ? atoi(argv[1]) : 1000;
+  const int n_bands = 20;
+
+  vector<double> x(n), y(n), z(static_cast<size_t>(n) * n);
+  for (int i = 0; i < n; i++) {
+    x[i] = i;
+    y[i] = i;
+  }
+  for (int c = 0; c < n; c++) {
+    for (int r = 0; r < n; r++) {
+      z[r + static_cast<size_t>(c) * n] = sin(r * 0.003) * cos(c * 0.004) * 100 + sin(r * 0.011 + c * 0.007) * 10 + sin((r + c * n) * 0.7) * 2;
+    }
+  }
+
+  printf("%6s %14s %14s %12s %16s\n", "store", "peak bytes", "peak vertices", "bytes/vertex", "output vertices");
+  for (int s = 0; s < 2; s++) {
+    store_mode store = s == 0 ? store_hashed : store_dense;
+    store_isobander ib(&x[0], &y[0], &z[0], n, store);
+
+    size_t peak_memory = 0, peak_live = 0, output = 0;
+    for (int i = 0; i < n_bands; i++) {
+      double lo = -110 + i * 11;
+      ib.set_value(lo, lo + 11);
+      ib.calculate_contour();
+      peak_memory = max(peak_memory, ib.store_memory());
+      peak_live = max(peak_live, ib.live_vertices());
+
+      resultStruct res = ib.collect();
+      output += res.len;
+      delete[] res.x;
+      delete[] res.y;
+      delete[] res.id;
+    }
+
+    printf("%6s %14zu %14zu %12.1f %16zu\n", s == 0 ? "hashed" : "dense", peak_memory, peak_live, double(peak_memory) / peak_live, output);
+  }
+  return 0;
+}
@@ -0,0 +1,44 @@
+// Scaling of isoline joining on a serpentine: one isoline runs along every fourth grid row
+// and turns at alternating ends, so that each turn joins the long line accumulated so far
+// with a freshly started strand. Joins that reverse or copy a chain make the run time
+// grow quadratically with the grid size; with constant-time joins, the time per point
+// stays flat.
+//
+// g++ -std=c++11 -O2 -pthread -Isrc bench/zigzag.cpp src/isoband.cpp src/classify.cpp \
+//   src/polygon.cpp src/grid_file.cpp -o zigzag && ./zigzag [max_n]
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <chrono>
+using namespace std;
+
+#include "isoband.h"
+
+int main(int argc, char **argv) {
+  int max_n = argc > 1 ? atoi(argv[1]) : 4000;
+
+  printf("%8s %12s %10s %14s\n", "n", "points", "seconds", "ns per point");
+  for (int n = 250; n <= max_n; n *= 2) {
+    vector<double> x(n), y(n), z(static_cast<size_t>(n) * n, 0.0);
+    for (int i = 0; i < n; i++) {
+      x[i] = i;
+      y[i] = i;
+    }
+    for (int r = 1; r < n - 1; r++) {
+      for (int c = 1; c < n - 1; c++) {
+        int k = (r - 1) % 4, strand = (r - 1) / 4;
+        if (k == 0 || (strand % 2 == 0 ? c == n - 2 : c == 1)) z[r + static_cast<size_t>(c) * n] = 1;
+      }
+    }
+
+    double value = 0.5;
+    auto t0 = chrono::steady_clock::now();
+    resultStruct *lines = isolines_impl(&x[0], n, &y[0], n, &z[0], n, n, &value, 1);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    printf("%8d %12d %10.3f %14.1f\n", n, lines[0].len, seconds, 1e9 * seconds / lines[0].len);
+    isoband_free_results(lines, 1);
+  }
+  return 0;
+}
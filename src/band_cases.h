@@ -0,0 +1,200 @@
+#ifndef BAND_CASES_H
+#define BAND_CASES_H
+
+// Elementary polygons of the isoband cells: for every ternary cell index, the polygons that
+// a cell contributes to a band, with the vertices in the order in which the engines merge
+// them into the polygon grid.
+
+// point in abstract grid space
+enum point_type {
+  grid,  // point on the original data grid
+  hintersect_lo, // intersection with horizontal edge, low value
+  hintersect_hi, // intersection with horizontal edge, high value
+  vintersect_lo, // intersection with vertical edge, low value
+  vintersect_hi  // intersection with vertical edge, high value
+};
+
+// vertices of the elementary polygons of the cell at (r, c)
+enum cell_vertex {
+  corner_tl, corner_tr, corner_br, corner_bl, // grid points (r, c), (r, c+1), (r+1, c+1), (r+1, c)
+  top_lo, top_hi, bottom_lo, bottom_hi,       // intersections on the top (r, c) and bottom (r+1, c) edges
+  left_lo, left_hi, right_lo, right_hi        // intersections on the left (r, c) and right (r, c+1) edges
+};
+
+struct cell_vertex_point {
+  unsigned char dr, dc; // row and column offsets from (r, c)
+  point_type type;
+};
+
+constexpr cell_vertex_point cell_vertex_points[] = {
+  {0, 0, grid}, {0, 1, grid}, {1, 1, grid}, {1, 0, grid},
+  {0, 0, hintersect_lo}, {0, 0, hintersect_hi}, {1, 0, hintersect_lo}, {1, 0, hintersect_hi},
+  {0, 0, vintersect_lo}, {0, 0, vintersect_hi}, {0, 1, vintersect_lo}, {0, 1, vintersect_hi}
+};
+
+// how a saddle cell picks one of its polygon variants from the central value vc
+enum saddle_test {
+  saddle_none, // not a saddle, only variant 0
+  saddle_lo,   // variant 0 if vc < vlo, else 1
+  saddle_hi,   // variant 0 if vc >= vhi, else 1
+  saddle_lohi  // variant 0 if vc < vlo, 1 if vc >= vhi, else 2
+};
+
+// the variant of a saddle cell with the given test and central value vc
+inline int saddle_variant(saddle_test saddle, double vc, double vlo, double vhi) {
+  switch (saddle) {
+  case saddle_lo:
+    return !(vc < vlo);
+  case saddle_hi:
+    return !(vc >= vhi);
+  case saddle_lohi:
+    return (vc < vlo) ? 0 : ((vc >= vhi) ? 1 : 2);
+  default:
+    return 0;
+  }
+}
+
+// up to two elementary polygons, each drawn clockwise; the vertices of the second one
+// follow those of the first one
+struct cell_polygons {
+  unsigned char first_size, second_size;
+  unsigned char vertex[16];
+};
+
+struct band_case {
+  saddle_test saddle;
+  cell_polygons variant[3];
+};
+
+// elementary polygons for the 81 ternary cell indices 27a + 9b + 3c + d, where a, b, c, d
+// are the states of the top-left, top-right, bottom-right, and bottom-left corners; the
+// vertex order of every polygon matters for the order of the output
+constexpr band_case band_cases[81] = {
+  {saddle_none, {{0, 0, {}}}}, // 0: 0000
+  {saddle_none, {{3, 0, {left_lo, bottom_lo, corner_bl}}}}, // 1: 0001
+  {saddle_none, {{4, 0, {left_lo, bottom_lo, bottom_hi, left_hi}}}}, // 2: 0002
+  {saddle_none, {{3, 0, {right_lo, corner_br, bottom_lo}}}}, // 3: 0010
+  {saddle_none, {{4, 0, {left_lo, right_lo, corner_br, corner_bl}}}}, // 4: 0011
+  {saddle_none, {{5, 0, {left_lo, right_lo, corner_br, bottom_hi, left_hi}}}}, // 5: 0012
+  {saddle_none, {{4, 0, {bottom_lo, right_lo, right_hi, bottom_hi}}}}, // 6: 0020
+  {saddle_none, {{5, 0, {corner_bl, left_lo, right_lo, right_hi, bottom_hi}}}}, // 7: 0021
+  {saddle_none, {{4, 0, {left_lo, right_lo, right_hi, left_hi}}}}, // 8: 0022
+  {saddle_none, {{3, 0, {top_lo, corner_tr, right_lo}}}}, // 9: 0100
+  {saddle_lo, { // 10: 0101
+    {3, 3, {corner_bl, left_lo, bottom_lo, corner_tr, right_lo, top_lo}},
+    {6, 0, {corner_bl, left_lo, top_lo, corner_tr, right_lo, bottom_lo}}
+  }},
+  {saddle_lo, { // 11: 0102
+    {3, 4, {corner_tr, right_lo, top_lo, left_lo, bottom_lo, bottom_hi, left_hi}},
+    {7, 0, {corner_tr, right_lo, bottom_lo, bottom_hi, left_hi, left_lo, top_lo}}
+  }},
+  {saddle_none, {{4, 0, {top_lo, corner_tr, corner_br, bottom_lo}}}}, // 12: 0110
+  {saddle_none, {{5, 0, {corner_bl, left_lo, top_lo, corner_tr, corner_br}}}}, // 13: 0111
+  {saddle_none, {{6, 0, {corner_tr, corner_br, bottom_hi, left_hi, left_lo, top_lo}}}}, // 14: 0112
+  {saddle_none, {{5, 0, {corner_tr, right_hi, bottom_hi, bottom_lo, top_lo}}}}, // 15: 0120
+  {saddle_none, {{6, 0, {corner_tr, right_hi, bottom_hi, corner_bl, left_lo, top_lo}}}}, // 16: 0121
+  {saddle_none, {{5, 0, {corner_tr, right_hi, left_hi, left_lo, top_lo}}}}, // 17: 0122
+  {saddle_none, {{4, 0, {right_lo, top_lo, top_hi, right_hi}}}}, // 18: 0200
+  {saddle_lo, { // 19: 0201
+    {3, 4, {corner_bl, left_lo, bottom_lo, right_lo, top_lo, top_hi, right_hi}},
+    {7, 0, {corner_bl, left_lo, top_lo, top_hi, right_hi, right_lo, bottom_lo}}
+  }},
+  {saddle_lohi, { // 20: 0202
+    {4, 4, {left_lo, bottom_lo, bottom_hi, left_hi, right_lo, top_lo, top_hi, right_hi}},
+    {4, 4, {left_lo, top_lo, top_hi, left_hi, right_lo, bottom_lo, bottom_hi, right_hi}},
+    {8, 0, {left_lo, top_lo, top_hi, right_hi, right_lo, bottom_lo, bottom_hi, left_hi}}
+  }},
+  {saddle_none, {{5, 0, {corner_br, bottom_lo, top_lo, top_hi, right_hi}}}}, // 21: 0210
+  {saddle_none, {{6, 0, {corner_bl, left_lo, top_lo, top_hi, right_hi, corner_br}}}}, // 22: 0211
+  {saddle_hi, { // 23: 0212
+    {3, 4, {corner_br, bottom_hi, right_hi, top_hi, left_hi, left_lo, top_lo}},
+    {7, 0, {corner_br, bottom_hi, left_hi, left_lo, top_lo, top_hi, right_hi}}
+  }},
+  {saddle_none, {{4, 0, {top_lo, top_hi, bottom_hi, bottom_lo}}}}, // 24: 0220
+  {saddle_none, {{5, 0, {corner_bl, left_lo, top_lo, top_hi, bottom_hi}}}}, // 25: 0221
+  {saddle_none, {{4, 0, {top_hi, left_hi, left_lo, top_lo}}}}, // 26: 0222
+  {saddle_none, {{3, 0, {left_lo, corner_tl, top_lo}}}}, // 27: 1000
+  {saddle_none, {{4, 0, {top_lo, bottom_lo, corner_bl, corner_tl}}}}, // 28: 1001
+  {saddle_none, {{5, 0, {corner_tl, top_lo, bottom_lo, bottom_hi, left_hi}}}}, // 29: 1002
+  {saddle_lo, { // 30: 1010
+    {3, 3, {corner_tl, top_lo, left_lo, corner_br, bottom_lo, right_lo}},
+    {6, 0, {corner_tl, top_lo, right_lo, corner_br, bottom_lo, left_lo}}
+  }},
+  {saddle_none, {{5, 0, {corner_tl, top_lo, right_lo, corner_br, corner_bl}}}}, // 31: 1011
+  {saddle_none, {{6, 0, {corner_tl, top_lo, right_lo, corner_br, bottom_hi, left_hi}}}}, // 32: 1012
+  {saddle_lo, { // 33: 1020
+    {3, 4, {corner_tl, top_lo, left_lo, bottom_lo, right_lo, right_hi, bottom_hi}},
+    {7, 0, {corner_tl, top_lo, right_lo, right_hi, bottom_hi, bottom_lo, left_lo}}
+  }},
+  {saddle_none, {{6, 0, {corner_tl, top_lo, right_lo, right_hi, bottom_hi, corner_bl}}}}, // 34: 1021
+  {saddle_none, {{5, 0, {corner_tl, top_lo, right_lo, right_hi, left_hi}}}}, // 35: 1022
+  {saddle_none, {{4, 0, {corner_tl, corner_tr, right_lo, left_lo}}}}, // 36: 1100
+  {saddle_none, {{5, 0, {corner_tl, corner_tr, right_lo, bottom_lo, corner_bl}}}}, // 37: 1101
+  {saddle_none, {{6, 0, {corner_tl, corner_tr, right_lo, bottom_lo, bottom_hi, left_hi}}}}, // 38: 1102
+  {saddle_none, {{5, 0, {corner_tl, corner_tr, corner_br, bottom_lo, left_lo}}}}, // 39: 1110
+  {saddle_none, {{4, 0, {corner_tl, corner_tr, corner_br, corner_bl}}}}, // 40: 1111
+  {saddle_none, {{5, 0, {corner_tl, corner_tr, corner_br, bottom_hi, left_hi}}}}, // 41: 1112
+  {saddle_none, {{6, 0, {corner_tl, corner_tr, right_hi, bottom_hi, bottom_lo, left_lo}}}}, // 42: 1120
+  {saddle_none, {{5, 0, {corner_tl, corner_tr, right_hi, bottom_hi, corner_bl}}}}, // 43: 1121
+  {saddle_none, {{4, 0, {corner_tl, corner_tr, right_hi, left_hi}}}}, // 44: 1122
+  {saddle_none, {{5, 0, {corner_tl, top_hi, right_hi, right_lo, left_lo}}}}, // 45: 1200
+  {saddle_none, {{6, 0, {corner_tl, top_hi, right_hi, right_lo, bottom_lo, corner_bl}}}}, // 46: 1201
+  {saddle_hi, { // 47: 1202
+    {3, 4, {corner_tl, top_hi, left_hi, bottom_hi, right_hi, right_lo, bottom_lo}},
+    {7, 0, {corner_tl, top_hi, right_hi, right_lo, bottom_lo, bottom_hi, left_hi}}
+  }},
+  {saddle_none, {{6, 0, {corner_tl, top_hi, right_hi, corner_br, bottom_lo, left_lo}}}}, // 48: 1210
+  {saddle_none, {{5, 0, {corner_tl, top_hi, right_hi, corner_br, corner_bl}}}}, // 49: 1211
+  {saddle_hi, { // 50: 1212
+    {3, 3, {corner_tl, top_hi, left_hi, corner_br, bottom_hi, right_hi}},
+    {6, 0, {corner_tl, top_hi, right_hi, corner_br, bottom_hi, left_hi}}
+  }},
+  {saddle_none, {{5, 0, {corner_tl, top_hi, bottom_hi, bottom_lo, left_lo}}}}, // 51: 1220
+  {saddle_none, {{4, 0, {top_hi, bottom_hi, corner_bl, corner_tl}}}}, // 52: 1221
+  {saddle_none, {{3, 0, {left_hi, corner_tl, top_hi}}}}, // 53: 1222
+  {saddle_none, {{4, 0, {top_lo, left_lo, left_hi, top_hi}}}}, // 54: 2000
+  {saddle_none, {{5, 0, {corner_bl, left_hi, top_hi, top_lo, bottom_lo}}}}, // 55: 2001
+  {saddle_none, {{4, 0, {top_hi, top_lo, bottom_lo, bottom_hi}}}}, // 56: 2002
+  {saddle_lo, { // 57: 2010
+    {3, 4, {corner_br, bottom_lo, right_lo, top_lo, left_lo, left_hi, top_hi}},
+    {7, 0, {corner_br, bottom_lo, left_lo, left_hi, top_hi, top_lo, right_lo}}
+  }},
+  {saddle_none, {{6, 0, {corner_bl, left_hi, top_hi, top_lo, right_lo, corner_br}}}}, // 58: 2011
+  {saddle_none, {{5, 0, {corner_br, bottom_hi, top_hi, top_lo, right_lo}}}}, // 59: 2012
+  {saddle_lohi, { // 60: 2020
+    {4, 4, {left_hi, top_hi, top_lo, left_lo, right_hi, bottom_hi, bottom_lo, right_lo}},
+    {4, 4, {left_hi, bottom_hi, bottom_lo, left_lo, right_hi, top_hi, top_lo, right_lo}},
+    {8, 0, {left_hi, top_hi, top_lo, right_lo, right_hi, bottom_hi, bottom_lo, left_lo}}
+  }},
+  {saddle_hi, { // 61: 2021
+    {3, 4, {corner_bl, left_hi, bottom_hi, right_hi, top_hi, top_lo, right_lo}},
+    {7, 0, {corner_bl, left_hi, top_hi, top_lo, right_lo, right_hi, bottom_hi}}
+  }},
+  {saddle_none, {{4, 0, {right_hi, top_hi, top_lo, right_lo}}}}, // 62: 2022
+  {saddle_none, {{5, 0, {corner_tr, right_lo, left_lo, left_hi, top_hi}}}}, // 63: 2100
+  {saddle_none, {{6, 0, {corner_bl, left_hi, top_hi, corner_tr, right_lo, bottom_lo}}}}, // 64: 2101
+  {saddle_none, {{5, 0, {corner_tr, right_lo, bottom_lo, bottom_hi, top_hi}}}}, // 65: 2102
+  {saddle_none, {{6, 0, {corner_tr, corner_br, bottom_lo, left_lo, left_hi, top_hi}}}}, // 66: 2110
+  {saddle_none, {{5, 0, {corner_bl, left_hi, top_hi, corner_tr, corner_br}}}}, // 67: 2111
+  {saddle_none, {{4, 0, {top_hi, corner_tr, corner_br, bottom_hi}}}}, // 68: 2112
+  {saddle_hi, { // 69: 2120
+    {3, 4, {corner_tr, right_hi, top_hi, left_hi, bottom_hi, bottom_lo, left_lo}},
+    {7, 0, {corner_tr, right_hi, bottom_hi, bottom_lo, left_lo, left_hi, top_hi}}
+  }},
+  {saddle_hi, { // 70: 2121
+    {3, 3, {corner_bl, left_hi, bottom_hi, corner_tr, right_hi, top_hi}},
+    {6, 0, {corner_bl, left_hi, top_hi, corner_tr, right_hi, bottom_hi}}
+  }},
+  {saddle_none, {{3, 0, {top_hi, corner_tr, right_hi}}}}, // 71: 2122
+  {saddle_none, {{4, 0, {left_hi, right_hi, right_lo, left_lo}}}}, // 72: 2200
+  {saddle_none, {{5, 0, {corner_bl, left_hi, right_hi, right_lo, bottom_lo}}}}, // 73: 2201
+  {saddle_none, {{4, 0, {bottom_hi, right_hi, right_lo, bottom_lo}}}}, // 74: 2202
+  {saddle_none, {{5, 0, {left_hi, right_hi, corner_br, bottom_lo, left_lo}}}}, // 75: 2210
+  {saddle_none, {{4, 0, {left_hi, right_hi, corner_br, corner_bl}}}}, // 76: 2211
+  {saddle_none, {{3, 0, {right_hi, corner_br, bottom_hi}}}}, // 77: 2212
+  {saddle_none, {{4, 0, {left_hi, bottom_hi, bottom_lo, left_lo}}}}, // 78: 2220
+  {saddle_none, {{3, 0, {left_hi, bottom_hi, corner_bl}}}}, // 79: 2221
+  {saddle_none, {{0, 0, {}}}} // 80: 2222
+};
+
+#endif // BAND_CASES_H
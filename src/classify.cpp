@@ -0,0 +1,718 @@
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <vector>
+#include <stdint.h>
+
+using namespace std;
+
+#include "classify.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ISOBAND_X86_SIMD
+#include <immintrin.h>
+#endif
+
+
+// scalar kernels
+
+// All kernels fill the packed words one at a time, collecting the bits of a word in a
+// register before storing it, so bits beyond n stay zero.
+
+template <class T>
+static void ternarize_scalar(const T *z, size_t n, T vlo, T vhi, uint64_t *lo, uint64_t *hi, uint64_t *nonfinite) {
+  for (size_t w = 0, i = 0; i < n; w++) {
+    uint64_t m_in = 0, m_hi = 0, m_nf = 0;
+    for (int s = 0; s < 64 && i < n; s++, i++) {
+      T v = z[i];
+      m_in |= static_cast<uint64_t>(v >= vlo && v < vhi) << s;
+      m_hi |= static_cast<uint64_t>(v >= vhi) << s;
+      m_nf |= static_cast<uint64_t>(!std::isfinite(v)) << s;
+    }
+    lo[w] = m_in;
+    hi[w] = m_hi;
+    if (nonfinite) nonfinite[w] = m_nf;
+  }
+}
+
+template <class T>
+static void binarize_scalar(const T *z, size_t n, T value, uint64_t *ge, uint64_t *nonfinite) {
+  for (size_t w = 0, i = 0; i < n; w++) {
+    uint64_t m_ge = 0, m_nf = 0;
+    for (int s = 0; s < 64 && i < n; s++, i++) {
+      T v = z[i];
+      m_ge |= static_cast<uint64_t>(v >= value) << s;
+      m_nf |= static_cast<uint64_t>(!std::isfinite(v)) << s;
+    }
+    ge[w] = m_ge;
+    if (nonfinite) nonfinite[w] = m_nf;
+  }
+}
+
+static void ternarize_i16_scalar(const int16_t *z, size_t n, int klo, int khi, uint64_t *lo, uint64_t *hi, uint64_t *nonfinite) {
+  for (size_t w = 0, i = 0; i < n; w++) {
+    uint64_t m_in = 0, m_hi = 0, m_nf = 0;
+    for (int s = 0; s < 64 && i < n; s++, i++) {
+      int k = z[i];
+      m_in |= static_cast<uint64_t>(k >= klo && k < khi) << s;
+      m_hi |= static_cast<uint64_t>(k >= khi) << s;
+      m_nf |= static_cast<uint64_t>(k < 0) << s;
+    }
+    lo[w] = m_in;
+    hi[w] = m_hi;
+    if (nonfinite) nonfinite[w] = m_nf;
+  }
+}
+
+static void binarize_i16_scalar(const int16_t *z, size_t n, int k, uint64_t *ge, uint64_t *nonfinite) {
+  for (size_t w = 0, i = 0; i < n; w++) {
+    uint64_t m_ge = 0, m_nf = 0;
+    for (int s = 0; s < 64 && i < n; s++, i++) {
+      m_ge |= static_cast<uint64_t>(z[i] >= k) << s;
+      m_nf |= static_cast<uint64_t>(z[i] < 0) << s;
+    }
+    ge[w] = m_ge;
+    if (nonfinite) nonfinite[w] = m_nf;
+  }
+}
+
+static void ternarize_i32_scalar(const int32_t *z, size_t n, int64_t klo, int64_t khi, uint64_t *lo, uint64_t *hi) {
+  for (size_t w = 0, i = 0; i < n; w++) {
+    uint64_t m_in = 0, m_hi = 0;
+    for (int s = 0; s < 64 && i < n; s++, i++) {
+      int64_t k = z[i];
+      m_in |= static_cast<uint64_t>(k >= klo && k < khi) << s;
+      m_hi |= static_cast<uint64_t>(k >= khi) << s;
+    }
+    lo[w] = m_in;
+    hi[w] = m_hi;
+  }
+}
+
+static void binarize_i32_scalar(const int32_t *z, size_t n, int64_t k, uint64_t *ge) {
+  for (size_t w = 0, i = 0; i < n; w++) {
+    uint64_t m_ge = 0;
+    for (int s = 0; s < 64 && i < n; s++, i++) {
+      m_ge |= static_cast<uint64_t>(z[i] >= k) << s;
+    }
+    ge[w] = m_ge;
+  }
+}
+
+static const classify_kernels scalar_kernels = {
+  ternarize_scalar<double>, binarize_scalar<double>, ternarize_scalar<float>, binarize_scalar<float>,
+  ternarize_i16_scalar, binarize_i16_scalar, ternarize_i32_scalar, binarize_i32_scalar
+};
+
+
+#ifdef ISOBAND_X86_SIMD
+
+// The SIMD classifiers compare chunks of 8 values at a time and collect the comparison
+// results as 8-bit masks. A final partial chunk is read with masked loads, or through a
+// zero-padded buffer for SSE2, and its padding bits are masked off, so short columns,
+// such as those of the 16x16 blocks of the pyramid, don't need a scalar tail.
+
+// the 8 values starting at z[i], padded through tail if fewer than 8 are left
+template <class T>
+static inline const T* chunk_values(const T *z, size_t i, size_t n, T *tail) {
+  if (i + 8 <= n) return z + i;
+  for (size_t k = 0; k < 8; k++) {
+    tail[k] = (i + k < n) ? z[i + k] : 0;
+  }
+  return tail;
+}
+
+// mask of the bits of the chunk starting at i that hold actual values
+static inline unsigned chunk_mask(size_t i, size_t n) {
+  return (i + 8 <= n) ? 0xff : (1u << (n - i)) - 1;
+}
+
+// Integer values are at or above cutoff k if z > k - 1, but k - 1 may not fit into the
+// lanes. For the 2^bits-bit lanes, the comparand is clamped to the lane range, and cutoffs at
+// or below the smallest lane value, where the comparison would miss that value, force all
+// bits on instead.
+static inline int64_t lane_cutoff(int64_t k, int bits) {
+  int64_t lo = -(int64_t(1) << (bits - 1)), hi = (int64_t(1) << (bits - 1)) - 1;
+  return min(max(k - 1, lo), hi);
+}
+
+static inline bool lane_all(int64_t k, int bits) {
+  return k <= -(int64_t(1) << (bits - 1));
+}
+
+// SSE2
+
+__attribute__((target("sse2")))
+static void ternarize_sse2(const double *z, size_t n, double vlo, double vhi, uint64_t *lo, uint64_t *hi, uint64_t *nonfinite) {
+  const __m128d vl = _mm_set1_pd(vlo), vh = _mm_set1_pd(vhi), zero = _mm_setzero_pd();
+  double tail[8];
+  for (size_t w = 0, i = 0; i < n; w++) {
+    uint64_t w_in = 0, w_hi = 0, w_nf = 0;
+    for (int s = 0; s < 64 && i < n; s += 8, i += 8) {
+      const double *p = chunk_values(z, i, n, tail);
+      unsigned m_in = 0, m_hi = 0, m_nf = 0;
+      for (int k = 0; k < 4; k++) {
+        __m128d v = _mm_loadu_pd(p + 2*k);
+        m_in |= _mm_movemask_pd(_mm_and_pd(_mm_cmpge_pd(v, vl), _mm_cmplt_pd(v, vh))) << (2*k);
+        m_hi |= _mm_movemask_pd(_mm_cmpge_pd(v, vh)) << (2*k);
+        m_nf |= (~_mm_movemask_pd(_mm_cmpeq_pd(_mm_sub_pd(v, v), zero)) & 3) << (2*k);
+      }
+      unsigned valid = chunk_mask(i, n);
+      w_in |= static_cast<uint64_t>(m_in & valid) << s;
+      w_hi |= static_cast<uint64_t>(m_hi & valid) << s;
+      w_nf |= static_cast<uint64_t>(m_nf & valid) << s;
+    }
+    lo[w] = w_in;
+    hi[w] = w_hi;
+    if (nonfinite) nonfinite[w] = w_nf;
+  }
+}
+
+__attribute__((target("sse2")))
+static void binarize_sse2(const double *z, size_t n, double value, uint64_t *ge, uint64_t *nonfinite) {
+  const __m128d val = _mm_set1_pd(value), zero = _mm_setzero_pd();
+  double tail[8];
+  for (size_t w = 0, i = 0; i < n; w++) {
+    uint64_t w_ge = 0, w_nf = 0;
+    for (int s = 0; s < 64 && i < n; s += 8, i += 8) {
+      const double *p = chunk_values(z, i, n, tail);
+      unsigned m_ge = 0, m_nf = 0;
+      for (int k = 0; k < 4; k++) {
+        __m128d v = _mm_loadu_pd(p + 2*k);
+        m_ge |= _mm_movemask_pd(_mm_cmpge_pd(v, val)) << (2*k);
+        m_nf |= (~_mm_movemask_pd(_mm_cmpeq_pd(_mm_sub_pd(v, v), zero)) & 3) << (2*k);
+      }
+      unsigned valid = chunk_mask(i, n);
+      w_ge |= static_cast<uint64_t>(m_ge & valid) << s;
+      w_nf |= static_cast<uint64_t>(m_nf & valid) << s;
+    }
+    ge[w] = w_ge;
+    if (nonfinite) nonfinite[w] = w_nf;
+  }
+}
+
+__attribute__((target("sse2")))
+static void ternarize_f32_sse2(const float *z, size_t n, float vlo, float vhi, uint64_t *lo, uint64_t *hi, uint64_t *nonfinite) {
+  const __m128 vl = _mm_set1_ps(vlo), vh = _mm_set1_ps(vhi), zero = _mm_setzero_ps();
+  float tail[8];
+  for (size_t w = 0, i = 0; i < n; w++) {
+    uint64_t w_in = 0, w_hi = 0, w_nf = 0;
+    for (int s = 0; s < 64 && i < n; s += 8, i += 8) {
+      const float *p = chunk_values(z, i, n, tail);
+      unsigned m_in = 0, m_hi = 0, m_nf = 0;
+      for (int k = 0; k < 2; k++) {
+        __m128 v = _mm_loadu_ps(p + 4*k);
+        m_in |= _mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(v, vl), _mm_cmplt_ps(v, vh))) << (4*k);
+        m_hi |= _mm_movemask_ps(_mm_cmpge_ps(v, vh)) << (4*k);
+        m_nf |= (~_mm_movemask_ps(_mm_cmpeq_ps(_mm_sub_ps(v, v), zero)) & 15) << (4*k);
+      }
+      unsigned valid = chunk_mask(i, n);
+      w_in |= static_cast<uint64_t>(m_in & valid) << s;
+      w_hi |= static_cast<uint64_t>(m_hi & valid) << s;
+      w_nf |= static_cast<uint64_t>(m_nf & valid) << s;
+    }
+    lo[w] = w_in;
+    hi[w] = w_hi;
+    if (nonfinite) nonfinite[w] = w_nf;
+  }
+}
+
+__attribute__((target("sse2")))
+static void binarize_f32_sse2(const float *z, size_t n, float value, uint64_t *ge, uint64_t *nonfinite) {
+  const __m128 val = _mm_set1_ps(value), zero = _mm_setzero_ps();
+  float tail[8];
+  for (size_t w = 0, i = 0; i < n; w++) {
+    uint64_t w_ge = 0, w_nf = 0;
+    for (int s = 0; s < 64 && i < n; s += 8, i += 8) {
+      const float *p = chunk_values(z, i, n, tail);
+      unsigned m_ge = 0, m_nf = 0;
+      for (int k = 0; k < 2; k++) {
+        __m128 v = _mm_loadu_ps(p + 4*k);
+        m_ge |= _mm_movemask_ps(_mm_cmpge_ps(v, val)) << (4*k);
+        m_nf |= (~_mm_movemask_ps(_mm_cmpeq_ps(_mm_sub_ps(v, v), zero)) & 15) << (4*k);
+      }
+      unsigned valid = chunk_mask(i, n);
+      w_ge |= static_cast<uint64_t>(m_ge & valid) << s;
+      w_nf |= static_cast<uint64_t>(m_nf & valid) << s;
+    }
+    ge[w] = w_ge;
+    if (nonfinite) nonfinite[w] = w_nf;
+  }
+}
+
+// the low bits of the 16-bit lanes of x that are all ones, i.e. of 16-bit comparison results
+__attribute__((target("sse2")))
+static inline unsigned movemask_epi16(__m128i x) {
+  return _mm_movemask_epi8(_mm_packs_epi16(x, _mm_setzero_si128()));
+}
+
+__attribute__((target("sse2")))
+static void ternarize_i16_sse2(const int16_t *z, size_t n, int klo, int khi, uint64_t *lo, uint64_t *hi, uint64_t *nonfinite) {
+  const __m128i kl = _mm_set1_epi16(static_cast<short>(lane_cutoff(klo, 16))), kh = _mm_set1_epi16(static_cast<short>(lane_cutoff(khi, 16)));
+  const __m128i all_lo = _mm_set1_epi16(lane_all(klo, 16) ? -1 : 0), all_hi = _mm_set1_epi16(lane_all(khi, 16) ? -1 : 0);
+  const __m128i zero = _mm_setzero_si128();
+  int16_t tail[8];
+  for (size_t w = 0, i = 0; i < n; w++) {
+    uint64_t w_in = 0, w_hi = 0, w_nf = 0;
+    for (int s = 0; s < 64 && i < n; s += 8, i += 8) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chunk_values(z, i, n, tail)));
+      __m128i ge_lo = _mm_or_si128(_mm_cmpgt_epi16(v, kl), all_lo), ge_hi = _mm_or_si128(_mm_cmpgt_epi16(v, kh), all_hi);
+      unsigned valid = chunk_mask(i, n);
+      w_in |= static_cast<uint64_t>(movemask_epi16(_mm_andnot_si128(ge_hi, ge_lo)) & valid) << s;
+      w_hi |= static_cast<uint64_t>(movemask_epi16(ge_hi) & valid) << s;
+      w_nf |= static_cast<uint64_t>(movemask_epi16(_mm_cmplt_epi16(v, zero)) & valid) << s;
+    }
+    lo[w] = w_in;
+    hi[w] = w_hi;
+    if (nonfinite) nonfinite[w] = w_nf;
+  }
+}
+
+__attribute__((target("sse2")))
+static void binarize_i16_sse2(const int16_t *z, size_t n, int k, uint64_t *ge, uint64_t *nonfinite) {
+  const __m128i kv = _mm_set1_epi16(static_cast<short>(lane_cutoff(k, 16))), all = _mm_set1_epi16(lane_all(k, 16) ? -1 : 0);
+  const __m128i zero = _mm_setzero_si128();
+  int16_t tail[8];
+  for (size_t w = 0, i = 0; i < n; w++) {
+    uint64_t w_ge = 0, w_nf = 0;
+    for (int s = 0; s < 64 && i < n; s += 8, i += 8) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chunk_values(z, i, n, tail)));
+      unsigned valid = chunk_mask(i, n);
+      w_ge |= static_cast<uint64_t>(movemask_epi16(_mm_or_si128(_mm_cmpgt_epi16(v, kv), all)) & valid) << s;
+      w_nf |= static_cast<uint64_t>(movemask_epi16(_mm_cmplt_epi16(v, zero)) & valid) << s;
+    }
+    ge[w] = w_ge;
+    if (nonfinite) nonfinite[w] = w_nf;
+  }
+}
+
+// the sign bits of the 32-bit lanes of x, i.e. of 32-bit comparison results
+__attribute__((target("sse2")))
+static inline unsigned movemask_epi32(__m128i x) {
+  return _mm_movemask_ps(_mm_castsi128_ps(x));
+}
+
+__attribute__((target("sse2")))
+static void ternarize_i32_sse2(const int32_t *z, size_t n, int64_t klo, int64_t khi, uint64_t *lo, uint64_t *hi) {
+  const __m128i kl = _mm_set1_epi32(static_cast<int>(lane_cutoff(klo, 32))), kh = _mm_set1_epi32(static_cast<int>(lane_cutoff(khi, 32)));
+  const __m128i all_lo = _mm_set1_epi32(lane_all(klo, 32) ? -1 : 0), all_hi = _mm_set1_epi32(lane_all(khi, 32) ? -1 : 0);
+  int32_t tail[8];
+  for (size_t w = 0, i = 0; i < n; w++) {
+    uint64_t w_in = 0, w_hi = 0;
+    for (int s = 0; s < 64 && i < n; s += 8, i += 8) {
+      const int32_t *p = chunk_values(z, i, n, tail);
+      unsigned m_in = 0, m_hi = 0;
+      for (int k = 0; k < 2; k++) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 4*k));
+        __m128i ge_lo = _mm_or_si128(_mm_cmpgt_epi32(v, kl), all_lo), ge_hi = _mm_or_si128(_mm_cmpgt_epi32(v, kh), all_hi);
+        m_in |= movemask_epi32(_mm_andnot_si128(ge_hi, ge_lo)) << (4*k);
+        m_hi |= movemask_epi32(ge_hi) << (4*k);
+      }
+      unsigned valid = chunk_mask(i, n);
+      w_in |= static_cast<uint64_t>(m_in & valid) << s;
+      w_hi |= static_cast<uint64_t>(m_hi & valid) << s;
+    }
+    lo[w] = w_in;
+    hi[w] = w_hi;
+  }
+}
+
+__attribute__((target("sse2")))
+static void binarize_i32_sse2(const int32_t *z, size_t n, int64_t k, uint64_t *ge) {
+  const __m128i kv = _mm_set1_epi32(static_cast<int>(lane_cutoff(k, 32))), all = _mm_set1_epi32(lane_all(k, 32) ? -1 : 0);
+  int32_t tail[8];
+  for (size_t w = 0, i = 0; i < n; w++) {
+    uint64_t w_ge = 0;
+    for (int s = 0; s < 64 && i < n; s += 8, i += 8) {
+      const int32_t *p = chunk_values(z, i, n, tail);
+      unsigned m_ge = 0;
+      for (int j = 0; j < 2; j++) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 4*j));
+        m_ge |= movemask_epi32(_mm_or_si128(_mm_cmpgt_epi32(v, kv), all)) << (4*j);
+      }
+      w_ge |= static_cast<uint64_t>(m_ge & chunk_mask(i, n)) << s;
+    }
+    ge[w] = w_ge;
+  }
+}
+
+static const classify_kernels sse2_kernels = {
+  ternarize_sse2, binarize_sse2, ternarize_f32_sse2, binarize_f32_sse2,
+  ternarize_i16_sse2, binarize_i16_sse2, ternarize_i32_sse2, binarize_i32_sse2
+};
+
+// AVX2
+
+// values k..k+3 of the chunk starting at z[i]; values at or beyond n read as zero
+__attribute__((target("avx2")))
+static inline __m256d chunk_load_avx2(const double *z, size_t i, size_t k, size_t n) {
+  if (i + 8 <= n) return _mm256_loadu_pd(z + i + k);
+  __m256i left = _mm256_set1_epi64x(static_cast<long long>(n - i - k));
+  __m256i mask = _mm256_cmpgt_epi64(left, _mm256_set_epi64x(3, 2, 1, 0));
+  return _mm256_maskload_pd(z + i + k, mask);
+}
+
+__attribute__((target("avx2")))
+static void ternarize_avx2(const double *z, size_t n, double vlo, double vhi, uint64_t *lo, uint64_t *hi, uint64_t *nonfinite) {
+  const __m256d vl = _mm256_set1_pd(vlo), vh = _mm256_set1_pd(vhi), zero = _mm256_setzero_pd();
+  for (size_t w = 0, i = 0; i < n; w++) {
+    uint64_t w_in = 0, w_hi = 0, w_nf = 0;
+    for (int s = 0; s < 64 && i < n; s += 8, i += 8) {
+      unsigned m_in = 0, m_hi = 0, m_nf = 0;
+      for (int k = 0; k < 2; k++) {
+        __m256d v = chunk_load_avx2(z, i, 4*k, n);
+        __m256d in = _mm256_and_pd(_mm256_cmp_pd(v, vl, _CMP_GE_OQ), _mm256_cmp_pd(v, vh, _CMP_LT_OQ));
+        m_in |= _mm256_movemask_pd(in) << (4*k);
+        m_hi |= _mm256_movemask_pd(_mm256_cmp_pd(v, vh, _CMP_GE_OQ)) << (4*k);
+        m_nf |= (~_mm256_movemask_pd(_mm256_cmp_pd(_mm256_sub_pd(v, v), zero, _CMP_EQ_OQ)) & 15) << (4*k);
+      }
+      unsigned valid = chunk_mask(i, n);
+      w_in |= static_cast<uint64_t>(m_in & valid) << s;
+      w_hi |= static_cast<uint64_t>(m_hi & valid) << s;
+      w_nf |= static_cast<uint64_t>(m_nf & valid) << s;
+    }
+    lo[w] = w_in;
+    hi[w] = w_hi;
+    if (nonfinite) nonfinite[w] = w_nf;
+  }
+}
+
+__attribute__((target("avx2")))
+static void binarize_avx2(const double *z, size_t n, double value, uint64_t *ge, uint64_t *nonfinite) {
+  const __m256d val = _mm256_set1_pd(value), zero = _mm256_setzero_pd();
+  for (size_t w = 0, i = 0; i < n; w++) {
+    uint64_t w_ge = 0, w_nf = 0;
+    for (int s = 0; s < 64 && i < n; s += 8, i += 8) {
+      unsigned m_ge = 0, m_nf = 0;
+      for (int k = 0; k < 2; k++) {
+        __m256d v = chunk_load_avx2(z, i, 4*k, n);
+        m_ge |= _mm256_movemask_pd(_mm256_cmp_pd(v, val, _CMP_GE_OQ)) << (4*k);
+        m_nf |= (~_mm256_movemask_pd(_mm256_cmp_pd(_mm256_sub_pd(v, v), zero, _CMP_EQ_OQ)) & 15) << (4*k);
+      }
+      unsigned valid = chunk_mask(i, n);
+      w_ge |= static_cast<uint64_t>(m_ge & valid) << s;
+      w_nf |= static_cast<uint64_t>(m_nf & valid) << s;
+    }
+    ge[w] = w_ge;
+    if (nonfinite) nonfinite[w] = w_nf;
+  }
+}
+
+// mask of the lanes of the 8-lane chunk starting at i that hold actual values
+__attribute__((target("avx2")))
+static inline __m256i chunk_lanes_avx2(size_t i, size_t n) {
+  __m256i left = _mm256_set1_epi32(static_cast<int>(min(n - i, size_t(8))));
+  return _mm256_cmpgt_epi32(left, _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+}
+
+__attribute__((target("avx2")))
+static void ternarize_f32_avx2(const float *z, size_t n, float vlo, float vhi, uint64_t *lo, uint64_t *hi, uint64_t *nonfinite) {
+  const __m256 vl = _mm256_set1_ps(vlo), vh = _mm256_set1_ps(vhi), zero = _mm256_setzero_ps();
+  for (size_t w = 0, i = 0; i < n; w++) {
+    uint64_t w_in = 0, w_hi = 0, w_nf = 0;
+    for (int s = 0; s < 64 && i < n; s += 8, i += 8) {
+      __m256 v = (i + 8 <= n) ? _mm256_loadu_ps(z + i) : _mm256_maskload_ps(z + i, chunk_lanes_avx2(i, n));
+      unsigned m_in = _mm256_movemask_ps(_mm256_and_ps(_mm256_cmp_ps(v, vl, _CMP_GE_OQ), _mm256_cmp_ps(v, vh, _CMP_LT_OQ)));
+      unsigned m_nf = ~_mm256_movemask_ps(_mm256_cmp_ps(_mm256_sub_ps(v, v), zero, _CMP_EQ_OQ));
+      unsigned valid = chunk_mask(i, n);
+      w_in |= static_cast<uint64_t>(m_in & valid) << s;
+      w_hi |= static_cast<uint64_t>(_mm256_movemask_ps(_mm256_cmp_ps(v, vh, _CMP_GE_OQ)) & valid) << s;
+      w_nf |= static_cast<uint64_t>(m_nf & valid) << s;
+    }
+    lo[w] = w_in;
+    hi[w] = w_hi;
+    if (nonfinite) nonfinite[w] = w_nf;
+  }
+}
+
+__attribute__((target("avx2")))
+static void binarize_f32_avx2(const float *z, size_t n, float value, uint64_t *ge, uint64_t *nonfinite) {
+  const __m256 val = _mm256_set1_ps(value), zero = _mm256_setzero_ps();
+  for (size_t w = 0, i = 0; i < n; w++) {
+    uint64_t w_ge = 0, w_nf = 0;
+    for (int s = 0; s < 64 && i < n; s += 8, i += 8) {
+      __m256 v = (i + 8 <= n) ? _mm256_loadu_ps(z + i) : _mm256_maskload_ps(z + i, chunk_lanes_avx2(i, n));
+      unsigned m_nf = ~_mm256_movemask_ps(_mm256_cmp_ps(_mm256_sub_ps(v, v), zero, _CMP_EQ_OQ));
+      unsigned valid = chunk_mask(i, n);
+      w_ge |= static_cast<uint64_t>(_mm256_movemask_ps(_mm256_cmp_ps(v, val, _CMP_GE_OQ)) & valid) << s;
+      w_nf |= static_cast<uint64_t>(m_nf & valid) << s;
+    }
+    ge[w] = w_ge;
+    if (nonfinite) nonfinite[w] = w_nf;
+  }
+}
+
+__attribute__((target("avx2")))
+static void ternarize_i32_avx2(const int32_t *z, size_t n, int64_t klo, int64_t khi, uint64_t *lo, uint64_t *hi) {
+  const __m256i kl = _mm256_set1_epi32(static_cast<int>(lane_cutoff(klo, 32))), kh = _mm256_set1_epi32(static_cast<int>(lane_cutoff(khi, 32)));
+  const __m256i all_lo = _mm256_set1_epi32(lane_all(klo, 32) ? -1 : 0), all_hi = _mm256_set1_epi32(lane_all(khi, 32) ? -1 : 0);
+  for (size_t w = 0, i = 0; i < n; w++) {
+    uint64_t w_in = 0, w_hi = 0;
+    for (int s = 0; s < 64 && i < n; s += 8, i += 8) {
+      const int *p = reinterpret_cast<const int*>(z + i);
+      __m256i v = (i + 8 <= n) ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)) : _mm256_maskload_epi32(p, chunk_lanes_avx2(i, n));
+      __m256i ge_lo = _mm256_or_si256(_mm256_cmpgt_epi32(v, kl), all_lo), ge_hi = _mm256_or_si256(_mm256_cmpgt_epi32(v, kh), all_hi);
+      unsigned valid = chunk_mask(i, n);
+      w_in |= static_cast<uint64_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_andnot_si256(ge_hi, ge_lo))) & valid) << s;
+      w_hi |= static_cast<uint64_t>(_mm256_movemask_ps(_mm256_castsi256_ps(ge_hi)) & valid) << s;
+    }
+    lo[w] = w_in;
+    hi[w] = w_hi;
+  }
+}
+
+__attribute__((target("avx2")))
+static void binarize_i32_avx2(const int32_t *z, size_t n, int64_t k, uint64_t *ge) {
+  const __m256i kv = _mm256_set1_epi32(static_cast<int>(lane_cutoff(k, 32))), all = _mm256_set1_epi32(lane_all(k, 32) ? -1 : 0);
+  for (size_t w = 0, i = 0; i < n; w++) {
+    uint64_t w_ge = 0;
+    for (int s = 0; s < 64 && i < n; s += 8, i += 8) {
+      const int *p = reinterpret_cast<const int*>(z + i);
+      __m256i v = (i + 8 <= n) ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)) : _mm256_maskload_epi32(p, chunk_lanes_avx2(i, n));
+      __m256i m = _mm256_or_si256(_mm256_cmpgt_epi32(v, kv), all);
+      w_ge |= static_cast<uint64_t>(_mm256_movemask_ps(_mm256_castsi256_ps(m)) & chunk_mask(i, n)) << s;
+    }
+    ge[w] = w_ge;
+  }
+}
+
+static const classify_kernels avx2_kernels = {
+  ternarize_avx2, binarize_avx2, ternarize_f32_avx2, binarize_f32_avx2,
+  ternarize_i16_sse2, binarize_i16_sse2, ternarize_i32_avx2, binarize_i32_avx2
+};
+
+// AVX-512
+
+__attribute__((target("avx512f")))
+static void ternarize_avx512(const double *z, size_t n, double vlo, double vhi, uint64_t *lo, uint64_t *hi, uint64_t *nonfinite) {
+  const __m512d vl = _mm512_set1_pd(vlo), vh = _mm512_set1_pd(vhi), zero = _mm512_setzero_pd();
+  for (size_t w = 0, i = 0; i < n; w++) {
+    uint64_t w_in = 0, w_hi = 0, w_nf = 0;
+    for (int s = 0; s < 64 && i < n; s += 8, i += 8) {
+      unsigned valid = chunk_mask(i, n);
+      __m512d v = _mm512_maskz_loadu_pd(valid, z + i);
+      unsigned m_in = _mm512_cmp_pd_mask(v, vl, _CMP_GE_OQ) & _mm512_cmp_pd_mask(v, vh, _CMP_LT_OQ);
+      unsigned m_nf = ~_mm512_cmp_pd_mask(_mm512_sub_pd(v, v), zero, _CMP_EQ_OQ);
+      w_in |= static_cast<uint64_t>(m_in & valid) << s;
+      w_hi |= static_cast<uint64_t>(_mm512_cmp_pd_mask(v, vh, _CMP_GE_OQ) & valid) << s;
+      w_nf |= static_cast<uint64_t>(m_nf & valid) << s;
+    }
+    lo[w] = w_in;
+    hi[w] = w_hi;
+    if (nonfinite) nonfinite[w] = w_nf;
+  }
+}
+
+__attribute__((target("avx512f")))
+static void binarize_avx512(const double *z, size_t n, double value, uint64_t *ge, uint64_t *nonfinite) {
+  const __m512d val = _mm512_set1_pd(value), zero = _mm512_setzero_pd();
+  for (size_t w = 0, i = 0; i < n; w++) {
+    uint64_t w_ge = 0, w_nf = 0;
+    for (int s = 0; s < 64 && i < n; s += 8, i += 8) {
+      unsigned valid = chunk_mask(i, n);
+      __m512d v = _mm512_maskz_loadu_pd(valid, z + i);
+      unsigned m_nf = ~_mm512_cmp_pd_mask(_mm512_sub_pd(v, v), zero, _CMP_EQ_OQ);
+      w_ge |= static_cast<uint64_t>(_mm512_cmp_pd_mask(v, val, _CMP_GE_OQ) & valid) << s;
+      w_nf |= static_cast<uint64_t>(m_nf & valid) << s;
+    }
+    ge[w] = w_ge;
+    if (nonfinite) nonfinite[w] = w_nf;
+  }
+}
+
+static const classify_kernels avx512_kernels = {
+  ternarize_avx512, binarize_avx512, ternarize_f32_avx2, binarize_f32_avx2,
+  ternarize_i16_sse2, binarize_i16_sse2, ternarize_i32_avx2, binarize_i32_avx2
+};
+
+#endif // ISOBAND_X86_SIMD
+
+
+simd_level best_simd_level() {
+#ifdef ISOBAND_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) return simd_avx512;
+  if (__builtin_cpu_supports("avx2")) return simd_avx2;
+  if (__builtin_cpu_supports("sse2")) return simd_sse2;
+#endif
+  return simd_scalar;
+}
+
+const classify_kernels& get_kernels(simd_level level) {
+  simd_level best = best_simd_level();
+  if (level > best) level = best;
+
+  switch(level) {
+#ifdef ISOBAND_X86_SIMD
+  case simd_avx512:
+    return avx512_kernels;
+  case simd_avx2:
+    return avx2_kernels;
+  case simd_sse2:
+    return sse2_kernels;
+#endif
+  default:
+    return scalar_kernels;
+  }
+}
+
+const classify_kernels& kernels() {
+  static const classify_kernels &k = get_kernels(best_simd_level());
+  return k;
+}
+
+const char* simd_level_name(simd_level level) {
+  switch(level) {
+  case simd_sse2:
+    return "sse2";
+  case simd_avx2:
+    return "avx2";
+  case simd_avx512:
+    return "avx512";
+  default:
+    return "scalar";
+  }
+}
+
+// runs a scalar kernel call and the same call of another kernel, which write planes bit
+// planes of nw words each into the buffer they are given, and counts the planes that
+// differ in their first words words; the other kernel's buffer is prefilled with garbage
+// to make sure all bits get written
+template <class E, class A>
+static int compare_kernels(size_t nw, size_t words, int planes, E expected, A actual) {
+  vector<uint64_t> e(3 * nw, 0), a(3 * nw, ~uint64_t(0));
+  expected(&e[0]);
+  actual(&a[0]);
+  int mismatches = 0;
+  for (int p = 0; p < planes; p++) {
+    mismatches += memcmp(&e[p * nw], &a[p * nw], 8 * words) != 0;
+  }
+  return mismatches;
+}
+
+int classify_selftest() {
+  const double inf = numeric_limits<double>::infinity(), nan = numeric_limits<double>::quiet_NaN();
+  const double vlo = 0.5, vhi = 1.5;
+  const double special[] = {vlo, vhi, nextafter(vlo, -inf), nextafter(vhi, inf), 0.0, -0.0, nan, inf, -inf};
+  const float flo = 0.5f, fhi = 1.5f;
+
+  // deterministic pseudo-random test data, with room for unaligned starting offsets
+  const size_t nmax = 300;
+  vector<double> z(nmax + 8);
+  vector<float> zf(nmax + 8);
+  uint32_t state = 12345;
+  for (size_t i = 0; i < z.size(); i++) {
+    state = state * 1664525u + 1013904223u;
+    unsigned k = state >> 24;
+    z[i] = (k < 90) ? special[k % 9] : (k - 90) / 50.0 - 0.7;
+    zf[i] = (k < 10) ? nextafterf(flo, -1) : static_cast<float>(z[i]);
+  }
+
+  // 16-bit values, doubling as level ranks with the NA marker -1 and the largest rank, and
+  // 32-bit values, both including the extremes of their type
+  vector<int16_t> z16(nmax + 8);
+  vector<int32_t> z32(nmax + 8);
+  for (size_t i = 0; i < z16.size(); i++) {
+    state = state * 1664525u + 1013904223u;
+    unsigned k = state >> 24;
+    z16[i] = (k < 20) ? -1 : ((k < 30) ? 32767 : ((k < 40) ? -32768 : static_cast<int16_t>(k % 12)));
+    z32[i] = (k < 20) ? -1 : ((k < 30) ? numeric_limits<int32_t>::max() : ((k < 40) ? numeric_limits<int32_t>::min() : static_cast<int32_t>(k % 12) - 3));
+  }
+  // integer cutoffs: in range, at the extremes of the types and beyond them
+  const int64_t big = int64_t(1) << 31;
+  const int cut16[][2] = {{4, 7}, {-32768, 32767}, {-32767, 32768}, {-40000, 0}, {5, 40000}};
+  const int64_t cut32[][2] = {{-2, 5}, {-big, big - 1}, {-big + 1, big}, {-big - 5, 0}, {1, big + 5}};
+
+  int mismatches = 0;
+
+  // the scalar kernels against the definition
+  const size_t nw = (nmax + 63) / 64;
+  vector<uint64_t> lo(nw), hi(nw), nf(nw);
+  scalar_kernels.ternarize(&z[0], nmax, vlo, vhi, &lo[0], &hi[0], &nf[0]);
+  for (size_t i = 0; i < nmax; i++) {
+    int state = (z[i] >= vlo && z[i] < vhi) + 2*(z[i] >= vhi);
+    mismatches += (packed_bit(&lo[0], i) + 2*packed_bit(&hi[0], i) != state) || (packed_bit(&nf[0], i) != !std::isfinite(z[i]));
+  }
+  scalar_kernels.binarize(&z[0], nmax, vlo, &lo[0], &nf[0]);
+  for (size_t i = 0; i < nmax; i++) {
+    mismatches += (packed_bit(&lo[0], i) != (z[i] >= vlo)) || (packed_bit(&nf[0], i) != !std::isfinite(z[i]));
+  }
+  scalar_kernels.ternarize_f32(&zf[0], nmax, flo, fhi, &lo[0], &hi[0], &nf[0]);
+  for (size_t i = 0; i < nmax; i++) {
+    int state = (zf[i] >= flo && zf[i] < fhi) + 2*(zf[i] >= fhi);
+    mismatches += (packed_bit(&lo[0], i) + 2*packed_bit(&hi[0], i) != state) || (packed_bit(&nf[0], i) != !std::isfinite(zf[i]));
+  }
+  for (int c = 0; c < 5; c++) {
+    int klo = cut16[c][0], khi = cut16[c][1];
+    scalar_kernels.ternarize_i16(&z16[0], nmax, klo, khi, &lo[0], &hi[0], &nf[0]);
+    for (size_t i = 0; i < nmax; i++) {
+      int state = (z16[i] >= klo && z16[i] < khi) + 2*(z16[i] >= khi);
+      mismatches += (packed_bit(&lo[0], i) + 2*packed_bit(&hi[0], i) != state) || (packed_bit(&nf[0], i) != (z16[i] < 0));
+    }
+    int64_t llo = cut32[c][0], lhi = cut32[c][1];
+    scalar_kernels.ternarize_i32(&z32[0], nmax, llo, lhi, &lo[0], &hi[0]);
+    for (size_t i = 0; i < nmax; i++) {
+      int state = (z32[i] >= llo && z32[i] < lhi) + 2*(z32[i] >= lhi);
+      mismatches += packed_bit(&lo[0], i) + 2*packed_bit(&hi[0], i) != state;
+    }
+  }
+
+  // all other kernels against the scalar ones
+  const classify_kernels &s = scalar_kernels;
+  for (int level = simd_sse2; level <= best_simd_level(); level++) {
+    const classify_kernels &k = get_kernels(static_cast<simd_level>(level));
+    for (size_t offset = 0; offset < 4; offset++) {
+      for (size_t n = 0; n <= nmax; n++) {
+        size_t words = (n + 63) / 64;
+        for (int with_nf = 0; with_nf < 2; with_nf++) {
+          const double *pz = &z[offset];
+          const float *pf = &zf[offset];
+          const int16_t *p16 = &z16[offset];
+          mismatches += compare_kernels(nw, words, 2 + with_nf,
+            [&](uint64_t *p) {s.ternarize(pz, n, vlo, vhi, p, p + nw, with_nf ? p + 2 * nw : 0);},
+            [&](uint64_t *p) {k.ternarize(pz, n, vlo, vhi, p, p + nw, with_nf ? p + 2 * nw : 0);});
+          mismatches += compare_kernels(nw, words, 1 + with_nf,
+            [&](uint64_t *p) {s.binarize(pz, n, vlo, p, with_nf ? p + nw : 0);},
+            [&](uint64_t *p) {k.binarize(pz, n, vlo, p, with_nf ? p + nw : 0);});
+          mismatches += compare_kernels(nw, words, 2 + with_nf,
+            [&](uint64_t *p) {s.ternarize_f32(pf, n, flo, fhi, p, p + nw, with_nf ? p + 2 * nw : 0);},
+            [&](uint64_t *p) {k.ternarize_f32(pf, n, flo, fhi, p, p + nw, with_nf ? p + 2 * nw : 0);});
+          mismatches += compare_kernels(nw, words, 1 + with_nf,
+            [&](uint64_t *p) {s.binarize_f32(pf, n, flo, p, with_nf ? p + nw : 0);},
+            [&](uint64_t *p) {k.binarize_f32(pf, n, flo, p, with_nf ? p + nw : 0);});
+          mismatches += compare_kernels(nw, words, 2 + with_nf,
+            [&](uint64_t *p) {s.ternarize_i16(p16, n, 4, 7, p, p + nw, with_nf ? p + 2 * nw : 0);},
+            [&](uint64_t *p) {k.ternarize_i16(p16, n, 4, 7, p, p + nw, with_nf ? p + 2 * nw : 0);});
+          mismatches += compare_kernels(nw, words, 1 + with_nf,
+            [&](uint64_t *p) {s.binarize_i16(p16, n, 32767, p, with_nf ? p + nw : 0);},
+            [&](uint64_t *p) {k.binarize_i16(p16, n, 32767, p, with_nf ? p + nw : 0);});
+        }
+      }
+
+      // integer cutoffs at and beyond the extremes, on a few lengths
+      for (size_t n = 0; n <= nmax; n += 37) {
+        size_t words = (n + 63) / 64;
+        const int16_t *p16 = &z16[offset];
+        const int32_t *p32 = &z32[offset];
+        for (int c = 0; c < 5; c++) {
+          int klo = cut16[c][0], khi = cut16[c][1];
+          int64_t llo = cut32[c][0], lhi = cut32[c][1];
+          mismatches += compare_kernels(nw, words, 2,
+            [&](uint64_t *p) {s.ternarize_i16(p16, n, klo, khi, p, p + nw, 0);},
+            [&](uint64_t *p) {k.ternarize_i16(p16, n, klo, khi, p, p + nw, 0);});
+          mismatches += compare_kernels(nw, words, 1,
+            [&](uint64_t *p) {s.binarize_i16(p16, n, klo, p, 0);},
+            [&](uint64_t *p) {k.binarize_i16(p16, n, klo, p, 0);});
+          mismatches += compare_kernels(nw, words, 2,
+            [&](uint64_t *p) {s.ternarize_i32(p32, n, llo, lhi, p, p + nw);},
+            [&](uint64_t *p) {k.ternarize_i32(p32, n, llo, lhi, p, p + nw);});
+          mismatches += compare_kernels(nw, words, 1,
+            [&](uint64_t *p) {s.binarize_i32(p32, n, lhi, p);},
+            [&](uint64_t *p) {k.binarize_i32(p32, n, lhi, p);});
+        }
+      }
+    }
+  }
+  return mismatches;
+}
@@ -0,0 +1,102 @@
+#ifndef CLASSIFY_H
+#define CLASSIFY_H
+
+#include <cstddef>
+#include <stdint.h>
+
+// Classification kernels for the contouring engines. Grid values are classified against
+// the contour cutoffs into bit-packed states, 64 grid values per word: binary states take
+// one bit plane, ternary states two. Cell indices and the cells that contribute to a
+// contour are then derived from the packed words of two neighboring grid lines with
+// bit operations. Every kernel exists as a scalar version and, on x86, as SSE2, AVX2
+// and AVX-512 versions; the best one supported by the CPU is picked at runtime. Grids of
+// floats and integers are classified in their own type, against cutoffs that have been
+// converted to that type; the kernels on 16-bit integers, which also classify level
+// ranks, use SSE2 on all x86 levels, and those on floats and 32-bit integers AVX2 on
+// AVX-512 CPUs.
+
+enum simd_level {
+  simd_scalar,
+  simd_sse2,
+  simd_avx2,
+  simd_avx512
+};
+
+struct classify_kernels {
+  // ternary states of z[0..n), as two bit planes: bit i of lo is set if vlo <= z[i] < vhi,
+  // bit i of hi if z[i] >= vhi, so the state is 0, 1, 2 for below, within, above. If
+  // nonfinite isn't null, bit i of it is set if z[i] is NA or infinite; the states of such
+  // values are meaningless. Every plane has (n + 63)/64 words, unused bits are zero.
+  void (*ternarize)(const double *z, size_t n, double vlo, double vhi, uint64_t *lo, uint64_t *hi, uint64_t *nonfinite);
+  // binary states: bit i of ge is set if z[i] >= value; nonfinite as above
+  void (*binarize)(const double *z, size_t n, double value, uint64_t *ge, uint64_t *nonfinite);
+
+  // the same for floats
+  void (*ternarize_f32)(const float *z, size_t n, float vlo, float vhi, uint64_t *lo, uint64_t *hi, uint64_t *nonfinite);
+  void (*binarize_f32)(const float *z, size_t n, float value, uint64_t *ge, uint64_t *nonfinite);
+
+  // the same for 16-bit integers, which are at or above cutoff k if z[i] >= k: bit i of lo is
+  // set if klo <= z[i] < khi, bit i of hi if z[i] >= khi. The cutoffs may lie outside the
+  // 16-bit range. Negative values set their bit of nonfinite; that's for level ranks, where
+  // they mark NA or infinite values, so plain integer grids pass null.
+  void (*ternarize_i16)(const int16_t *z, size_t n, int klo, int khi, uint64_t *lo, uint64_t *hi, uint64_t *nonfinite);
+  void (*binarize_i16)(const int16_t *z, size_t n, int k, uint64_t *ge, uint64_t *nonfinite);
+
+  // the same for 32-bit integers, which are always finite
+  void (*ternarize_i32)(const int32_t *z, size_t n, int64_t klo, int64_t khi, uint64_t *lo, uint64_t *hi);
+  void (*binarize_i32)(const int32_t *z, size_t n, int64_t k, uint64_t *ge);
+};
+
+// bit i of a packed line of states
+inline int packed_bit(const uint64_t *p, size_t i) {
+  return (p[i / 64] >> (i % 64)) & 1;
+}
+
+// word w of a packed line of nwords words, shifted by one value: bit i holds value i + 1
+inline uint64_t packed_next(const uint64_t *p, size_t w, size_t nwords) {
+  return (p[w] >> 1) | ((w + 1 < nwords) ? (p[w + 1] << 63) : 0);
+}
+
+// for the cells between two neighboring packed grid lines p0 and p1, whose corners are
+// values i and i + 1 of both lines: bit i is set if the corners of cell 64*w + i don't all
+// have the same bit
+inline uint64_t corners_differ(const uint64_t *p0, const uint64_t *p1, size_t w, size_t nwords) {
+  uint64_t a = p0[w];
+  return (a ^ p1[w]) | (a ^ packed_next(p0, w, nwords)) | (a ^ packed_next(p1, w, nwords));
+}
+
+// same, but bit i is set if any corner of cell 64*w + i has its bit set
+inline uint64_t corners_any(const uint64_t *p0, const uint64_t *p1, size_t w, size_t nwords) {
+  return p0[w] | p1[w] | packed_next(p0, w, nwords) | packed_next(p1, w, nwords);
+}
+
+// index of the lowest set bit in a non-zero mask word
+inline int lowest_bit(uint64_t x) {
+#ifdef __GNUC__
+  return __builtin_ctzll(x);
+#else
+  int i = 0;
+  while (!(x & 1)) {
+    x >>= 1;
+    i++;
+  }
+  return i;
+#endif
+}
+
+// highest SIMD level supported by this build and CPU
+simd_level best_simd_level();
+
+// kernels for a given level; levels that aren't available fall back to the next lower one
+const classify_kernels& get_kernels(simd_level level);
+
+// kernels for best_simd_level()
+const classify_kernels& kernels();
+
+const char* simd_level_name(simd_level level);
+
+// runs all available kernels against the scalar ones on synthetic data, including NA,
+// infinite values and values exactly on the cutoffs; returns the number of mismatches
+int classify_selftest();
+
+#endif // CLASSIFY_H
@@ -0,0 +1,207 @@
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <stdint.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#include "grid_file.h"
+
+size_t grid_value_size(int type) {
+  switch(type) {
+  case mapped_grid::type_double:
+    return 8;
+  case mapped_grid::type_float:
+    return 4;
+  case mapped_grid::type_int16:
+    return 2;
+  case mapped_grid::type_int32:
+    return 4;
+  default:
+    return 0;
+  }
+}
+
+mapped_grid::mapped_grid(const char *path) :
+  base(0), length(0), values(0), value_type(type_double), nrow(0), ncol(0), row_major(false)
+{
+#ifdef _WIN32
+  file_handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file_handle == INVALID_HANDLE_VALUE) {throw std::runtime_error(string("Cannot open grid file ") + path + ".");}
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file_handle, &size) || size.QuadPart == 0) {
+    CloseHandle(file_handle);
+    throw std::runtime_error(string("Grid file ") + path + " is empty or unreadable.");
+  }
+  length = static_cast<size_t>(size.QuadPart);
+
+  mapping_handle = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+  base = mapping_handle ? MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0) : NULL;
+  if (!base) {
+    if (mapping_handle) CloseHandle(mapping_handle);
+    CloseHandle(file_handle);
+    throw std::runtime_error(string("Cannot map grid file ") + path + ".");
+  }
+#else
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {throw std::runtime_error(string("Cannot open grid file ") + path + ".");}
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    throw std::runtime_error(string("Grid file ") + path + " is empty or unreadable.");
+  }
+  length = static_cast<size_t>(st.st_size);
+
+  base = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (base == MAP_FAILED) {
+    close(fd);
+    throw std::runtime_error(string("Cannot map grid file ") + path + ".");
+  }
+#endif
+}
+
+mapped_grid::~mapped_grid() {
+#ifdef _WIN32
+  UnmapViewOfFile(base);
+  CloseHandle(mapping_handle);
+  CloseHandle(file_handle);
+#else
+  munmap(base, length);
+  close(fd);
+#endif
+}
+
+void mapped_grid::set_layout(size_t offset, int type, int nrow_in, int ncol_in, bool row_major_in) {
+  size_t size = grid_value_size(type);
+  if (size == 0) {throw std::invalid_argument("Unknown type of grid values.");}
+  if (nrow_in < 0 || ncol_in < 0) {throw std::invalid_argument("Grid dimensions must not be negative.");}
+  if (offset % size != 0) {throw std::invalid_argument("Grid values must start at a multiple of their size.");}
+
+  size_t bytes = static_cast<size_t>(nrow_in) * static_cast<size_t>(ncol_in) * size;
+  if (offset > length || bytes > length - offset) {throw std::invalid_argument("Grid file is too short for the grid.");}
+
+  values = static_cast<const char*>(base) + offset;
+  value_type = type;
+  nrow = nrow_in;
+  ncol = ncol_in;
+  row_major = row_major_in;
+}
+
+void mapped_grid::advise_sequential(bool sequential) const {
+#if !defined(_WIN32) && defined(MADV_SEQUENTIAL)
+  madvise(base, length, sequential ? MADV_SEQUENTIAL : MADV_NORMAL);
+#else
+  (void)sequential;
+#endif
+}
+
+mapped_grid* mapped_grid::open_raw(const char *path, long long offset, int type, int nrow, int ncol, bool row_major) {
+  if (offset < 0) {throw std::invalid_argument("Grid offset must not be negative.");}
+
+  unique_ptr<mapped_grid> g(new mapped_grid(path));
+  g->set_layout(static_cast<size_t>(offset), type, nrow, ncol, row_major);
+  return g.release();
+}
+
+// the value of key in the Python dict literal of a .npy header, without quotes, or an
+// empty string if the key is missing
+static string npy_field(const string &header, const char *key) {
+  size_t pos = header.find(string("'") + key + "'");
+  if (pos == string::npos) return string();
+  pos = header.find(':', pos);
+  if (pos == string::npos) return string();
+  pos = header.find_first_not_of(" \t", pos + 1);
+  if (pos == string::npos) return string();
+
+  size_t end;
+  if (header[pos] == '\'') {
+    pos++;
+    end = header.find('\'', pos);
+  } else if (header[pos] == '(') {
+    end = header.find(')', pos);
+    if (end != string::npos) end++;
+  } else {
+    end = header.find_first_of(",}", pos);
+  }
+  if (end == string::npos) return string();
+  return header.substr(pos, end - pos);
+}
+
+mapped_grid* mapped_grid::open_npy(const char *path) {
+  unique_ptr<mapped_grid> g(new mapped_grid(path));
+  const unsigned char *p = static_cast<const unsigned char*>(g->base);
+
+  // magic string, format version and header length
+  if (g->length < 10 || memcmp(p, "\x93NUMPY", 6) != 0) {throw std::invalid_argument(string(path) + " is not a .npy file.");}
+  size_t header_len, start;
+  if (p[6] == 1) {
+    header_len = p[8] | (p[9] << 8);
+    start = 10;
+  } else if ((p[6] == 2 || p[6] == 3) && g->length >= 12) {
+    header_len = p[8] | (p[9] << 8) | (p[10] << 16) | (static_cast<size_t>(p[11]) << 24);
+    start = 12;
+  } else {
+    throw std::invalid_argument(string("Unsupported .npy format version in ") + path + ".");
+  }
+  if (header_len > g->length - start) {throw std::invalid_argument(string("Truncated .npy header in ") + path + ".");}
+  string header(reinterpret_cast<const char*>(p + start), header_len);
+
+  // value type, e.g. '<f8'; the byte order must be that of the machine
+  string descr = npy_field(header, "descr");
+  const uint16_t one = 1;
+  bool little = *reinterpret_cast<const unsigned char*>(&one) == 1;
+  if (descr.size() != 3 || (descr[0] == '<' && !little) || (descr[0] == '>' && little) ||
+      (descr[0] != '<' && descr[0] != '>' && descr[0] != '=')) {
+    throw std::invalid_argument("Unsupported .npy value type '" + descr + "'; values must be in the byte order of the machine.");
+  }
+  int type;
+  string code = descr.substr(1);
+  if (code == "f8") type = type_double;
+  else if (code == "f4") type = type_float;
+  else if (code == "i2") type = type_int16;
+  else if (code == "i4") type = type_int32;
+  else {throw std::invalid_argument("Unsupported .npy value type '" + descr + "'.");}
+
+  string order = npy_field(header, "fortran_order");
+  if (order != "True" && order != "False") {throw std::invalid_argument(string("Missing array order in .npy header of ") + path + ".");}
+
+  // shape, e.g. (1000, 2000); trailing commas are allowed
+  string shape = npy_field(header, "shape");
+  long long dims[2];
+  int n_dims = 0;
+  for (size_t pos = 1; shape.size() > 1 && pos < shape.size() - 1; ) {
+    size_t end = shape.find_first_of(",)", pos);
+    if (end == string::npos) break;
+    string token = shape.substr(pos, end - pos);
+    if (token.find_first_not_of(" ") != string::npos) {
+      if (n_dims == 2) {n_dims++; break;}
+      char *rest;
+      dims[n_dims] = strtoll(token.c_str(), &rest, 10);
+      if (dims[n_dims] < 0 || dims[n_dims] > INT_MAX) {throw std::invalid_argument(string("Invalid .npy shape in ") + path + ".");}
+      n_dims++;
+    }
+    pos = end + 1;
+  }
+  if (n_dims != 2) {throw std::invalid_argument(string("The array in ") + path + " must have two dimensions.");}
+
+  g->set_layout(start + header_len, type, static_cast<int>(dims[0]), static_cast<int>(dims[1]), order == "False");
+  return g.release();
+}
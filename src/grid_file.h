@@ -0,0 +1,66 @@
+#ifndef GRID_FILE_H
+#define GRID_FILE_H
+
+#include <cstddef>
+
+// Grids stored in files, memory-mapped read-only so that the contouring engines work on
+// the page cache directly instead of a copy in RAM. Files can be raw binary files, whose
+// layout the caller describes, or NumPy .npy files, whose header has the value type,
+// shape and order. Values must be in the byte order of the machine.
+class mapped_grid {
+public:
+  // value type codes, the same as z_type of the typed entry points
+  enum {
+    type_double = 0,
+    type_float = 1,
+    type_int16 = 2,
+    type_int32 = 3
+  };
+
+  // a raw binary file with nrow x ncol values of the given type, starting at byte offset,
+  // row-major or column-major
+  static mapped_grid* open_raw(const char *path, long long offset, int type, int nrow, int ncol, bool row_major);
+
+  // a .npy file holding a two-dimensional array of float64, float32, int16 or int32; the
+  // first dimension is the grid rows
+  static mapped_grid* open_npy(const char *path);
+
+  ~mapped_grid();
+
+  const void* data() const {return values;}
+  int type() const {return value_type;}
+  int rows() const {return nrow;}
+  int columns() const {return ncol;}
+  bool is_row_major() const {return row_major;}
+
+  // tells the OS whether the mapping is about to be read front to back, e.g. by a pass
+  // over the whole grid, so that it reads ahead aggressively and can drop pages behind
+  void advise_sequential(bool sequential) const;
+
+private:
+  // the whole file is mapped
+  void *base;
+  size_t length;
+#ifdef _WIN32
+  void *file_handle, *mapping_handle;
+#else
+  int fd;
+#endif
+
+  const void *values;
+  int value_type;
+  int nrow, ncol;
+  bool row_major;
+
+  explicit mapped_grid(const char *path);
+  mapped_grid(const mapped_grid&);
+  mapped_grid& operator=(const mapped_grid&);
+
+  // points values to the grid at byte offset, checking that it fits into the file
+  void set_layout(size_t offset, int type, int nrow, int ncol, bool row_major);
+};
+
+// size in bytes of a value of the given type code; 0 for unknown codes
+size_t grid_value_size(int type);
+
+#endif // GRID_FILE_H
@@ -10,55 +10,186 @@
 
 #include <iostream>
 #include <vector>
+#include <string>
 #include <unordered_map>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <limits>
+#include <algorithm>
 #include <math.h>       /* isfinite */
 
 using namespace std;
 
+#include "isoband.h" // the C interface
 #include "polygon.h" // for point
+#include "classify.h" // classification kernels
+#include "grid_file.h" // memory-mapped grid files
+#include "band_cases.h" // elementary polygons of isoband cells
+
+
+// the grid values z, of any of the value types; a raw integer value z may be scaled to
+// stand for offset + scale * z, with scale > 0. The engines classify the values in their
+// own type, against the cutoffs converted by threshold(), and only promote them to double
+// where they interpolate.
+//
+// Grid point r, c is stored at data[r * row_stride + c * col_stride], so row-major arrays,
+// sub-windows of larger arrays and flipped views need no copy. col_stride 0 stands for
+// column-major storage without gaps, like an R matrix, and is filled in by layout() once
+// the number of rows is known.
+struct grid_values {
+  const void *data;
+  value_type type;
+  double offset, scale;
+  ptrdiff_t row_stride, col_stride; // in values
+
+  grid_values(const double *z = 0) : data(z), type(value_double), offset(0), scale(1), row_stride(1), col_stride(0) {}
+  grid_values(const void *z, value_type type_in, double offset_in = 0, double scale_in = 1, ptrdiff_t row_stride_in = 1, ptrdiff_t col_stride_in = 0) :
+    data(z), type(type_in), offset(offset_in), scale(scale_in), row_stride(row_stride_in), col_stride(col_stride_in) {}
+
+  // the same values with the strides of a grid of nrow rows filled in
+  grid_values layout(int nrow) const {
+    grid_values g = *this;
+    if (g.col_stride == 0) g.col_stride = nrow;
+    return g;
+  }
+
+  // whether the values of a grid column follow each other in memory
+  bool contiguous_columns() const {return row_stride == 1;}
+
+  // whether the values of a grid row are closer together in memory than those of a column,
+  // so that passes over the grid should run along the rows
+  bool row_order() const {return labs(col_stride) < labs(row_stride);}
+
+  size_t value_size() const {
+    switch(type) {
+    case value_float:
+      return sizeof(float);
+    case value_int16:
+      return sizeof(int16_t);
+    case value_int32:
+      return sizeof(int32_t);
+    default:
+      return sizeof(double);
+    }
+  }
 
+  ptrdiff_t index(int r, int c) const {return r * row_stride + c * col_stride;}
 
-// point in abstract grid space
-enum point_type {
-  grid,  // point on the original data grid
-  hintersect_lo, // intersection with horizontal edge, low value
-  hintersect_hi, // intersection with horizontal edge, high value
-  vintersect_lo, // intersection with vertical edge, low value
-  vintersect_hi  // intersection with vertical edge, high value
-};
+  // the values of the sub-grid whose first grid point is r0, c0
+  grid_values window(int r0, int c0) const {
+    grid_values g = *this;
+    g.data = static_cast<const char*>(data) + index(r0, c0) * static_cast<ptrdiff_t>(value_size());
+    return g;
+  }
+
+  // whether the values can be NA or infinite
+  bool floating() const {return type == value_double || type == value_float;}
+
+  // the value a raw value stands for
+  double value(double raw) const {return floating() ? raw : offset + scale * raw;}
+
+  // value of grid point r, c, promoted to double
+  double operator()(int r, int c) const {return (*this)[index(r, c)];}
+
+  // value i, promoted to double
+  double operator[](ptrdiff_t i) const {
+    switch(type) {
+    case value_float:
+      return static_cast<const float*>(data)[i];
+    case value_int16:
+      return value(static_cast<const int16_t*>(data)[i]);
+    case value_int32:
+      return value(static_cast<const int32_t*>(data)[i]);
+    default:
+      return static_cast<const double*>(data)[i];
+    }
+  }
+
+  // the cutoff v in the type of the values: raw value z stands for a value >= v exactly if
+  // z >= threshold(v). For floats, that's the smallest float >= v; for integers, the
+  // smallest integer z with value(z) >= v, clamped to one beyond the range of the type.
+  double threshold(double v) const {
+    switch(type) {
+    case value_float:
+      return float_threshold(v);
+    case value_int16:
+      return int_threshold(v, 32768.0);
+    case value_int32:
+      return int_threshold(v, 2147483648.0);
+    default:
+      return v;
+    }
+  }
+
+  static double float_threshold(double v) {
+    const float fmax = numeric_limits<float>::max();
+    if (isnan(v)) return v;
+    if (v > fmax) return numeric_limits<float>::infinity();
+    if (v < -fmax) return isinf(v) ? v : -fmax;
+    float f = static_cast<float>(v);
+    if (f < v) f = nextafterf(f, numeric_limits<float>::infinity());
+    return f;
+  }
 
-// return type for extern C functions
-struct resultStruct {
-  double *x;
-  double *y;
-  int *id;
-  int len;
+  // for integers within [-limit, limit)
+  double int_threshold(double v, double limit) const {
+    if (isnan(v)) return limit; // no value is >= NaN
+    double t = max(-limit, min(limit, ceil((v - offset) / scale)));
+    // the division may be off by a rounding error; settle on the exact threshold of value()
+    while (t > -limit && value(t - 1) >= v) t--;
+    while (t < limit && value(t) < v) t++;
+    return t;
+  }
 };
 
+// whether a raw grid value is finite; integers always are
+template <class T>
+inline bool finite_value(T v) {
+  return isfinite(static_cast<double>(v));
+}
+
+// largest number of grid columns; a grid point packs its column into 28 bits
+const int max_grid_columns = (1 << 27) - 1;
+
+// grid points are packed into 64 bits: 32 bits for the row, 28 for the column, and 4 for
+// the point type
 struct grid_point {
-  int r, c; // row and column
-  point_type type; // point type
+  int r; // row
+  int c : 28; // column
+  point_type type : 4; // point type
 
   // default constructor; negative values indicate non-existing point off grid
   grid_point(double r_in = -1, double c_in = -1, point_type type_in = grid) : r(r_in), c(c_in), type(type_in) {}
   // copy constructor
   grid_point(const grid_point &p) : r(p.r), c(p.c), type(p.type) {}
+
+  // all three fields as one integer, unique per grid point
+  uint64_t packed() const {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(r)) << 32) |
+      ((static_cast<uint64_t>(c) & 0xfffffff) << 4) | type;
+  }
 };
 
 // hash function for grid_point
 struct grid_point_hasher {
   size_t operator()(const grid_point& p) const
   {
-    // this should work up to about 100,000,000 rows/columns
-    return hash<long long>()(
-      (static_cast<long long>(p.r) << 30) ^
-        (static_cast<long long>(p.c) << 3) ^
-          static_cast<long long>(p.type));
+    return hash<uint64_t>()(p.packed());
   }
 };
 
 bool operator==(const grid_point &p1, const grid_point &p2) {
-  return (p1.r == p2.r) && (p1.c == p2.c) && (p1.type == p2.type);
+  return p1.packed() == p2.packed();
+}
+
+// whether p1 comes before p2 in raster order, i.e. by row, then column, then point type
+inline bool raster_less(const grid_point &p1, const grid_point &p2) {
+  if (p1.r != p2.r) return p1.r < p2.r;
+  if (p1.c != p2.c) return p1.c < p2.c;
+  return p1.type < p2.type;
 }
 
 ostream & operator<<(ostream &out, const grid_point &p) {
@@ -66,15 +197,16 @@ ostream & operator<<(ostream &out, const grid_point &p) {
   return out;
 }
 
-// connection between points in grid space
+// connection between points in grid space; the neighbors are the entries of their points in
+// the vertex store, -1 for none
 struct point_connect {
-  grid_point prev, next; // previous and next points in polygon
-  grid_point prev2, next2; // alternative previous and next, when two separate polygons have vertices on the same grid point
+  int prev, next; // previous and next points in polygon
+  int prev2, next2; // alternative previous and next, when two separate polygons have vertices on the same grid point
 
   bool altpoint;  // does this connection hold an alternative point?
   bool collected, collected2; // has this connection been collected into a final polygon?
 
-  point_connect() : altpoint(false), collected(false), collected2(false) {};
+  point_connect() : prev(-1), next(-1), prev2(-1), next2(-1), altpoint(false), collected(false), collected2(false) {};
 };
 
 ostream & operator<<(ostream &out, const point_connect &pc) {
@@ -85,1651 +217,3650 @@ ostream & operator<<(ostream &out, const point_connect &pc) {
   return out;
 }
 
-class isobander {
-protected:
-  int nrow, ncol; // numbers of rows and columns
-  // SEXP grid_x, grid_y, grid_z;
-  double *grid_x_p, *grid_y_p, *grid_z_p;
-  double vlo, vhi; // low and high cutoff values
-  grid_point tmp_poly[8]; // temp storage for elementary polygons; none has more than 8 vertices
-  point_connect tmp_point_connect[8];
-  int tmp_poly_size; // current number of elements in tmp_poly
-
-  typedef unordered_map<grid_point, point_connect, grid_point_hasher> gridmap;
-  gridmap polygon_grid;
+// lookup mode for the vertex connectivity store
+enum store_mode {
+  store_auto,   // dense for grids up to dense_store_max_nodes grid points, hashed otherwise
+  store_hashed, // hash map from grid_point to entry
+  store_dense   // slot array with one slot per grid point and point type
+};
 
-  bool interrupted;
+// largest grid (in number of grid points) for which store_auto picks the dense mode; up
+// front, the dense mode only costs a pointer per tile of the slot array
+const size_t dense_store_max_nodes = size_t(1) << 26;
+
+// side length of the tiles of grid points in which the dense slot array is allocated; a
+// tile takes 5 ints per grid point, 1280 bytes. Small tiles keep the memory close to the
+// area the contours cover; larger ones didn't make lookups measurably faster.
+const int dense_tile_bits = 3;
+const int dense_tile = 1 << dense_tile_bits;
+
+// arena for the nodes of the hash maps that index vertices and chains, which otherwise
+// cost one malloc and one free per inserted element
+//
+// Memory is carved from chunks that live as long as the pool. Freed nodes go to a free
+// list per size class and are handed out again first; release() makes the whole arena
+// available again in O(1), without returning anything to the system, so the next contour
+// reuses the chunks of the previous one.
+class node_pool {
+public:
+  static const size_t granularity = 16; // size classes are multiples of this; keeps nodes aligned
+  static const size_t max_size = 64;    // larger requests, e.g. bucket arrays, go to operator new
+  static const size_t chunk_size = 65536;
 
-  void reset_grid() {
-    polygon_grid.clear();
+  node_pool() : next_chunk(0), cur(0), end(0), n_pooled(0) {
+    fill(free_lists, free_lists + n_classes, static_cast<free_node*>(0));
+  }
 
-    for (int i=0; i<8; i++) {
-      tmp_point_connect[i] = point_connect();
+  ~node_pool() {
+    for (size_t i = 0; i < chunks.size(); i++) {
+      delete[] chunks[i];
     }
   }
 
-  // internal member functions
+  static bool pooled(size_t bytes) {return bytes <= max_size;}
 
-  double central_value(int r, int c) {// calculates the central value of a given cell
-    return (grid_z_p[r + c * nrow] + grid_z_p[r + (c + 1) * nrow] + grid_z_p[r + 1 + c * nrow] + grid_z_p[r + 1 + (c + 1) * nrow])/4;
+  void* allocate(size_t bytes) {
+    size_t cls = size_class(bytes);
+    n_pooled++;
+    if (free_lists[cls]) {
+      free_node *n = free_lists[cls];
+      free_lists[cls] = n->next;
+      return n;
+    }
+    size_t size = (cls + 1) * granularity;
+    if (size > static_cast<size_t>(end - cur)) {
+      // move on to the next chunk, allocating it only if no earlier contour needed it
+      if (next_chunk == chunks.size()) chunks.push_back(new char[chunk_size]);
+      cur = chunks[next_chunk++];
+      end = cur + chunk_size;
+    }
+    void *p = cur;
+    cur += size;
+    return p;
   }
 
-  void poly_start(int r, int c, point_type type) { // start a new elementary polygon
-    tmp_poly[0].r = r;
-    tmp_poly[0].c = c;
-    tmp_poly[0].type = type;
+  void deallocate(void *p, size_t bytes) {
+    size_t cls = size_class(bytes);
+    free_node *n = static_cast<free_node*>(p);
+    n->next = free_lists[cls];
+    free_lists[cls] = n;
+  }
 
-    tmp_poly_size = 1;
+  // makes all memory of the pool available again; nodes allocated before must not be used
+  // or deallocated afterwards
+  void release() {
+    fill(free_lists, free_lists + n_classes, static_cast<free_node*>(0));
+    next_chunk = 0;
+    cur = end = 0;
   }
 
-  void poly_add(int r, int c, point_type type) { // add point to elementary polygon
-    tmp_poly[tmp_poly_size].r = r;
-    tmp_poly[tmp_poly_size].c = c;
-    tmp_poly[tmp_poly_size].type = type;
+  // number of node allocations served from the pool instead of the heap, and number of
+  // chunks the pool itself had to allocate
+  size_t pooled_allocations() const {return n_pooled;}
+  size_t chunk_allocations() const {return chunks.size();}
 
-    tmp_poly_size++;
-  }
+private:
+  struct free_node {
+    free_node *next;
+  };
+  static const size_t n_classes = max_size / granularity;
 
-  void poly_merge() { // merge current elementary polygon to prior polygons
-    //cout << "before merging:" << endl;
+  static size_t size_class(size_t bytes) {
+    return (max(bytes, sizeof(free_node)) + granularity - 1) / granularity - 1;
+  }
 
-    bool to_delete[] = {false, false, false, false, false, false, false, false};
+  vector<char*> chunks;
+  size_t next_chunk; // chunk to carve from once the current one is used up
+  char *cur, *end;   // unused part of the current chunk
+  free_node *free_lists[n_classes];
+  size_t n_pooled;
 
-    // first, we figure out the right connections for current polygon
-    for (int i = 0; i < tmp_poly_size; i++) {
-      // create defined state in tmp_point_connect[]
-      // for each point, find previous and next point in polygon
-      tmp_point_connect[i].altpoint = false;
-      tmp_point_connect[i].next = tmp_poly[(i+1<tmp_poly_size) ? i+1 : 0];
-      tmp_point_connect[i].prev = tmp_poly[(i-1>=0) ? i-1 : tmp_poly_size-1];
+  node_pool(const node_pool&);
+  node_pool& operator=(const node_pool&);
+};
 
-      //cout << tmp_poly[i] << ": " << tmp_point_connect[i] << endl;
+// standard allocator drawing single small objects, i.e. hash map nodes, from a node_pool
+template <class T>
+struct pool_allocator {
+  typedef T value_type;
 
-      // now merge with existing polygons if needed
-      const grid_point &p = tmp_poly[i];
-      if (polygon_grid.count(p) > 0) { // point has been used before, need to merge polygons
-        if (!polygon_grid[p].altpoint) {
-          // basic scenario, no alternative point at this location
-          int score = 2 * (tmp_point_connect[i].next == polygon_grid[p].prev) + (tmp_point_connect[i].prev == polygon_grid[p].next);
-          switch (score) {
-          case 3: // 11
-            // both prev and next cancel, point can be deleted
-            to_delete[i] = true;
-            break;
-          case 2: // 10
-            // merge in "next" direction
-            tmp_point_connect[i].next = polygon_grid[p].next;
-            break;
-          case 1: // 01
-            // merge in "prev" direction
-            tmp_point_connect[i].prev = polygon_grid[p].prev;
-            break;
-          default: // 00
-            // if we get here, we have two polygon vertices sharing the same grid location
-            // in an unmergable configuration; need to store both
-            tmp_point_connect[i].prev2 = polygon_grid[p].prev;
-            tmp_point_connect[i].next2 = polygon_grid[p].next;
-            tmp_point_connect[i].altpoint = true;
-          }
-        } else {
-          // case with alternative point at this location
-          int score =
-            8 * (tmp_point_connect[i].next == polygon_grid[p].prev2) + 4 * (tmp_point_connect[i].prev == polygon_grid[p].next2) +
-            2 * (tmp_point_connect[i].next == polygon_grid[p].prev) + (tmp_point_connect[i].prev == polygon_grid[p].next);
-          switch (score) {
-          case 9: // 1001
-            // three-way merge
-            tmp_point_connect[i].next = polygon_grid[p].next2;
-            tmp_point_connect[i].prev = polygon_grid[p].prev;
-            break;
-          case 6: // 0110
-            // three-way merge
-            tmp_point_connect[i].next = polygon_grid[p].next;
-            tmp_point_connect[i].prev = polygon_grid[p].prev2;
-            break;
-          case 8: // 1000
-            // two-way merge with alt point only
-            // set up merged alt point
-            tmp_point_connect[i].next2 = polygon_grid[p].next2;
-            tmp_point_connect[i].prev2 = tmp_point_connect[i].prev;
-            // copy over existing point as is
-            tmp_point_connect[i].prev = polygon_grid[p].prev;
-            tmp_point_connect[i].next = polygon_grid[p].next;
-            tmp_point_connect[i].altpoint = true;
-            break;
-          case 4: // 0100
-            // two-way merge with alt point only
-            // set up merged alt point
-            tmp_point_connect[i].prev2 = polygon_grid[p].prev2;
-            tmp_point_connect[i].next2 = tmp_point_connect[i].next;
-            // copy over existing point as is
-            tmp_point_connect[i].prev = polygon_grid[p].prev;
-            tmp_point_connect[i].next = polygon_grid[p].next;
-            tmp_point_connect[i].altpoint = true;
-            break;
-          case 2: // 0010
-            // two-way merge with original point only
-            // merge point
-            tmp_point_connect[i].next = polygon_grid[p].next;
-            // copy over existing alt point as is
-            tmp_point_connect[i].prev2 = polygon_grid[p].prev2;
-            tmp_point_connect[i].next2 = polygon_grid[p].next2;
-            tmp_point_connect[i].altpoint = true;
-            break;
-          case 1: // 0100
-            // two-way merge with original point only
-            // merge point
-            tmp_point_connect[i].prev = polygon_grid[p].prev;
-            // copy over existing alt point as is
-            tmp_point_connect[i].prev2 = polygon_grid[p].prev2;
-            tmp_point_connect[i].next2 = polygon_grid[p].next2;
-            tmp_point_connect[i].altpoint = true;
-            break;
-          default:
-            throw std::runtime_error("undefined merging configuration");
-          }
-        }
-      }
-    }
+  node_pool *pool;
 
-    //cout << "after merging:" << endl;
+  explicit pool_allocator(node_pool *pool) : pool(pool) {}
+  template <class U> pool_allocator(const pool_allocator<U> &other) : pool(other.pool) {}
 
-    // then we copy the connections into the polygon matrix
-    for (int i = 0; i < tmp_poly_size; i++) {
-      const grid_point &p = tmp_poly[i];
+  T* allocate(size_t n) {
+    if (n == 1 && node_pool::pooled(sizeof(T))) return static_cast<T*>(pool->allocate(sizeof(T)));
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
 
-      if (to_delete[i]) { // delete point if needed
-        polygon_grid.erase(p);
-      } else {            // otherwise, copy
-        polygon_grid[p] = tmp_point_connect[i];
-      }
-      //cout << p << ": " << tmp_point_connect[i] << endl;
+  void deallocate(T *p, size_t n) {
+    if (n == 1 && node_pool::pooled(sizeof(T))) {
+      pool->deallocate(p, sizeof(T));
+    } else {
+      ::operator delete(p);
     }
+  }
+};
 
-    //cout << "new grid:" << endl;
-    //print_polygons_state();
+template <class T, class U>
+bool operator==(const pool_allocator<T> &a, const pool_allocator<U> &b) {return a.pool == b.pool;}
+template <class T, class U>
+bool operator!=(const pool_allocator<T> &a, const pool_allocator<U> &b) {return a.pool != b.pool;}
+
+// connectivity store for the polygon vertices of the current contour
+//
+// Entries live in a flat pool; erased entries are recycled by later insertions. The lookup from grid_point to
+// pool entry goes either through a hash map or through a dense slot array that
+// has one slot per grid point and point type, i.e. one per grid node and one per
+// lo/hi intersection of each horizontal and vertical edge. In dense mode, all
+// accesses are O(1) array lookups and nothing is allocated per vertex once the
+// pool has grown to its working size. The slot array is allocated in tiles of
+// dense_tile x dense_tile grid points, each when the first vertex lands in it, so
+// it only takes memory where contours have been; tiles are kept for the next
+// contour. Entries of edge crossings also keep the
+// interpolated coordinate of the crossing, which the engines compute once when the
+// crossing is added, so that collecting the paths is a pure gather. Connections refer to
+// their neighbors by entry, which keeps an entry at 40 bytes and lets the collectors
+// follow paths without lookups; an entry therefore must not be recycled while other
+// entries still refer to it.
+class vertex_store {
+  struct entry {
+    grid_point p;
+    point_connect pc;
+    bool alive; // false if the entry has been erased
+    double coord; // for edge crossings, the coordinate along the edge
+  };
+
+  typedef pool_allocator<pair<const grid_point, int> > hashmap_allocator;
+  typedef unordered_map<grid_point, int, grid_point_hasher, equal_to<grid_point>, hashmap_allocator> hashmap;
+
+  int nrow, ncol;
+  bool dense;
+  vector<entry> entries;
+  vector<int> free_entries; // erased pool entries available for reuse
+  size_t n_held; // erased entries that aren't available for reuse yet
+  unique_ptr<node_pool> pool; // nodes of index_hashed; owned through a pointer that stays put
+  hashmap index_hashed;
+  // pool index per slot, -1 if empty, by tile; tiles no vertex has landed in yet point to
+  // no_tile, which stays all -1, so lookups need no check
+  vector<int*> index_dense;
+  vector<vector<int> > tiles; // the allocated tiles
+  vector<int> no_tile;
+  int tile_rows; // number of tiles along a grid column
+
+  size_t tile(const grid_point &p) const {
+    return static_cast<size_t>(p.r >> dense_tile_bits) + static_cast<size_t>(p.c >> dense_tile_bits) * tile_rows;
   }
 
+  static int tile_slot(const grid_point &p) {
+    return 5 * ((p.r & (dense_tile - 1)) + (p.c & (dense_tile - 1)) * dense_tile) + p.type;
+  }
 
-  void print_polygons_state() {
-    for (auto it = polygon_grid.begin(); it != polygon_grid.end(); it++) {
-      cout << it->first << ": " << it->second << endl;
+  // the slot of p, allocating its tile if needed
+  int& slot(const grid_point &p) {
+    int* &t = index_dense[tile(p)];
+    if (t == no_tile.data()) {
+      tiles.push_back(no_tile);
+      t = tiles.back().data();
     }
-    cout << endl;
+    return t[tile_slot(p)];
   }
 
-
-  // linear interpolation of boundary intersections
-  double interpolate(double x0, double x1, double z0, double z1, double value) {
-    double d = (value - z0) / (z1 - z0);
-    double x = x0 + d * (x1 - x0);
-    return x;
+  // sort key of p within its row
+  static size_t column_key(const grid_point &p) {
+    return 5 * static_cast<size_t>(p.c) + p.type;
   }
 
-  // calculate output coordinates for a given grid point
-  point calc_point_coords(const grid_point &p) {
-    switch(p.type) {
-    case grid:
-      return point(grid_x_p[p.c], grid_y_p[p.r]);
-    case hintersect_lo: // intersection with horizontal edge, low value
-      return point(interpolate(grid_x_p[p.c], grid_x_p[p.c+1], grid_z_p[p.r + p.c * nrow], grid_z_p[p.r + (p.c + 1) * nrow], vlo), grid_y_p[p.r]);
-    case hintersect_hi: // intersection with horizontal edge, high value
-      return point(interpolate(grid_x_p[p.c], grid_x_p[p.c+1], grid_z_p[p.r + p.c * nrow], grid_z_p[p.r + (p.c + 1) * nrow], vhi), grid_y_p[p.r]);
-    case vintersect_lo: // intersection with vertical edge, low value
-      return point(grid_x_p[p.c], interpolate(grid_y_p[p.r], grid_y_p[p.r+1], grid_z_p[p.r + p.c * nrow], grid_z_p[p.r + 1 + p.c * nrow], vlo));
-    case vintersect_hi: // intersection with vertical edge, high value
-      return point(grid_x_p[p.c], interpolate(grid_y_p[p.r], grid_y_p[p.r+1], grid_z_p[p.r + p.c * nrow], grid_z_p[p.r + 1 + p.c * nrow], vhi));
-    default:
-      return point(0, 0); // should never get here
+  int find(const grid_point &p) const {
+    if (dense) {
+      return index_dense[tile(p)][tile_slot(p)];
     }
+    hashmap::const_iterator it = index_hashed.find(p);
+    return (it == index_hashed.end()) ? -1 : it->second;
   }
 
 public:
-  isobander(double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double value_low = 0, double value_high = 0) :
-    grid_x_p(x), grid_y_p(y), grid_z_p(z), nrow(nrow), ncol(ncol),
-    vlo(value_low), vhi(value_high), interrupted(false)
-  {
-
-    if (lenx != ncol) {throw std::invalid_argument("Number of x coordinates must match number of columns in density matrix.");}
-    if (leny != nrow) {throw std::invalid_argument("Number of y coordinates must match number of rows in density matrix.");}
+  vertex_store() :
+    nrow(0), ncol(0), dense(false), n_held(0), pool(new node_pool()),
+    index_hashed(0, grid_point_hasher(), equal_to<grid_point>(), hashmap_allocator(pool.get())), tile_rows(0) {}
+
+  // (re)configure the store for a grid of the given size; discards all entries
+  void setup(int nrow_in, int ncol_in, store_mode mode) {
+    if (ncol_in > max_grid_columns) {throw std::invalid_argument("Number of columns exceeds the maximum of 134217727.");}
+    clear();
+    nrow = nrow_in;
+    ncol = ncol_in;
+    size_t nodes = static_cast<size_t>(nrow) * static_cast<size_t>(ncol);
+    dense = (mode == store_dense) || (mode == store_auto && nodes <= dense_store_max_nodes);
+    vector<int*>().swap(index_dense);
+    vector<vector<int> >().swap(tiles);
+    if (dense) {
+      no_tile.assign(5 * dense_tile * dense_tile, -1);
+      tile_rows = (nrow + dense_tile - 1) >> dense_tile_bits;
+      index_dense.assign(static_cast<size_t>(tile_rows) * ((ncol + dense_tile - 1) >> dense_tile_bits), no_tile.data());
+      hashmap(0, grid_point_hasher(), equal_to<grid_point>(), hashmap_allocator(pool.get())).swap(index_hashed);
+    }
   }
 
-  virtual ~isobander() {}
+  bool is_dense() const {return dense;}
 
-  bool was_interrupted() {return interrupted;}
+  size_t count(const grid_point &p) const {
+    return find(p) >= 0;
+  }
 
-  void set_value(double value_low, double value_high) {
-    vlo = value_low;
-    vhi = value_high;
+  // index of the entry of p, or -1 if there is none
+  int lookup(const grid_point &p) const {
+    return find(p);
   }
 
-  virtual void calculate_contour() {
-    // clear polygon grid and associated internal variables
-    reset_grid();
+  // adds an entry for p, which must not have one yet, with the given edge coordinate and a
+  // default connection; returns its index, which stays valid until the entry is erased
+  int insert(const grid_point &p, double coord) {
+    entry e = {p, point_connect(), true, coord};
+    int i;
+    if (free_entries.empty()) {
+      i = entries.size();
+      entries.push_back(e);
+    } else {
+      i = free_entries.back();
+      free_entries.pop_back();
+      entries[i] = e;
+    }
+    if (dense) {
+      slot(p) = i;
+    } else {
+      index_hashed[p] = i;
+    }
+    return i;
+  }
 
-    // setup matrix of ternarized cell representations
-    vector<int> ternarized(nrow*ncol);
-    vector<int>::iterator iv = ternarized.begin();
+  // returns the connection stored for p, inserting a default one if needed;
+  // the reference is invalidated by the next insertion
+  point_connect& operator[](const grid_point &p) {
+    int i = find(p);
+    if (i < 0) i = insert(p, 0);
+    return entries[i].pc;
+  }
 
-    for (int i = 0; i < nrow * ncol; ++i) {
-      *iv = (grid_z_p[i] >= vlo && grid_z_p[i] < vhi) + 2*(grid_z_p[i] >= vhi);
-      iv++;
+  // removes the entry of p; with recycle false, the entry keeps its key and isn't reused
+  // until it is passed to recycle(), so that entries that still refer to it can look up
+  // which grid point it was
+  void erase(const grid_point &p, bool recycle_entry = true) {
+    int i = find(p);
+    if (i < 0) return;
+    entries[i].alive = false;
+    if (recycle_entry) {
+      free_entries.push_back(i);
+    } else {
+      n_held++;
     }
+    if (dense) {
+      slot(p) = -1;
+    } else {
+      index_hashed.erase(p);
+    }
+  }
 
+  void recycle(int i) {
+    free_entries.push_back(i);
+    n_held--;
+  }
 
-    vector<int> cells((nrow - 1) * (ncol - 1));
-
-    for (int r = 0; r < nrow-1; r++) {
-      for (int c = 0; c < ncol-1; c++) {
-        int index;
-        if (!isfinite(grid_z_p[r + c * nrow]) || !isfinite(grid_z_p[r + (c + 1) * nrow]) ||
-            !isfinite(grid_z_p[r + 1 + c * nrow]) || !isfinite(grid_z_p[r + 1 + (c + 1) * nrow])) {
-          // we don't draw any contours if at least one of the corners is NA
-          index = 0;
-        } else {
-          index = 27*ternarized[r + c * nrow] + 9*ternarized[r + (c + 1) * nrow] + 3*ternarized[r + 1 + (c + 1) * nrow] + ternarized[r + 1 + c * nrow];
-        }
-        cells[r + c * (nrow - 1)] = index;
-        //cout << index << " ";
+  // removes all entries; in dense mode only the slots that were used get reset
+  void clear() {
+    if (dense) {
+      for (auto it = entries.begin(); it != entries.end(); it++) {
+        slot(it->p) = -1;
       }
-      //cout << endl;
+    } else {
+      // the map hands its nodes back to the pool, which then starts over
+      index_hashed.clear();
+      pool->release();
     }
-    // if (checkInterrupt()) {
-    //   interrupted = true;
-    //   return;
-    // }
+    entries.clear();
+    free_entries.clear();
+    n_held = 0;
+  }
 
-    // all polygons must be drawn clockwise for proper merging
-    for (int r = 0; r < nrow-1; r++) {
-      for (int c = 0; c < ncol-1; c++) {
-        //cout << r << " " << c << " " << cells(r, c) << endl;
-        switch(cells[r + c * (nrow - 1)]) {
-        // doing cases out of order, sorted by type, is easier to keep track of
-
-        // no contour
-        case 0: break;
-        case 80: break;
-
-        // single triangle
-        case 1: // 0001
-          poly_start(r, c, vintersect_lo);
-          poly_add(r+1, c, hintersect_lo);
-          poly_add(r+1, c, grid);
-          poly_merge();
-          break;
-        case 3: // 0010
-          poly_start(r, c+1, vintersect_lo);
-          poly_add(r+1, c+1, grid);
-          poly_add(r+1, c, hintersect_lo);
-          poly_merge();
-          break;
-        case 9: // 0100
-          poly_start(r, c, hintersect_lo);
-          poly_add(r, c+1, grid);
-          poly_add(r, c+1, vintersect_lo);
-          poly_merge();
-          break;
-        case 27: // 1000
-          poly_start(r, c, vintersect_lo);
-          poly_add(r, c, grid);
-          poly_add(r, c, hintersect_lo);
-          poly_merge();
-          break;
-        case 79: // 2221
-          poly_start(r, c, vintersect_hi);
-          poly_add(r+1, c, hintersect_hi);
-          poly_add(r+1, c, grid);
-          poly_merge();
-          break;
-        case 77: // 2212
-          poly_start(r, c+1, vintersect_hi);
-          poly_add(r+1, c+1, grid);
-          poly_add(r+1, c, hintersect_hi);
-          poly_merge();
-          break;
-        case 71: // 2122
-          poly_start(r, c, hintersect_hi);
-          poly_add(r, c+1, grid);
-          poly_add(r, c+1, vintersect_hi);
-          poly_merge();
-          break;
-        case 53: // 1222
-          poly_start(r, c, vintersect_hi);
-          poly_add(r, c, grid);
-          poly_add(r, c, hintersect_hi);
-          poly_merge();
-          break;
+  const node_pool& node_memory() const {return *pool;}
 
-          // single trapezoid
-        case 78: // 2220
-          poly_start(r, c, vintersect_hi);
-          poly_add(r+1, c, hintersect_hi);
-          poly_add(r+1, c, hintersect_lo);
-          poly_add(r, c, vintersect_lo);
-          poly_merge();
-          break;
-        case 74: // 2202
-          poly_start(r+1, c, hintersect_hi);
-          poly_add(r, c+1, vintersect_hi);
-          poly_add(r, c+1, vintersect_lo);
-          poly_add(r+1, c, hintersect_lo);
-          poly_merge();
-          break;
-        case 62: // 2022
-          poly_start(r, c+1, vintersect_hi);
-          poly_add(r, c, hintersect_hi);
-          poly_add(r, c, hintersect_lo);
-          poly_add(r, c+1, vintersect_lo);
-          poly_merge();
-          break;
-        case 26: // 0222
-          poly_start(r, c, hintersect_hi);
-          poly_add(r, c, vintersect_hi);
-          poly_add(r, c, vintersect_lo);
-          poly_add(r, c, hintersect_lo);
-          poly_merge();
-          break;
-        case 2: // 0002
-          poly_start(r, c, vintersect_lo);
-          poly_add(r+1, c, hintersect_lo);
-          poly_add(r+1, c, hintersect_hi);
-          poly_add(r, c, vintersect_hi);
-          poly_merge();
-          break;
-        case 6: // 0020
-          poly_start(r+1, c, hintersect_lo);
-          poly_add(r, c+1, vintersect_lo);
-          poly_add(r, c+1, vintersect_hi);
-          poly_add(r+1, c, hintersect_hi);
-          poly_merge();
-          break;
-        case 18: // 0200
-          poly_start(r, c+1, vintersect_lo);
-          poly_add(r, c, hintersect_lo);
-          poly_add(r, c, hintersect_hi);
-          poly_add(r, c+1, vintersect_hi);
-          poly_merge();
-          break;
-        case 54: // 2000
-          poly_start(r, c, hintersect_lo);
-          poly_add(r, c, vintersect_lo);
-          poly_add(r, c, vintersect_hi);
-          poly_add(r, c, hintersect_hi);
-          poly_merge();
-          break;
+  // bytes allocated by the store, including the node pool and the index
+  size_t memory() const {
+    return entries.capacity() * sizeof(entry) + free_entries.capacity() * sizeof(int) +
+      pool->chunk_allocations() * node_pool::chunk_size + index_hashed.bucket_count() * sizeof(void*) +
+      index_dense.capacity() * sizeof(int*) + (tiles.capacity() * sizeof(vector<int>)) +
+      (tiles.size() + !no_tile.empty()) * no_tile.size() * sizeof(int);
+  }
 
-          // single rectangle
-        case 4: // 0011
-          poly_start(r, c, vintersect_lo);
-          poly_add(r, c+1, vintersect_lo);
-          poly_add(r+1, c+1, grid);
-          poly_add(r+1, c, grid);
-          poly_merge();
-          break;
-        case 12: // 0110
-          poly_start(r, c, hintersect_lo);
-          poly_add(r, c+1, grid);
-          poly_add(r+1, c+1, grid);
-          poly_add(r+1, c, hintersect_lo);
-          poly_merge();
-          break;
-        case 36: // 1100
-          poly_start(r, c, grid);
-          poly_add(r, c+1, grid);
-          poly_add(r, c+1, vintersect_lo);
-          poly_add(r, c, vintersect_lo);
-          poly_merge();
-          break;
-        case 28: // 1001
-          poly_start(r, c, hintersect_lo);
-          poly_add(r+1, c, hintersect_lo);
-          poly_add(r+1, c, grid);
-          poly_add(r, c, grid);
-          poly_merge();
-          break;
-        case 76: // 2211
-          poly_start(r, c, vintersect_hi);
-          poly_add(r, c+1, vintersect_hi);
-          poly_add(r+1, c+1, grid);
-          poly_add(r+1, c, grid);
-          poly_merge();
-          break;
-        case 68: // 2112
-          poly_start(r, c, hintersect_hi);
-          poly_add(r, c+1, grid);
-          poly_add(r+1, c+1, grid);
-          poly_add(r+1, c, hintersect_hi);
-          poly_merge();
-          break;
-        case 44: // 1122
-          poly_start(r, c, grid);
-          poly_add(r, c+1, grid);
-          poly_add(r, c+1, vintersect_hi);
-          poly_add(r, c, vintersect_hi);
-          poly_merge();
-          break;
-        case 52: // 1221
-          poly_start(r, c, hintersect_hi);
-          poly_add(r+1, c, hintersect_hi);
-          poly_add(r+1, c, grid);
-          poly_add(r, c, grid);
-          poly_merge();
-          break;
-        case 72: // 2200
-          poly_start(r, c, vintersect_hi);
-          poly_add(r, c+1, vintersect_hi);
-          poly_add(r, c+1, vintersect_lo);
-          poly_add(r, c, vintersect_lo);
-          poly_merge();
-          break;
-        case 56: // 2002
-          poly_start(r, c, hintersect_hi);
-          poly_add(r, c, hintersect_lo);
-          poly_add(r+1, c, hintersect_lo);
-          poly_add(r+1, c, hintersect_hi);
-          poly_merge();
-          break;
-        case 8: // 0022
-          poly_start(r, c, vintersect_lo);
-          poly_add(r, c+1, vintersect_lo);
-          poly_add(r, c+1, vintersect_hi);
-          poly_add(r, c, vintersect_hi);
-          poly_merge();
-          break;
-        case 24: // 0220
-          poly_start(r, c, hintersect_lo);
-          poly_add(r, c, hintersect_hi);
-          poly_add(r+1, c, hintersect_hi);
-          poly_add(r+1, c, hintersect_lo);
-          poly_merge();
-          break;
+  // number of live entries
+  size_t live() const {return entries.size() - free_entries.size() - n_held;}
+
+  // iteration over the pool; erased entries must be skipped
+  size_t size() const {return entries.size();}
+  bool alive(size_t i) const {return entries[i].alive;}
+  const grid_point& key(size_t i) const {return entries[i].p;}
+  point_connect& value(size_t i) {return entries[i].pc;}
+  double coord(size_t i) const {return entries[i].coord;}
+
+  // indices of all live entries in raster order, i.e. by row, then column, then point type;
+  // unlike pool order, this depends only on the contour, not on the order of insertions and
+  // erasures. Two passes of counting sort, by column and type, then stably by row; by_col
+  // and count are scratch space.
+  void raster_order(vector<int> &order, vector<int> &by_col, vector<int> &count) const {
+    size_t n = live();
+
+    count.assign(5 * static_cast<size_t>(ncol) + 1, 0);
+    for (size_t i = 0; i < entries.size(); i++) {
+      if (entries[i].alive) count[column_key(entries[i].p) + 1]++;
+    }
+    for (size_t k = 1; k < count.size(); k++) {
+      count[k] += count[k - 1];
+    }
+    by_col.resize(n);
+    for (size_t i = 0; i < entries.size(); i++) {
+      if (entries[i].alive) by_col[count[column_key(entries[i].p)]++] = i;
+    }
 
-        // single square
-        case 40: // 1111
-          poly_start(r, c, grid);
-          poly_add(r, c+1, grid);
-          poly_add(r+1, c+1, grid);
-          poly_add(r+1, c, grid);
-          poly_merge();
-          break;
+    count.assign(nrow + 1, 0);
+    for (size_t k = 0; k < n; k++) {
+      count[entries[by_col[k]].p.r + 1]++;
+    }
+    for (int r = 0; r < nrow; r++) {
+      count[r + 1] += count[r];
+    }
+    order.resize(n);
+    for (size_t k = 0; k < n; k++) {
+      order[count[entries[by_col[k]].p.r]++] = by_col[k];
+    }
+  }
+};
 
-        // single pentagon
-        case 49: // 1211
-          poly_start(r, c, grid);
-          poly_add(r, c, hintersect_hi);
-          poly_add(r, c+1, vintersect_hi);
-          poly_add(r+1, c+1, grid);
-          poly_add(r+1, c, grid);
-          poly_merge();
-          break;
-        case 67: // 2111
-          poly_start(r+1, c, grid);
-          poly_add(r, c, vintersect_hi);
-          poly_add(r, c, hintersect_hi);
-          poly_add(r, c+1, grid);
-          poly_add(r+1, c+1, grid);
-          poly_merge();
-          break;
-        case 41: // 1112
-          poly_start(r, c, grid);
-          poly_add(r, c+1, grid);
-          poly_add(r+1, c+1, grid);
-          poly_add(r+1, c, hintersect_hi);
-          poly_add(r, c, vintersect_hi);
-          poly_merge();
-          break;
-        case 43: // 1121
-          poly_start(r, c, grid);
-          poly_add(r, c+1, grid);
-          poly_add(r, c+1, vintersect_hi);
-          poly_add(r+1, c, hintersect_hi);
-          poly_add(r+1, c, grid);
-          poly_merge();
-          break;
-        case 31: // 1011
-          poly_start(r, c, grid);
-          poly_add(r, c, hintersect_lo);
-          poly_add(r, c+1, vintersect_lo);
-          poly_add(r+1, c+1, grid);
-          poly_add(r+1, c, grid);
-          poly_merge();
-          break;
-        case 13: // 0111
-          poly_start(r+1, c, grid);
-          poly_add(r, c, vintersect_lo);
-          poly_add(r, c, hintersect_lo);
-          poly_add(r, c+1, grid);
-          poly_add(r+1, c+1, grid);
-          poly_merge();
-          break;
-        case 39: // 1110
-          poly_start(r, c, grid);
-          poly_add(r, c+1, grid);
-          poly_add(r+1, c+1, grid);
-          poly_add(r+1, c, hintersect_lo);
-          poly_add(r, c, vintersect_lo);
-          poly_merge();
-          break;
-        case 37: // 1101
-          poly_start(r, c, grid);
-          poly_add(r, c+1, grid);
-          poly_add(r, c+1, vintersect_lo);
-          poly_add(r+1, c, hintersect_lo);
-          poly_add(r+1, c, grid);
-          poly_merge();
-          break;
-        case 45: // 1200
-          poly_start(r, c, grid);
-          poly_add(r, c, hintersect_hi);
-          poly_add(r, c+1, vintersect_hi);
-          poly_add(r, c+1, vintersect_lo);
-          poly_add(r, c, vintersect_lo);
-          poly_merge();
-          break;
-        case 15: // 0120
-          poly_start(r, c+1, grid);
-          poly_add(r, c+1, vintersect_hi);
-          poly_add(r+1, c, hintersect_hi);
-          poly_add(r+1, c, hintersect_lo);
-          poly_add(r, c, hintersect_lo);
-          poly_merge();
-          break;
-        case 5: // 0012
-          poly_start(r, c, vintersect_lo);
-          poly_add(r, c+1, vintersect_lo);
-          poly_add(r+1, c+1, grid);
-          poly_add(r+1, c, hintersect_hi);
-          poly_add(r, c, vintersect_hi);
-          poly_merge();
-          break;
-        case 55: // 2001
-          poly_start(r+1, c, grid);
-          poly_add(r, c, vintersect_hi);
-          poly_add(r, c, hintersect_hi);
-          poly_add(r, c, hintersect_lo);
-          poly_add(r+1, c, hintersect_lo);
-          poly_merge();
-          break;
-        case 35: // 1022
-          poly_start(r, c, grid);
-          poly_add(r, c, hintersect_lo);
-          poly_add(r, c+1, vintersect_lo);
-          poly_add(r, c+1, vintersect_hi);
-          poly_add(r, c, vintersect_hi);
-          poly_merge();
-          break;
-        case 65: // 2102
-          poly_start(r, c+1, grid);
-          poly_add(r, c+1, vintersect_lo);
-          poly_add(r+1, c, hintersect_lo);
-          poly_add(r+1, c, hintersect_hi);
-          poly_add(r, c, hintersect_hi);
-          poly_merge();
-          break;
-        case 75: // 2210
-          poly_start(r, c, vintersect_hi);
-          poly_add(r, c+1, vintersect_hi);
-          poly_add(r+1, c+1, grid);
-          poly_add(r+1, c, hintersect_lo);
-          poly_add(r, c, vintersect_lo);
-          poly_merge();
-          break;
-        case 25: // 0221
-          poly_start(r+1, c, grid);
-          poly_add(r, c, vintersect_lo);
-          poly_add(r, c, hintersect_lo);
-          poly_add(r, c, hintersect_hi);
-          poly_add(r+1, c, hintersect_hi);
-          poly_merge();
-          break;
-        case 29: // 1002
-          poly_start(r, c, grid);
-          poly_add(r, c, hintersect_lo);
-          poly_add(r+1, c, hintersect_lo);
-          poly_add(r+1, c, hintersect_hi);
-          poly_add(r, c, vintersect_hi);
-          poly_merge();
-          break;
-        case 63: // 2100
-          poly_start(r, c+1, grid);
-          poly_add(r, c+1, vintersect_lo);
-          poly_add(r, c, vintersect_lo);
-          poly_add(r, c, vintersect_hi);
-          poly_add(r, c, hintersect_hi);
-          poly_merge();
-          break;
-        case 21: // 0210
-          poly_start(r+1, c+1, grid);
-          poly_add(r+1, c, hintersect_lo);
-          poly_add(r, c, hintersect_lo);
-          poly_add(r, c, hintersect_hi);
-          poly_add(r, c+1, vintersect_hi);
-          poly_merge();
-          break;
-        case 7: // 0021
-          poly_start(r+1, c, grid);
-          poly_add(r, c, vintersect_lo);
-          poly_add(r, c+1, vintersect_lo);
-          poly_add(r, c+1, vintersect_hi);
-          poly_add(r+1, c, hintersect_hi);
-          poly_merge();
-          break;
-        case 51: // 1220
-          poly_start(r, c, grid);
-          poly_add(r, c, hintersect_hi);
-          poly_add(r+1, c, hintersect_hi);
-          poly_add(r+1, c, hintersect_lo);
-          poly_add(r, c, vintersect_lo);
-          poly_merge();
-          break;
-        case 17: // 0122
-          poly_start(r, c+1, grid);
-          poly_add(r, c+1, vintersect_hi);
-          poly_add(r, c, vintersect_hi);
-          poly_add(r, c, vintersect_lo);
-          poly_add(r, c, hintersect_lo);
-          poly_merge();
-          break;
-        case 59: // 2012
-          poly_start(r+1, c+1, grid);
-          poly_add(r+1, c, hintersect_hi);
-          poly_add(r, c, hintersect_hi);
-          poly_add(r, c, hintersect_lo);
-          poly_add(r, c+1, vintersect_lo);
-          poly_merge();
-          break;
-        case 73: // 2201
-          poly_start(r+1, c, grid);
-          poly_add(r, c, vintersect_hi);
-          poly_add(r, c+1, vintersect_hi);
-          poly_add(r, c+1, vintersect_lo);
-          poly_add(r+1, c, hintersect_lo);
-          poly_merge();
-          break;
+// copies collected output vectors into a newly allocated resultStruct
+resultStruct make_result(const vector<double> &x_out, const vector<double> &y_out, const vector<int> &id) {
+  int len = x_out.size();
 
-          // single hexagon
-        case 22: // 0211
-          poly_start(r+1, c, grid);
-          poly_add(r, c, vintersect_lo);
-          poly_add(r, c, hintersect_lo);
-          poly_add(r, c, hintersect_hi);
-          poly_add(r, c+1, vintersect_hi);
-          poly_add(r+1, c+1, grid);
-          poly_merge();
-          break;
-        case 66: // 2110
-          poly_start(r, c+1, grid);
-          poly_add(r+1, c+1, grid);
-          poly_add(r+1, c, hintersect_lo);
-          poly_add(r, c, vintersect_lo);
-          poly_add(r, c, vintersect_hi);
-          poly_add(r, c, hintersect_hi);
-          poly_merge();
-          break;
-        case 38: // 1102
-          poly_start(r, c, grid);
-          poly_add(r, c+1, grid);
-          poly_add(r, c+1, vintersect_lo);
-          poly_add(r+1, c, hintersect_lo);
-          poly_add(r+1, c, hintersect_hi);
-          poly_add(r, c, vintersect_hi);
-          poly_merge();
-          break;
-        case 34: // 1021
-          poly_start(r, c, grid);
-          poly_add(r, c, hintersect_lo);
-          poly_add(r, c+1, vintersect_lo);
-          poly_add(r, c+1, vintersect_hi);
-          poly_add(r+1, c, hintersect_hi);
-          poly_add(r+1, c, grid);
-          poly_merge();
-          break;
-        case 58: // 2011
-          poly_start(r+1, c, grid);
-          poly_add(r, c, vintersect_hi);
-          poly_add(r, c, hintersect_hi);
-          poly_add(r, c, hintersect_lo);
-          poly_add(r, c+1, vintersect_lo);
-          poly_add(r+1, c+1, grid);
-          poly_merge();
-          break;
-        case 14: // 0112
-          poly_start(r, c+1, grid);
-          poly_add(r+1, c+1, grid);
-          poly_add(r+1, c, hintersect_hi);
-          poly_add(r, c, vintersect_hi);
-          poly_add(r, c, vintersect_lo);
-          poly_add(r, c, hintersect_lo);
-          poly_merge();
-          break;
-        case 42: // 1120
-          poly_start(r, c, grid);
-          poly_add(r, c+1, grid);
-          poly_add(r, c+1, vintersect_hi);
-          poly_add(r+1, c, hintersect_hi);
-          poly_add(r+1, c, hintersect_lo);
-          poly_add(r, c, vintersect_lo);
-          poly_merge();
-          break;
-        case 46: // 1201
-          poly_start(r, c, grid);
-          poly_add(r, c, hintersect_hi);
-          poly_add(r, c+1, vintersect_hi);
-          poly_add(r, c+1, vintersect_lo);
-          poly_add(r+1, c, hintersect_lo);
-          poly_add(r+1, c, grid);
-          poly_merge();
-          break;
-        case 64: // 2101
-          poly_start(r+1, c, grid);
-          poly_add(r, c, vintersect_hi);
-          poly_add(r, c, hintersect_hi);
-          poly_add(r, c+1, grid);
-          poly_add(r, c+1, vintersect_lo);
-          poly_add(r+1, c, hintersect_lo);
-          poly_merge();
-          break;
-        case 16: // 0121
-          poly_start(r, c+1, grid);
-          poly_add(r, c+1, vintersect_hi);
-          poly_add(r+1, c, hintersect_hi);
-          poly_add(r+1, c, grid);
-          poly_add(r, c, vintersect_lo);
-          poly_add(r, c, hintersect_lo);
-          poly_merge();
-          break;
-        case 32: // 1012
-          poly_start(r, c, grid);
-          poly_add(r, c, hintersect_lo);
-          poly_add(r, c+1, vintersect_lo);
-          poly_add(r+1, c+1, grid);
-          poly_add(r+1, c, hintersect_hi);
-          poly_add(r, c, vintersect_hi);
-          poly_merge();
-          break;
-        case 48: // 1210
-          poly_start(r, c, grid);
-          poly_add(r, c, hintersect_hi);
-          poly_add(r, c+1, vintersect_hi);
-          poly_add(r+1, c+1, grid);
-          poly_add(r+1, c, hintersect_lo);
-          poly_add(r, c, vintersect_lo);
-          poly_merge();
-          break;
+  double* xs = new double[len];
+  double* ys = new double[len];
+  int* ids = new int[len];
 
-        // 6-sided saddle
-        case 10: // 0101
-          {
-            double vc = central_value(r, c);
-            if (vc < vlo) {
-              poly_start(r+1, c, grid);
-              poly_add(r, c, vintersect_lo);
-              poly_add(r+1, c, hintersect_lo);
-              poly_merge();
-              poly_start(r, c+1, grid);
-              poly_add(r, c+1, vintersect_lo);
-              poly_add(r, c, hintersect_lo);
-              poly_merge();
-            } else {
-              poly_start(r+1, c, grid);
-              poly_add(r, c, vintersect_lo);
-              poly_add(r, c, hintersect_lo);
-              poly_add(r, c+1, grid);
-              poly_add(r, c+1, vintersect_lo);
-              poly_add(r+1, c, hintersect_lo);
-              poly_merge();
-            }
-          }
-          break;
-        case 30: // 1010
-          {
-            double vc = central_value(r, c);
-            if (vc < vlo) {
-              poly_start(r, c, grid);
-              poly_add(r, c, hintersect_lo);
-              poly_add(r, c, vintersect_lo);
-              poly_merge();
-              poly_start(r+1, c+1, grid);
-              poly_add(r+1, c, hintersect_lo);
-              poly_add(r, c+1, vintersect_lo);
-              poly_merge();
-            } else {
-              poly_start(r, c, grid);
-              poly_add(r, c, hintersect_lo);
-              poly_add(r, c+1, vintersect_lo);
-              poly_add(r+1, c+1, grid);
-              poly_add(r+1, c, hintersect_lo);
-              poly_add(r, c, vintersect_lo);
-              poly_merge();
-            }
-          }
-          break;
-        case 70: // 2121
-          {
-            double vc = central_value(r, c);
-            if (vc >= vhi) {
-              poly_start(r+1, c, grid);
-              poly_add(r, c, vintersect_hi);
-              poly_add(r+1, c, hintersect_hi);
-              poly_merge();
-              poly_start(r, c+1, grid);
-              poly_add(r, c+1, vintersect_hi);
-              poly_add(r, c, hintersect_hi);
-              poly_merge();
-            } else {
-              poly_start(r+1, c, grid);
-              poly_add(r, c, vintersect_hi);
-              poly_add(r, c, hintersect_hi);
-              poly_add(r, c+1, grid);
-              poly_add(r, c+1, vintersect_hi);
-              poly_add(r+1, c, hintersect_hi);
-              poly_merge();
-            }
-          }
-          break;
-        case 50: // 1212
-          {
-            double vc = central_value(r, c);
-            if (vc >= vhi) {
-              poly_start(r, c, grid);
-              poly_add(r, c, hintersect_hi);
-              poly_add(r, c, vintersect_hi);
-              poly_merge();
-              poly_start(r+1, c+1, grid);
-              poly_add(r+1, c, hintersect_hi);
-              poly_add(r, c+1, vintersect_hi);
-              poly_merge();
-            } else {
-              poly_start(r, c, grid);
-              poly_add(r, c, hintersect_hi);
-              poly_add(r, c+1, vintersect_hi);
-              poly_add(r+1, c+1, grid);
-              poly_add(r+1, c, hintersect_hi);
-              poly_add(r, c, vintersect_hi);
-              poly_merge();
-            }
-          }
-          break;
+  copy(x_out.begin(), x_out.end(), xs);
+  copy(y_out.begin(), y_out.end(), ys);
+  copy(id.begin(), id.end(), ids);
 
-        // 7-sided saddle
-        case 69: // 2120
-          {
-            double vc = central_value(r, c);
-            if (vc >= vhi) {
-              poly_start(r, c+1, grid);
-              poly_add(r, c+1, vintersect_hi);
-              poly_add(r, c, hintersect_hi);
-              poly_merge();
-              poly_start(r, c, vintersect_hi);
-              poly_add(r+1, c, hintersect_hi);
-              poly_add(r+1, c, hintersect_lo);
-              poly_add(r, c, vintersect_lo);
-              poly_merge();
-            } else {
-              poly_start(r, c+1, grid);
-              poly_add(r, c+1, vintersect_hi);
-              poly_add(r+1, c, hintersect_hi);
-              poly_add(r+1, c, hintersect_lo);
-              poly_add(r, c, vintersect_lo);
-              poly_add(r, c, vintersect_hi);
-              poly_add(r, c, hintersect_hi);
-              poly_merge();
-            }
-          }
-          break;
-        case 61: // 2021
-          {
-            double vc = central_value(r, c);
-              if (vc >= vhi) {
-                poly_start(r+1, c, grid);
-                poly_add(r, c, vintersect_hi);
-                poly_add(r+1, c, hintersect_hi);
-                poly_merge();
-                poly_start(r, c+1, vintersect_hi);
-                poly_add(r, c, hintersect_hi);
-                poly_add(r, c, hintersect_lo);
-                poly_add(r, c+1, vintersect_lo);
-                poly_merge();
-              } else {
-                poly_start(r+1, c, grid);
-                poly_add(r, c, vintersect_hi);
-                poly_add(r, c, hintersect_hi);
-                poly_add(r, c, hintersect_lo);
-                poly_add(r, c+1, vintersect_lo);
-                poly_add(r, c+1, vintersect_hi);
-                poly_add(r+1, c, hintersect_hi);
-                poly_merge();
-              }
-            }
-          break;
-        case 47: // 1202
-          {
-            double vc = central_value(r, c);
-            if (vc >= vhi) {
-              poly_start(r, c, grid);
-              poly_add(r, c, hintersect_hi);
-              poly_add(r, c, vintersect_hi);
-              poly_merge();
-              poly_start(r+1, c, hintersect_hi);
-              poly_add(r, c+1, vintersect_hi);
-              poly_add(r, c+1, vintersect_lo);
-              poly_add(r+1, c, hintersect_lo);
-              poly_merge();
-            } else {
-              poly_start(r, c, grid);
-              poly_add(r, c, hintersect_hi);
-              poly_add(r, c+1, vintersect_hi);
-              poly_add(r, c+1, vintersect_lo);
-              poly_add(r+1, c, hintersect_lo);
-              poly_add(r+1, c, hintersect_hi);
-              poly_add(r, c, vintersect_hi);
-              poly_merge();
-            }
-          }
-          break;
-        case 23: // 0212
-          {
-            double vc = central_value(r, c);
-            if (vc >= vhi) {
-              poly_start(r+1, c+1, grid);
-              poly_add(r+1, c, hintersect_hi);
-              poly_add(r, c+1, vintersect_hi);
-              poly_merge();
-              poly_start(r, c, hintersect_hi);
-              poly_add(r, c, vintersect_hi);
-              poly_add(r, c, vintersect_lo);
-              poly_add(r, c, hintersect_lo);
-              poly_merge();
-            } else {
-              poly_start(r+1, c+1, grid);
-              poly_add(r+1, c, hintersect_hi);
-              poly_add(r, c, vintersect_hi);
-              poly_add(r, c, vintersect_lo);
-              poly_add(r, c, hintersect_lo);
-              poly_add(r, c, hintersect_hi);
-              poly_add(r, c+1, vintersect_hi);
-              poly_merge();
-            }
-          }
-          break;
-        case 11: // 0102
-          {
-            double vc = central_value(r, c);
-            if (vc < vlo) {
-              poly_start(r, c+1, grid);
-              poly_add(r, c+1, vintersect_lo);
-              poly_add(r, c, hintersect_lo);
-              poly_merge();
-              poly_start(r, c, vintersect_lo);
-              poly_add(r+1, c, hintersect_lo);
-              poly_add(r+1, c, hintersect_hi);
-              poly_add(r, c, vintersect_hi);
-              poly_merge();
-            } else {
-              poly_start(r, c+1, grid);
-              poly_add(r, c+1, vintersect_lo);
-              poly_add(r+1, c, hintersect_lo);
-              poly_add(r+1, c, hintersect_hi);
-              poly_add(r, c, vintersect_hi);
-              poly_add(r, c, vintersect_lo);
-              poly_add(r, c, hintersect_lo);
-              poly_merge();
-            }
-          }
-          break;
-        case 19: // 0201
-          {
-            double vc = central_value(r, c);
-            if (vc < vlo) {
-              poly_start(r+1, c, grid);
-              poly_add(r, c, vintersect_lo);
-              poly_add(r+1, c, hintersect_lo);
-              poly_merge();
-              poly_start(r, c+1, vintersect_lo);
-              poly_add(r, c, hintersect_lo);
-              poly_add(r, c, hintersect_hi);
-              poly_add(r, c+1, vintersect_hi);
-              poly_merge();
-            } else {
-              poly_start(r+1, c, grid);
-              poly_add(r, c, vintersect_lo);
-              poly_add(r, c, hintersect_lo);
-              poly_add(r, c, hintersect_hi);
-              poly_add(r, c+1, vintersect_hi);
-              poly_add(r, c+1, vintersect_lo);
-              poly_add(r+1, c, hintersect_lo);
-              poly_merge();
-            }
-          }
-          break;
-        case 33: // 1020
-          {
-            double vc = central_value(r, c);
-            if (vc < vlo) {
-              poly_start(r, c, grid);
-              poly_add(r, c, hintersect_lo);
-              poly_add(r, c, vintersect_lo);
-              poly_merge();
-              poly_start(r+1, c, hintersect_lo);
-              poly_add(r, c+1, vintersect_lo);
-              poly_add(r, c+1, vintersect_hi);
-              poly_add(r+1, c, hintersect_hi);
-              poly_merge();
-            } else {
-              poly_start(r, c, grid);
-              poly_add(r, c, hintersect_lo);
-              poly_add(r, c+1, vintersect_lo);
-              poly_add(r, c+1, vintersect_hi);
-              poly_add(r+1, c, hintersect_hi);
-              poly_add(r+1, c, hintersect_lo);
-              poly_add(r, c, vintersect_lo);
-              poly_merge();
-            }
-          }
-          break;
-        case 57: // 2010
-          {
-            double vc = central_value(r, c);
-            if (vc < vlo) {
-              poly_start(r+1, c+1, grid);
-              poly_add(r+1, c, hintersect_lo);
-              poly_add(r, c+1, vintersect_lo);
-              poly_merge();
-              poly_start(r, c, hintersect_lo);
-              poly_add(r, c, vintersect_lo);
-              poly_add(r, c, vintersect_hi);
-              poly_add(r, c, hintersect_hi);
-              poly_merge();
-            } else {
-              poly_start(r+1, c+1, grid);
-              poly_add(r+1, c, hintersect_lo);
-              poly_add(r, c, vintersect_lo);
-              poly_add(r, c, vintersect_hi);
-              poly_add(r, c, hintersect_hi);
-              poly_add(r, c, hintersect_lo);
-              poly_add(r, c+1, vintersect_lo);
-              poly_merge();
-            }
-          }
-          break;
+  return resultStruct{xs, ys, ids, len};
+}
 
-        // 8-sided saddle
-      case 60: // 2020
-        {
-          double vc = central_value(r, c);
-          if (vc < vlo) {
-            poly_start(r, c, vintersect_hi);
-            poly_add(r, c, hintersect_hi);
-            poly_add(r, c, hintersect_lo);
-            poly_add(r, c, vintersect_lo);
-            poly_merge();
-            poly_start(r, c+1, vintersect_hi);
-            poly_add(r+1, c, hintersect_hi);
-            poly_add(r+1, c, hintersect_lo);
-            poly_add(r, c+1, vintersect_lo);
-            poly_merge();
-          } else if (vc >= vhi) {
-            poly_start(r, c, vintersect_hi);
-            poly_add(r+1, c, hintersect_hi);
-            poly_add(r+1, c, hintersect_lo);
-            poly_add(r, c, vintersect_lo);
-            poly_merge();
-            poly_start(r, c+1, vintersect_hi);
-            poly_add(r, c, hintersect_hi);
-            poly_add(r, c, hintersect_lo);
-            poly_add(r, c+1, vintersect_lo);
-            poly_merge();
-          } else {
-            poly_start(r, c, vintersect_hi);
-            poly_add(r, c, hintersect_hi);
-            poly_add(r, c, hintersect_lo);
-            poly_add(r, c+1, vintersect_lo);
-            poly_add(r, c+1, vintersect_hi);
-            poly_add(r+1, c, hintersect_hi);
-            poly_add(r+1, c, hintersect_lo);
-            poly_add(r, c, vintersect_lo);
-            poly_merge();
-          }
-        }
-        break;
-        case 20: // 0202
-          {
-            double vc = central_value(r, c);
-            if (vc < vlo) {
-              poly_start(r, c, vintersect_lo);
-              poly_add(r+1, c, hintersect_lo);
-              poly_add(r+1, c, hintersect_hi);
-              poly_add(r, c, vintersect_hi);
-              poly_merge();
-              poly_start(r, c+1, vintersect_lo);
-              poly_add(r, c, hintersect_lo);
-              poly_add(r, c, hintersect_hi);
-              poly_add(r, c+1, vintersect_hi);
-              poly_merge();
-            } else if (vc >= vhi) {
-              poly_start(r, c, vintersect_lo);
-              poly_add(r, c, hintersect_lo);
-              poly_add(r, c, hintersect_hi);
-              poly_add(r, c, vintersect_hi);
-              poly_merge();
-              poly_start(r, c+1, vintersect_lo);
-              poly_add(r+1, c, hintersect_lo);
-              poly_add(r+1, c, hintersect_hi);
-              poly_add(r, c+1, vintersect_hi);
-              poly_merge();
-            } else {
-              poly_start(r, c, vintersect_lo);
-              poly_add(r, c, hintersect_lo);
-              poly_add(r, c, hintersect_hi);
-              poly_add(r, c+1, vintersect_hi);
-              poly_add(r, c+1, vintersect_lo);
-              poly_add(r+1, c, hintersect_lo);
-              poly_add(r+1, c, hintersect_hi);
-              poly_add(r, c, vintersect_hi);
-              poly_merge();
-            }
-          }
-          break;
-        }
-      }
+// the edges of a ring bucketed by y: the ring's y range is cut into equal buckets and each
+// edge, named by the point it leads into, is listed in every bucket its y range overlaps,
+// so a point-in-ring test only needs the edges of the bucket the point falls into
+struct ring_edge_index {
+  double y0, height;
+  vector<int> start, edges; // bucket k holds edges[start[k]] up to edges[start[k + 1] - 1]
+
+  ring_edge_index(const double *y, int n, double ymin, double ymax) : y0(ymin) {
+    int n_buckets = max(1, n / 4);
+    height = (ymax - ymin) / n_buckets;
+    if (!(height > 0)) height = 1; // flat ring, a single bucket
+
+    start.assign(n_buckets + 1, 0);
+    for (int i = 0, j = n - 1; i < n; j = i++) {
+      int k0 = bucket(min(y[i], y[j])), k1 = bucket(max(y[i], y[j]));
+      for (int k = k0; k <= k1; k++) start[k + 1]++;
+    }
+    for (int k = 0; k < n_buckets; k++) start[k + 1] += start[k];
+    edges.resize(start[n_buckets]);
+    vector<int> next(start.begin(), start.end() - 1);
+    for (int i = 0, j = n - 1; i < n; j = i++) {
+      int k0 = bucket(min(y[i], y[j])), k1 = bucket(max(y[i], y[j]));
+      for (int k = k0; k <= k1; k++) edges[next[k]++] = i;
     }
   }
 
-  virtual resultStruct collect() {
+  // bucket of the y value v; monotone in v, so an edge whose y range contains v is listed
+  // in v's bucket
+  int bucket(double v) const {
+    int k = (int) ((v - y0) / height);
+    return min(max(k, 0), (int) start.size() - 2);
+  }
+
+  in_polygon_type locate(const point &p, const double *x, const double *y, int n) const {
+    int k = bucket(p.y);
+    return point_in_ring(p, x, y, n, edges.data() + start[k], start[k + 1] - start[k]);
+  }
+};
+
+// whether ring a lies inside ring b, for rings delimited by offsets that don't cross each
+// other but may touch; decided by the first point of a not on the boundary of b, located
+// with b's edge index if it has one
+bool ring_inside(const vector<double> &x, const vector<double> &y, const vector<int> &offsets, int a, int b, const ring_edge_index *index_b) {
+  int nb = offsets[b + 1] - offsets[b];
+  for (int i = offsets[a]; i < offsets[a + 1]; i++) {
+    point p(x[i], y[i]);
+    in_polygon_type t = index_b ? index_b->locate(p, &x[offsets[b]], &y[offsets[b]], nb) :
+      point_in_ring(p, &x[offsets[b]], &y[offsets[b]], nb);
+    if (t != undetermined) return t == inside;
+  }
+  return false;
+}
+
+// for the rings of a band delimited by offsets, the outer ring of the polygon each ring
+// belongs to: rings inside an even number of other rings are outer rings and belong to
+// themselves, all others are holes of the innermost ring containing them
+vector<int> outer_rings(const vector<double> &x, const vector<double> &y, const vector<int> &offsets) {
+  int n = offsets.size() - 1;
+
+  // bounding boxes and areas, to rule out most pairs of rings without a containment test
+  vector<double> xmin(n), xmax(n), ymin(n), ymax(n), area(n);
+  for (int k = 0; k < n; k++) {
+    int i0 = offsets[k], i1 = offsets[k + 1];
+    xmin[k] = xmax[k] = x[i0];
+    ymin[k] = ymax[k] = y[i0];
+    double a = 0;
+    for (int i = i0, j = i1 - 1; i < i1; j = i++) {
+      xmin[k] = min(xmin[k], x[i]); xmax[k] = max(xmax[k], x[i]);
+      ymin[k] = min(ymin[k], y[i]); ymax[k] = max(ymax[k], y[i]);
+      a += (x[j] - x[i]) * (y[j] + y[i]);
+    }
+    area[k] = fabs(a);
+  }
+
+  // sweep the rings in order of xmin, keeping the rings whose x range covers the current
+  // xmin active: only those can contain the ring at hand, so each ring is tested against
+  // the rings crossing a vertical line instead of against all of them
+  vector<int> by_xmin(n);
+  for (int k = 0; k < n; k++) by_xmin[k] = k;
+  sort(by_xmin.begin(), by_xmin.end(), [&](int a, int b) { return xmin[a] < xmin[b]; });
+
+  // rings with more points get an edge index the first time they are a candidate; building
+  // it costs about as much as one containment test without it
+  const int min_indexed_points = 32;
+  vector<unique_ptr<ring_edge_index>> index(n);
+
+  vector<int> parent(n, -1), active, candidates;
+  int next = 0;
+  for (int s = 0; s < n; s++) {
+    int a = by_xmin[s];
+    while (next < n && xmin[by_xmin[next]] <= xmin[a]) {
+      active.push_back(by_xmin[next++]);
+    }
+    candidates.clear();
+    size_t kept = 0;
+    for (size_t i = 0; i < active.size(); i++) {
+      int b = active[i];
+      if (xmax[b] < xmin[a]) continue; // left of this and all later rings, retire it
+      active[kept++] = b;
+      if (area[b] > area[a] && xmax[b] >= xmax[a] && ymin[b] <= ymin[a] && ymax[b] >= ymax[a]) {
+        candidates.push_back(b);
+      }
+    }
+    active.resize(kept);
+
+    // the rings containing a are nested in one another, so the smallest one is its parent
+    sort(candidates.begin(), candidates.end(), [&](int b1, int b2) { return area[b1] < area[b2]; });
+    for (int b : candidates) {
+      int nb = offsets[b + 1] - offsets[b];
+      if (nb > min_indexed_points && !index[b]) {
+        index[b].reset(new ring_edge_index(&y[offsets[b]], nb, ymin[b], ymax[b]));
+      }
+      if (ring_inside(x, y, offsets, a, b, index[b].get())) {
+        parent[a] = b;
+        break;
+      }
+    }
+  }
+
+  // a parent is larger than its children, so by decreasing area its depth is known first
+  vector<int> by_area(n), depth(n, 0);
+  for (int k = 0; k < n; k++) by_area[k] = k;
+  sort(by_area.begin(), by_area.end(), [&](int a, int b) { return area[a] > area[b]; });
+  for (int a : by_area) {
+    if (parent[a] >= 0) depth[a] = depth[parent[a]] + 1;
+  }
+
+  vector<int> outer(n);
+  for (int k = 0; k < n; k++) {
+    outer[k] = (depth[k] % 2 == 0) ? k : parent[k];
+  }
+  return outer;
+}
+
+// copies collected output vectors into a newly allocated ringResultStruct; the rings are
+// delimited by offsets instead of per-point ids, and if polygons is true they are grouped
+// into polygons by outer_rings()
+ringResultStruct make_ring_result(const vector<double> &x_out, const vector<double> &y_out, const vector<int> &id, bool polygons) {
+  int len = x_out.size();
+
+  // the rings are contiguous runs of points with the same id
+  vector<int> offsets;
+  for (int i = 0; i < len; i++) {
+    if (i == 0 || id[i] != id[i - 1]) offsets.push_back(i);
+  }
+  offsets.push_back(len);
+  int n_rings = offsets.size() - 1;
+
+  double* xs = new double[len];
+  double* ys = new double[len];
+  int* ring_offsets = new int[n_rings + 1];
+
+  if (!polygons) {
+    copy(x_out.begin(), x_out.end(), xs);
+    copy(y_out.begin(), y_out.end(), ys);
+    copy(offsets.begin(), offsets.end(), ring_offsets);
+    return ringResultStruct{xs, ys, len, ring_offsets, n_rings, 0, 0};
+  }
+
+  vector<int> outer = outer_rings(x_out, y_out, offsets);
+
+  // number the polygons in the order of their outer rings and count their rings
+  vector<int> polygon(n_rings);
+  int n_polygons = 0;
+  for (int k = 0; k < n_rings; k++) {
+    if (outer[k] == k) polygon[k] = n_polygons++;
+  }
+  int* polygon_offsets = new int[n_polygons + 1];
+  fill(polygon_offsets, polygon_offsets + n_polygons + 1, 0);
+  for (int k = 0; k < n_rings; k++) {
+    polygon_offsets[polygon[outer[k]] + 1]++;
+  }
+  for (int j = 0; j < n_polygons; j++) {
+    polygon_offsets[j + 1] += polygon_offsets[j];
+  }
+
+  // slot of every ring: the outer ring first in its polygon, then the holes
+  vector<int> next(polygon_offsets, polygon_offsets + n_polygons), order(n_rings);
+  for (int k = 0; k < n_rings; k++) {
+    if (outer[k] == k) order[next[polygon[k]]++] = k;
+  }
+  for (int k = 0; k < n_rings; k++) {
+    if (outer[k] != k) order[next[polygon[outer[k]]]++] = k;
+  }
+
+  int pos = 0;
+  for (int s = 0; s < n_rings; s++) {
+    int k = order[s];
+    ring_offsets[s] = pos;
+    copy(x_out.begin() + offsets[k], x_out.begin() + offsets[k + 1], xs + pos);
+    copy(y_out.begin() + offsets[k], y_out.begin() + offsets[k + 1], ys + pos);
+    pos += offsets[k + 1] - offsets[k];
+  }
+  ring_offsets[n_rings] = len;
+
+  return ringResultStruct{xs, ys, len, ring_offsets, n_rings, polygon_offsets, n_polygons};
+}
+
+// min/max pyramid over the grid values, used to skip blocks of cells that a contour
+// doesn't cross
+//
+// The finest level holds the range of the grid values of every block of block_size x
+// block_size cells (including the grid points on the block boundary), and each coarser
+// level combines fanout x fanout blocks of the level below. Blocks that contain NA or
+// infinite values get the range (-inf, inf), so they are never skipped; for those, the
+// pyramid also keeps a bitmask of the cells that have four finite corners, so that
+// contouring never needs to check grid values for NA.
+class minmax_pyramid {
+public:
+  static const int block_size = 16;
+  static const int fanout = 4;
+
+  // block of cells r0 <= r < r1, c0 <= c < c1; its grid points are r0..r1, c0..c1
+  struct block {
+    int r0, r1, c0, c1;
+    // for blocks with NA or infinite values: bit r - r0 of the packed column c - c0 is set if
+    // cell r, c has four finite corners, with (r1 - r0 + 63)/64 words per column; null for
+    // blocks without such values
+    const uint64_t *valid;
+  };
+
+protected:
+  struct level {
+    int nbr, nbc; // numbers of block rows and block columns
+    int size;     // cells per block side
+    vector<double> lo, hi;
+  };
+
+  int nrow, ncol;
+  vector<level> levels; // finest level first; only the first n_levels are in use
+  int n_levels;
+  vector<long long> valid_offset; // per finest block: offset into valid_bits, or -1
+  vector<uint64_t> valid_bits;
+
+  // the next coarser level, reusing the memory of an earlier build if there is one; this
+  // invalidates references to other levels
+  level& next_level() {
+    if (n_levels == static_cast<int>(levels.size())) levels.push_back(level());
+    return levels[n_levels++];
+  }
+
+  void visit(int l, int bi, int bj, double vlo, double vhi, vector<block> &mixed, vector<block> &interior) const {
+    const level &lv = levels[l];
+    double lo = lv.lo[bi + bj * lv.nbr], hi = lv.hi[bi + bj * lv.nbr];
+
+    // all grid points below vlo or all at or above vhi: no contour in this block
+    if ((hi < vlo && hi < vhi) || lo >= vhi) return;
+
+    block b = {bi * lv.size, min((bi + 1) * lv.size, nrow - 1), bj * lv.size, min((bj + 1) * lv.size, ncol - 1), 0};
+    if (lo >= vlo && hi < vhi) {
+      interior.push_back(b);
+    } else if (l == 0) {
+      long long offset = valid_offset[bi + bj * lv.nbr];
+      if (offset >= 0) b.valid = &valid_bits[offset];
+      mixed.push_back(b);
+    } else {
+      const level &sub = levels[l - 1];
+      for (int cj = bj * fanout; cj < min((bj + 1) * fanout, sub.nbc); cj++) {
+        for (int ci = bi * fanout; ci < min((bi + 1) * fanout, sub.nbr); ci++) {
+          visit(l - 1, ci, cj, vlo, vhi, mixed, interior);
+        }
+      }
+    }
+  }
+
+public:
+  minmax_pyramid(const grid_values &z, int nrow, int ncol) : nrow(0), ncol(0), n_levels(0) {
+    build(z, nrow, ncol);
+  }
+
+  int rows() const {return nrow;}
+  int columns() const {return ncol;}
+
+  // (re)builds the pyramid for the grid z; the memory of a previous pyramid is reused, so
+  // rebuilding for a grid of the same size doesn't allocate
+  void build(const grid_values &z, int nrow_in, int ncol_in) {
+    const grid_values g = z.layout(nrow_in);
+    switch(g.type) {
+    case value_float:
+      build_values(static_cast<const float*>(g.data), g, nrow_in, ncol_in);
+      break;
+    case value_int16:
+      build_values(static_cast<const int16_t*>(g.data), g, nrow_in, ncol_in);
+      break;
+    case value_int32:
+      build_values(static_cast<const int32_t*>(g.data), g, nrow_in, ncol_in);
+      break;
+    default:
+      build_values(static_cast<const double*>(g.data), g, nrow_in, ncol_in);
+    }
+  }
+
+protected:
+  // range of the n raw values z[0], z[stride], ..., converted by gv.value(); (-inf, inf) if
+  // any of them is NA or infinite
+  template <class T>
+  static void raw_range(const T *z, ptrdiff_t stride, int n, const grid_values &gv, double &lo, double &hi) {
+    const double inf = numeric_limits<double>::infinity();
+    lo = inf;
+    hi = -inf;
+    for (int i = 0; i < n; i++) {
+      double v = z[i * stride];
+      if (!isfinite(v)) {
+        lo = -inf;
+        hi = inf;
+        return;
+      }
+      lo = min(lo, v);
+      hi = max(hi, v);
+    }
+    lo = gv.value(lo);
+    hi = gv.value(hi);
+  }
+
+  // the ranges are taken over the raw values of type T, running along the grid columns or
+  // rows, whichever are contiguous in memory
+  template <class T>
+  void build_values(const T *z, const grid_values &gv, int nrow_in, int ncol_in) {
+    nrow = nrow_in;
+    ncol = ncol_in;
+    n_levels = 0;
+    valid_bits.clear();
+    if (nrow < 2 || ncol < 2) return;
+
+    const double inf = numeric_limits<double>::infinity();
+    level &lv = next_level();
+    lv.nbr = (nrow - 2) / block_size + 1;
+    lv.nbc = (ncol - 2) / block_size + 1;
+    lv.size = block_size;
+    lv.lo.assign(lv.nbr * lv.nbc, inf);
+    lv.hi.assign(lv.nbr * lv.nbc, -inf);
+
+    if (!gv.row_order()) {
+      for (int c = 0; c < ncol; c++) {
+        // grid column c is part of up to two block columns
+        int bj0 = (c > 0) ? (c - 1) / block_size : 0;
+        int bj1 = min(c / block_size, lv.nbc - 1);
+        for (int bi = 0; bi < lv.nbr; bi++) {
+          int r0 = bi * block_size, r1 = min((bi + 1) * block_size, nrow - 1);
+          double lo, hi;
+          raw_range(z + gv.index(r0, c), gv.row_stride, r1 - r0 + 1, gv, lo, hi);
+          for (int bj = bj0; bj <= bj1; bj++) {
+            lv.lo[bi + bj * lv.nbr] = min(lv.lo[bi + bj * lv.nbr], lo);
+            lv.hi[bi + bj * lv.nbr] = max(lv.hi[bi + bj * lv.nbr], hi);
+          }
+        }
+      }
+    } else {
+      for (int r = 0; r < nrow; r++) {
+        // grid row r is part of up to two block rows
+        int bi0 = (r > 0) ? (r - 1) / block_size : 0;
+        int bi1 = min(r / block_size, lv.nbr - 1);
+        for (int bj = 0; bj < lv.nbc; bj++) {
+          int c0 = bj * block_size, c1 = min((bj + 1) * block_size, ncol - 1);
+          double lo, hi;
+          raw_range(z + gv.index(r, c0), gv.col_stride, c1 - c0 + 1, gv, lo, hi);
+          for (int bi = bi0; bi <= bi1; bi++) {
+            lv.lo[bi + bj * lv.nbr] = min(lv.lo[bi + bj * lv.nbr], lo);
+            lv.hi[bi + bj * lv.nbr] = max(lv.hi[bi + bj * lv.nbr], hi);
+          }
+        }
+      }
+    }
+
+    // validity of the cells of blocks with non-finite values; only those have lo = -inf
+    valid_offset.assign(lv.nbr * lv.nbc, -1);
+    for (int bj = 0; bj < lv.nbc; bj++) {
+      for (int bi = 0; bi < lv.nbr; bi++) {
+        if (lv.lo[bi + bj * lv.nbr] != -inf) continue;
+
+        int r0 = bi * block_size, r1 = min(r0 + block_size, nrow - 1);
+        int c0 = bj * block_size, c1 = min(c0 + block_size, ncol - 1);
+        size_t cw = (r1 - r0 + 63) / 64, offset = valid_bits.size();
+        valid_offset[bi + bj * lv.nbr] = offset;
+        valid_bits.resize(offset + cw * (c1 - c0), 0);
+        for (int c = c0; c < c1; c++) {
+          for (int r = r0; r < r1; r++) {
+            const T *p = z + gv.index(r, c);
+            ptrdiff_t rs = gv.row_stride, cs = gv.col_stride;
+            if (finite_value(p[0]) && finite_value(p[rs]) && finite_value(p[cs]) && finite_value(p[rs + cs])) {
+              valid_bits[offset + (c - c0) * cw + (r - r0) / 64] |= uint64_t(1) << ((r - r0) % 64);
+            }
+          }
+        }
+      }
+    }
+
+    while (levels[n_levels - 1].nbr > 1 || levels[n_levels - 1].nbc > 1) {
+      level &up = next_level();
+      const level &sub = levels[n_levels - 2];
+      up.nbr = (sub.nbr - 1) / fanout + 1;
+      up.nbc = (sub.nbc - 1) / fanout + 1;
+      up.size = sub.size * fanout;
+      up.lo.assign(up.nbr * up.nbc, inf);
+      up.hi.assign(up.nbr * up.nbc, -inf);
+      for (int bj = 0; bj < sub.nbc; bj++) {
+        for (int bi = 0; bi < sub.nbr; bi++) {
+          int i = bi / fanout + (bj / fanout) * up.nbr;
+          up.lo[i] = min(up.lo[i], sub.lo[bi + bj * sub.nbr]);
+          up.hi[i] = max(up.hi[i], sub.hi[bi + bj * sub.nbr]);
+        }
+      }
+    }
+  }
+
+public:
+  // sorts the blocks a contour with cutoffs vlo, vhi may cross into those whose grid values
+  // all lie within [vlo, vhi) (interior) and those that need to be classified cell by cell
+  // (mixed); blocks are as coarse as possible. For isolines, use vlo = vhi = value.
+  void find_blocks(double vlo, double vhi, vector<block> &mixed, vector<block> &interior) const {
+    mixed.clear();
+    interior.clear();
+    if (n_levels == 0) return;
+
+    int top = n_levels - 1;
+    for (int bj = 0; bj < levels[top].nbc; bj++) {
+      for (int bi = 0; bi < levels[top].nbr; bi++) {
+        visit(top, bi, bj, vlo, vhi, mixed, interior);
+      }
+    }
+  }
+};
+
+// ranks of the grid values among the cutoffs of all levels of a contouring call, computed
+// in a single binary-search pass over the grid; every level is then classified by
+// comparing 16-bit ranks instead of the values themselves. The rank of a value is the
+// number of cutoffs at or below it, so z >= cutoff exactly if the rank of z is at least
+// the rank of the cutoff; NA and infinite values get rank -1.
+class level_ranks {
+public:
+  static const int max_cutoffs = 32766;
+
+protected:
+  vector<double> cutoffs;    // sorted, without duplicates and NaN
+  vector<double> thresholds; // the cutoffs in the type of the grid values
+  vector<int16_t> ranks;     // one per grid value, column-major like z
+
+  // neighboring values mostly share their rank, so the interval of the previous value is
+  // tried first, and only otherwise the thresholds are searched; the grid is read in memory
+  // order, along the rows if they are contiguous, and the ranks are always column-major
+  template <class T>
+  void rank_values(const T *z, const grid_values &gv, int nrow, int ncol) {
+    bool by_rows = gv.row_order();
+    int n_outer = by_rows ? nrow : ncol, n_inner = by_rows ? ncol : nrow;
+    ptrdiff_t outer_stride = by_rows ? gv.row_stride : gv.col_stride, inner_stride = by_rows ? gv.col_stride : gv.row_stride;
+    size_t rank_outer = by_rows ? 1 : nrow, rank_inner = by_rows ? nrow : 1;
+
+    int k = 0;
+    for (int a = 0; a < n_outer; a++) {
+      const T *line = z + a * outer_stride;
+      int16_t *out = ranks.data() + a * rank_outer;
+      for (int b = 0; b < n_inner; b++) {
+        double v = line[b * inner_stride];
+        if (!isfinite(v)) {
+          out[b * rank_inner] = -1;
+          continue;
+        }
+        if (!((k == 0 || thresholds[k - 1] <= v) && (k == static_cast<int>(thresholds.size()) || v < thresholds[k]))) {
+          k = rank(v);
+        }
+        out[b * rank_inner] = static_cast<int16_t>(k);
+      }
+    }
+  }
+
+public:
+  level_ranks(const grid_values &z, int nrow, int ncol, const vector<double> &values) {
+    build(z, nrow, ncol, values);
+  }
+
+  // (re)computes the ranks for grid z and the given cutoffs, reusing the memory of
+  // earlier ranks
+  void build(const grid_values &z, int nrow, int ncol, const vector<double> &values) {
+    cutoffs.clear();
+    for (size_t i = 0; i < values.size(); i++) {
+      if (!isnan(values[i])) cutoffs.push_back(values[i]);
+    }
+    sort(cutoffs.begin(), cutoffs.end());
+    cutoffs.erase(unique(cutoffs.begin(), cutoffs.end()), cutoffs.end());
+    if (cutoffs.size() > static_cast<size_t>(max_cutoffs)) {
+      throw std::invalid_argument("Too many distinct cutoffs for level ranks.");
+    }
+
+    // distinct cutoffs may share a threshold, but the thresholds are still sorted, and the
+    // number of them at or below a raw value is its rank
+    thresholds.resize(cutoffs.size());
+    for (size_t i = 0; i < cutoffs.size(); i++) {
+      thresholds[i] = z.threshold(cutoffs[i]);
+    }
+
+    ranks.resize(static_cast<size_t>(nrow) * ncol);
+    const grid_values g = z.layout(nrow);
+    switch(g.type) {
+    case value_float:
+      rank_values(static_cast<const float*>(g.data), g, nrow, ncol);
+      break;
+    case value_int16:
+      rank_values(static_cast<const int16_t*>(g.data), g, nrow, ncol);
+      break;
+    case value_int32:
+      rank_values(static_cast<const int32_t*>(g.data), g, nrow, ncol);
+      break;
+    default:
+      rank_values(static_cast<const double*>(g.data), g, nrow, ncol);
+    }
+  }
+
+  // number of thresholds at or below the raw value v, by a branchless binary search
+  int rank(double v) const {
+    if (thresholds.empty()) return 0;
+    const double *p = thresholds.data();
+    size_t len = thresholds.size();
+    while (len > 1) {
+      size_t half = len / 2;
+      p = (p[half] <= v) ? p + half : p;
+      len -= half;
+    }
+    return static_cast<int>(p - thresholds.data()) + (*p <= v);
+  }
+
+  // the rank k of a cutoff, such that z >= value exactly if rank(z) >= k; -1 if the value
+  // isn't one of the cutoffs
+  int cutoff_rank(double value) const {
+    vector<double>::const_iterator it = lower_bound(cutoffs.begin(), cutoffs.end(), value);
+    if (it == cutoffs.end() || *it != value) return -1;
+    return static_cast<int>(it - cutoffs.begin()) + 1;
+  }
+
+  const int16_t* data() const {
+    return ranks.data();
+  }
+};
+
+class isobander {
+protected:
+  int nrow, ncol; // numbers of rows and columns
+  // SEXP grid_x, grid_y, grid_z;
+  double *grid_x_p, *grid_y_p;
+  grid_values grid_z;
+  double vlo, vhi; // low and high cutoff values
+  double z_lo, z_hi; // the cutoffs in the type of the grid values
+  grid_point tmp_poly[8]; // temp storage for elementary polygons; none has more than 8 vertices
+  point_connect tmp_point_connect[8];
+  int tmp_poly_size; // current number of elements in tmp_poly
+
+  vertex_store polygon_grid;
+
+  bool interrupted;
+
+  bool block_pruning; // skip blocks of cells that the contour doesn't cross
+  shared_ptr<const minmax_pyramid> pyramid; // built on first use
+  vector<minmax_pyramid::block> mixed_blocks, interior_blocks; // blocks for the current cutoffs
+  // classification of the current block: packed states of its grid columns, block_pw words
+  // per column, and the cells that contribute to the contour, block_cw words per column
+  vector<uint64_t> block_lo, block_hi, block_nonfinite, block_active;
+  size_t block_pw, block_cw;
+  // grid columns with strided values, copied into contiguous runs of n values for the
+  // kernels, up to gather_columns columns at a time
+  static const size_t gather_columns = 64;
+  vector<double> gather_buf;
+  shared_ptr<const level_ranks> ranks; // level ranks of the grid, if any
+  int rank_lo, rank_hi; // ranks of the current cutoffs, or -1 to classify the values
+
+  vector<double> x_out, y_out; vector<int> id;  // vectors holding resulting polygon paths
+  // per collected path, its first vertex in raster order and the index of its first point
+  // in x_out and y_out
+  vector<grid_point> path_key;
+  vector<size_t> path_begin;
+  vector<int> raster_entries, raster_by_col, raster_count; // scratch for collect_paths()
+  vector<int> merge_entries, merge_list; // scratch for merging the grids of tiles
+  vector<double> merge_x, merge_y; // scratch for interleaving the paths of tiles
+  vector<grid_point> merge_key;
+  vector<size_t> merge_begin;
+
+  // finds the blocks of cells that need to be classified for cutoffs lo, hi; without
+  // block pruning, that's a single block covering the whole grid
+  void find_blocks(double lo, double hi) {
+    rank_lo = ranks ? ranks->cutoff_rank(lo) : -1;
+    rank_hi = ranks ? ranks->cutoff_rank(hi) : -1;
+    z_lo = grid_z.threshold(lo);
+    z_hi = grid_z.threshold(hi);
+
+    if (block_pruning) {
+      if (!pyramid) {
+        pyramid = make_shared<minmax_pyramid>(grid_z, nrow, ncol);
+      }
+      pyramid->find_blocks(lo, hi, mixed_blocks, interior_blocks);
+    } else {
+      mixed_blocks.clear();
+      interior_blocks.clear();
+      if (nrow > 1 && ncol > 1) {
+        minmax_pyramid::block b = {0, nrow - 1, 0, ncol - 1, 0};
+        mixed_blocks.push_back(b);
+      }
+    }
+  }
+
+  // classifies the grid values of block b into packed states and marks the cells that
+  // contribute to the contour in block_active; isolines use binary states of vlo,
+  // isobands ternary states of vlo, vhi
+  //
+  // Blocks found through the pyramid are classified without any NA checks, since the
+  // pyramid already knows which of their cells are valid. Only the whole-grid block used
+  // without block pruning needs the nonfinite bit plane, and only for floating point values.
+  void classify_block(const minmax_pyramid::block &b, bool binary) {
+    const classify_kernels &k = kernels();
+    bool checked = !block_pruning && grid_z.floating();
+    size_t h = b.r1 - b.r0, w = b.c1 - b.c0;
+    block_pw = (h + 64) / 64;
+    block_cw = (h + 63) / 64;
+    block_lo.resize(block_pw * (w + 1));
+    if (!binary) block_hi.resize(block_pw * (w + 1));
+    if (checked) block_nonfinite.resize(block_pw * (w + 1));
+    block_active.resize(block_cw * w);
+
+    bool use_ranks = rank_lo >= 0 && rank_hi >= 0;
+    for (size_t j = 0; j <= w; j++) {
+      uint64_t *lo = &block_lo[j * block_pw], *hi = binary ? 0 : &block_hi[j * block_pw];
+      uint64_t *nonfinite = checked ? &block_nonfinite[j * block_pw] : 0;
+      if (use_ranks) {
+        const int16_t *t = ranks->data() + b.r0 + (b.c0 + j) * static_cast<size_t>(nrow);
+        if (binary) {
+          k.binarize_i16(t, h + 1, rank_lo, lo, nonfinite);
+        } else {
+          k.ternarize_i16(t, h + 1, rank_lo, rank_hi, lo, hi, nonfinite);
+        }
+      } else if (grid_z.contiguous_columns()) {
+        classify_values(k, grid_z.window(b.r0, b.c0 + j).data, h + 1, binary, lo, hi, nonfinite);
+      } else {
+        size_t g = j % gather_columns;
+        if (g == 0) gather(b.r0, b.c0 + j, h + 1, min(size_t(gather_columns), w + 1 - j));
+        const char *column = reinterpret_cast<const char*>(gather_buf.data()) + g * (h + 1) * grid_z.value_size();
+        classify_values(k, column, h + 1, binary, lo, hi, nonfinite);
+      }
+    }
+
+    // a cell contributes if all its corners are finite and, for isolines, they aren't all on
+    // the same side of the value; for isobands, if they aren't all below or all above the
+    // band, i.e. some corner is within it or the corners differ in the hi bit
+    for (size_t j = 0; j < w; j++) {
+      const size_t p0 = j * block_pw, p1 = p0 + block_pw;
+      for (size_t i = 0; i < block_cw; i++) {
+        uint64_t active;
+        if (binary) {
+          active = corners_differ(&block_lo[p0], &block_lo[p1], i, block_pw);
+        } else {
+          active = corners_any(&block_lo[p0], &block_lo[p1], i, block_pw) |
+            corners_differ(&block_hi[p0], &block_hi[p1], i, block_pw);
+        }
+        if (checked) active &= ~corners_any(&block_nonfinite[p0], &block_nonfinite[p1], i, block_pw);
+        if (b.valid) active &= b.valid[j * block_cw + i];
+        if (64 * (i + 1) > h) active &= (uint64_t(1) << (h % 64)) - 1; // no cells beyond row h
+        block_active[j * block_cw + i] = active;
+      }
+    }
+  }
+
+  // copies the n values of the nj grid columns starting at grid point r0, c0 into
+  // gather_buf, column after column, reading the grid in memory order
+  void gather(int r0, int c0, size_t n, size_t nj) {
+    const void *z = grid_z.window(r0, c0).data;
+    switch(grid_z.type) {
+    case value_float:
+      gather_values(static_cast<const float*>(z), n, nj);
+      break;
+    case value_int16:
+      gather_values(static_cast<const int16_t*>(z), n, nj);
+      break;
+    case value_int32:
+      gather_values(static_cast<const int32_t*>(z), n, nj);
+      break;
+    default:
+      gather_values(static_cast<const double*>(z), n, nj);
+    }
+  }
+
+  template <class T>
+  void gather_values(const T *z, size_t n, size_t nj) {
+    gather_buf.resize((n * nj * sizeof(T) + sizeof(double) - 1) / sizeof(double));
+    T *out = reinterpret_cast<T*>(gather_buf.data());
+    ptrdiff_t rs = grid_z.row_stride, cs = grid_z.col_stride;
+    if (grid_z.row_order()) {
+      for (ptrdiff_t r = 0; r < static_cast<ptrdiff_t>(n); r++) {
+        for (ptrdiff_t j = 0; j < static_cast<ptrdiff_t>(nj); j++) {
+          out[j * n + r] = z[r * rs + j * cs];
+        }
+      }
+    } else {
+      for (ptrdiff_t j = 0; j < static_cast<ptrdiff_t>(nj); j++) {
+        for (ptrdiff_t r = 0; r < static_cast<ptrdiff_t>(n); r++) {
+          out[j * n + r] = z[r * rs + j * cs];
+        }
+      }
+    }
+  }
+
+  // classifies n contiguous raw values of the type of the grid values in their own type,
+  // against z_lo for binary states and z_lo, z_hi for ternary ones
+  void classify_values(const classify_kernels &k, const void *values, size_t n, bool binary, uint64_t *lo, uint64_t *hi, uint64_t *nonfinite) {
+    switch(grid_z.type) {
+    case value_float: {
+      const float *z = static_cast<const float*>(values);
+      float flo = static_cast<float>(z_lo), fhi = static_cast<float>(z_hi);
+      if (binary) k.binarize_f32(z, n, flo, lo, nonfinite);
+      else k.ternarize_f32(z, n, flo, fhi, lo, hi, nonfinite);
+      break;
+    }
+    case value_int16: {
+      const int16_t *z = static_cast<const int16_t*>(values);
+      int klo = static_cast<int>(z_lo), khi = static_cast<int>(z_hi);
+      if (binary) k.binarize_i16(z, n, klo, lo, 0);
+      else k.ternarize_i16(z, n, klo, khi, lo, hi, 0);
+      break;
+    }
+    case value_int32: {
+      const int32_t *z = static_cast<const int32_t*>(values);
+      int64_t klo = static_cast<int64_t>(z_lo), khi = static_cast<int64_t>(z_hi);
+      if (binary) k.binarize_i32(z, n, klo, lo);
+      else k.ternarize_i32(z, n, klo, khi, lo, hi);
+      break;
+    }
+    default: {
+      const double *z = static_cast<const double*>(values);
+      if (binary) k.binarize(z, n, vlo, lo, nonfinite);
+      else k.ternarize(z, n, vlo, vhi, lo, hi, nonfinite);
+    }
+    }
+  }
+
+  // state of grid value r of packed column j of the current block
+  int block_state(size_t j, size_t r, bool binary) {
+    int state = packed_bit(&block_lo[j * block_pw], r);
+    if (!binary) state += 2 * packed_bit(&block_hi[j * block_pw], r);
+    return state;
+  }
+
+  // index of cell r in column j of the current block: 27a + 9b + 3c + d for ternary
+  // states, 8a + 4b + 2c + d for binary ones
+  int block_cell_index(size_t j, size_t r, bool binary) {
+    int base = binary ? 2 : 3;
+    return ((block_state(j, r, binary) * base + block_state(j + 1, r, binary)) * base +
+      block_state(j + 1, r + 1, binary)) * base + block_state(j, r + 1, binary);
+  }
+
+  void reset_grid() {
+    polygon_grid.clear();
+
+    for (int i=0; i<8; i++) {
+      tmp_point_connect[i] = point_connect();
+    }
+  }
+
+  // internal member functions
+
+  double central_value(int r, int c) {// calculates the central value of a given cell
+    return (grid_z(r, c) + grid_z(r, c + 1) + grid_z(r + 1, c) + grid_z(r + 1, c + 1))/4;
+  }
+
+  void poly_add(int r, int c, point_type type) { // add point to elementary polygon
+    tmp_poly[tmp_poly_size].r = r;
+    tmp_poly[tmp_poly_size].c = c;
+    tmp_poly[tmp_poly_size].type = type;
+
+    tmp_poly_size++;
+  }
+
+  // merges the connection pc of a new polygon vertex with the existing connection at the
+  // same grid point; on return, pc holds the merged connection; returns true if the two
+  // connections cancel and the point can be deleted
+  bool merge_connect(point_connect &pc, const point_connect &existing) {
+    bool to_delete = false;
+    if (!existing.altpoint) {
+      // basic scenario, no alternative point at this location
+      int score = 2 * (pc.next == existing.prev) + (pc.prev == existing.next);
+      switch (score) {
+      case 3: // 11
+        // both prev and next cancel, point can be deleted
+        to_delete = true;
+        break;
+      case 2: // 10
+        // merge in "next" direction
+        pc.next = existing.next;
+        break;
+      case 1: // 01
+        // merge in "prev" direction
+        pc.prev = existing.prev;
+        break;
+      default: // 00
+        // if we get here, we have two polygon vertices sharing the same grid location
+        // in an unmergable configuration; need to store both
+        pc.prev2 = existing.prev;
+        pc.next2 = existing.next;
+        pc.altpoint = true;
+      }
+    } else {
+      // case with alternative point at this location
+      int score =
+        8 * (pc.next == existing.prev2) + 4 * (pc.prev == existing.next2) +
+        2 * (pc.next == existing.prev) + (pc.prev == existing.next);
+      switch (score) {
+      case 9: // 1001
+        // three-way merge
+        pc.next = existing.next2;
+        pc.prev = existing.prev;
+        break;
+      case 6: // 0110
+        // three-way merge
+        pc.next = existing.next;
+        pc.prev = existing.prev2;
+        break;
+      case 8: // 1000
+        // two-way merge with alt point only
+        // set up merged alt point
+        pc.next2 = existing.next2;
+        pc.prev2 = pc.prev;
+        // copy over existing point as is
+        pc.prev = existing.prev;
+        pc.next = existing.next;
+        pc.altpoint = true;
+        break;
+      case 4: // 0100
+        // two-way merge with alt point only
+        // set up merged alt point
+        pc.prev2 = existing.prev2;
+        pc.next2 = pc.next;
+        // copy over existing point as is
+        pc.prev = existing.prev;
+        pc.next = existing.next;
+        pc.altpoint = true;
+        break;
+      case 2: // 0010
+        // two-way merge with original point only
+        // merge point
+        pc.next = existing.next;
+        // copy over existing alt point as is
+        pc.prev2 = existing.prev2;
+        pc.next2 = existing.next2;
+        pc.altpoint = true;
+        break;
+      case 1: // 0100
+        // two-way merge with original point only
+        // merge point
+        pc.prev = existing.prev;
+        // copy over existing alt point as is
+        pc.prev2 = existing.prev2;
+        pc.next2 = existing.next2;
+        pc.altpoint = true;
+        break;
+      default:
+        throw std::runtime_error("undefined merging configuration");
+      }
+    }
+    return to_delete;
+  }
+
+  void poly_merge() { // merge current elementary polygon to prior polygons
+    //cout << "before merging:" << endl;
+
+    bool to_delete[] = {false, false, false, false, false, false, false, false};
+    int entry[8]; // entries of the points in the polygon grid
+
+    // all points get an entry first, so that the connections can refer to them; new
+    // points start out without a connection
+    for (int i = 0; i < tmp_poly_size; i++) {
+      entry[i] = find_or_add(tmp_poly[i]);
+    }
+
+    // first, we figure out the right connections for current polygon
+    for (int i = 0; i < tmp_poly_size; i++) {
+      // create defined state in tmp_point_connect[]
+      // for each point, find previous and next point in polygon
+      tmp_point_connect[i].altpoint = false;
+      tmp_point_connect[i].next = entry[(i+1<tmp_poly_size) ? i+1 : 0];
+      tmp_point_connect[i].prev = entry[(i-1>=0) ? i-1 : tmp_poly_size-1];
+
+      //cout << tmp_poly[i] << ": " << tmp_point_connect[i] << endl;
+
+      // now merge with existing polygons if needed
+      const point_connect &existing = polygon_grid.value(entry[i]);
+      if (existing.prev >= 0) { // point has been used before, need to merge polygons
+        to_delete[i] = merge_connect(tmp_point_connect[i], existing);
+      }
+    }
+
+    //cout << "after merging:" << endl;
+
+    // then we copy the connections into the polygon matrix
+    for (int i = 0; i < tmp_poly_size; i++) {
+      if (to_delete[i]) { // delete point if needed
+        polygon_grid.erase(tmp_poly[i]);
+      } else {            // otherwise, copy
+        polygon_grid.value(entry[i]) = tmp_point_connect[i];
+      }
+      //cout << tmp_poly[i] << ": " << tmp_point_connect[i] << endl;
+    }
+
+    //cout << "new grid:" << endl;
+    //print_polygons_state();
+  }
+
+  // merges the connection pc into entry i of the polygon grid. If the two connections
+  // cancel, the entry is left without connection, and the caller erases it once no other
+  // connection refers to it anymore; until then, another connection can still be merged in.
+  void merge_point(int i, point_connect pc) {
+    point_connect &existing = polygon_grid.value(i);
+    if (existing.prev >= 0 && merge_connect(pc, existing)) {
+      existing = point_connect();
+    } else {
+      existing = pc;
+    }
+  }
+
+  // erases entry i of the polygon grid if merge_point() has left it without connection
+  void erase_if_unconnected(int i) {
+    if (polygon_grid.value(i).prev < 0) polygon_grid.erase(polygon_grid.key(i));
+  }
+
+  // entry of grid point p in the polygon grid, added with its edge coordinate if needed
+  int find_or_add(const grid_point &p) {
+    int i = polygon_grid.lookup(p);
+    return (i >= 0) ? i : polygon_grid.insert(p, edge_coord(p));
+  }
+
+  // entry in this grid of entry k of a tile that has contoured the sub-grid starting at
+  // column c0, added if needed; the entries mapped so far are in merge_entries, and those
+  // added to it in merge_list
+  int merged_entry(const isobander &tile, int k, int c0) {
+    if (k < 0) return -1;
+    if (merge_entries[k] < 0) {
+      const grid_point &q = tile.polygon_grid.key(k);
+      merge_entries[k] = find_or_add(grid_point(q.r, q.c + c0, q.type));
+      merge_list.push_back(merge_entries[k]);
+    }
+    return merge_entries[k];
+  }
+
+  // moves the rings of an engine that has contoured the sub-grid starting at column c0 and
+  // that pass through any of its entries seam over into this grid, where rings that meet
+  // along a seam get merged just like elementary polygons are merged in poly_merge(). The
+  // tile marks the rings it hands over as collected, so that it collects only the rest,
+  // the rings that don't touch a seam, itself.
+  void merge_seam_rings(isobander &tile, int c0, const vector<int> &seam) {
+    merge_entries.assign(tile.polygon_grid.size(), -1);
+    merge_list.clear();
+
+    for (size_t j = 0; j < seam.size(); j++) {
+      // a point with an alternative is on two passes, maybe of different rings
+      for (int pass = 0; pass < 2; pass++) {
+        const point_connect &spc = tile.polygon_grid.value(seam[j]);
+        if (pass == 1 && !spc.altpoint) break;
+        if (pass == 0 ? spc.collected : spc.collected2) continue;
+
+        // walk the ring like collect_paths() does, moving each connection over
+        int start = seam[j];
+        int cur = start;
+        int prev = (pass == 0) ? spc.prev : spc.prev2;
+        do {
+          point_connect &cur_pc = tile.polygon_grid.value(cur);
+          int next;
+          if (cur_pc.altpoint && cur_pc.prev2 == prev) {
+            cur_pc.collected2 = true;
+            next = cur_pc.next2;
+          } else {
+            cur_pc.collected = true;
+            next = cur_pc.next;
+          }
+          point_connect pc;
+          pc.prev = merged_entry(tile, prev, c0);
+          pc.next = merged_entry(tile, next, c0);
+          merge_point(merged_entry(tile, cur, c0), pc);
+          prev = cur;
+          cur = next;
+        } while (!(cur == start && tile.pass_collected(cur, prev)));
+      }
+    }
+
+    for (size_t j = 0; j < merge_list.size(); j++) {
+      erase_if_unconnected(merge_list[j]);
+    }
+  }
+
+  // replaces the paths collected by this engine with those and the paths collected by
+  // the tile engines, whose sub-grids start at the columns tile_start, interleaved in
+  // raster order of their first vertices and numbered again; the result is the same as if
+  // this engine had contoured and collected the whole grid
+  template <class Engine>
+  void interleave_paths(const vector<unique_ptr<Engine> > &tiles, const vector<int> &tile_start) {
+    x_out.swap(merge_x);
+    y_out.swap(merge_y);
+    path_key.swap(merge_key);
+    path_begin.swap(merge_begin);
+    x_out.clear(); y_out.clear(); id.clear();
+    path_key.clear(); path_begin.clear();
+
+    // source 0 is this engine, source i + 1 tile i
+    int n_sources = tiles.size() + 1;
+    vector<size_t> next(n_sources, 0);
+    while (true) {
+      int best = -1;
+      grid_point best_key;
+      for (int i = 0; i < n_sources; i++) {
+        const vector<grid_point> &keys = (i == 0) ? merge_key : tiles[i - 1]->path_key;
+        if (next[i] == keys.size()) continue;
+        grid_point key = keys[next[i]];
+        if (i > 0) key.c += tile_start[i - 1];
+        if (best < 0 || raster_less(key, best_key)) {
+          best = i;
+          best_key = key;
+        }
+      }
+      if (best < 0) break;
+
+      const vector<double> &xs = (best == 0) ? merge_x : tiles[best - 1]->x_out;
+      const vector<double> &ys = (best == 0) ? merge_y : tiles[best - 1]->y_out;
+      const vector<size_t> &begins = (best == 0) ? merge_begin : tiles[best - 1]->path_begin;
+      size_t k = next[best]++;
+      size_t i0 = begins[k], i1 = (k + 1 < begins.size()) ? begins[k + 1] : xs.size();
+
+      path_key.push_back(best_key);
+      path_begin.push_back(x_out.size());
+      x_out.insert(x_out.end(), xs.begin() + i0, xs.begin() + i1);
+      y_out.insert(y_out.end(), ys.begin() + i0, ys.begin() + i1);
+      id.insert(id.end(), i1 - i0, static_cast<int>(path_key.size()));
+    }
+  }
+
+  // merges the outline of a block of cells that all lie within the band; same result as
+  // case 40 (1111) for every cell of the block, but only the boundary points are touched
+  void poly_block(const minmax_pyramid::block &b) {
+    vector<int> ring;
+    for (int c = b.c0; c < b.c1; c++) ring.push_back(find_or_add(grid_point(b.r0, c, grid)));
+    for (int r = b.r0; r < b.r1; r++) ring.push_back(find_or_add(grid_point(r, b.c1, grid)));
+    for (int c = b.c1; c > b.c0; c--) ring.push_back(find_or_add(grid_point(b.r1, c, grid)));
+    for (int r = b.r1; r > b.r0; r--) ring.push_back(find_or_add(grid_point(r, b.c0, grid)));
+
+    int n = ring.size();
+    for (int i = 0; i < n; i++) {
+      point_connect pc;
+      pc.prev = ring[(i + n - 1) % n];
+      pc.next = ring[(i + 1) % n];
+      merge_point(ring[i], pc);
+    }
+    for (int i = 0; i < n; i++) {
+      erase_if_unconnected(ring[i]);
+    }
+  }
+
+  void print_polygons_state() {
+    for (size_t k = 0; k < polygon_grid.size(); k++) {
+      if (polygon_grid.alive(k)) {
+        cout << polygon_grid.key(k) << ": " << polygon_grid.value(k) << endl;
+      }
+    }
+    cout << endl;
+  }
+
+
+  // has the connection through entry i that is entered from entry prev been collected?
+  bool pass_collected(int i, int prev) {
+    const point_connect &pc = polygon_grid.value(i);
+    if (pc.altpoint && pc.prev2 == prev) {
+      return pc.collected2;
+    }
+    return pc.collected;
+  }
+
+  // linear interpolation of boundary intersections
+  double interpolate(double x0, double x1, double z0, double z1, double value) {
+    double d = (value - z0) / (z1 - z0);
+    double x = x0 + d * (x1 - x0);
+    return x;
+  }
+
+  // calculate output coordinates for a given grid point
+  // coordinate of an edge crossing along its edge, i.e. x for horizontal and y for vertical
+  // edges; 0 for grid points, whose coordinates need no interpolation. Computed once per
+  // crossing, when the crossing is added to the polygon grid while the grid values of its
+  // cell are still in cache.
+  double edge_coord(const grid_point &p) {
+    switch(p.type) {
+    case hintersect_lo: // intersection with horizontal edge, low value
+      return interpolate(grid_x_p[p.c], grid_x_p[p.c+1], grid_z(p.r, p.c), grid_z(p.r, p.c + 1), vlo);
+    case hintersect_hi: // intersection with horizontal edge, high value
+      return interpolate(grid_x_p[p.c], grid_x_p[p.c+1], grid_z(p.r, p.c), grid_z(p.r, p.c + 1), vhi);
+    case vintersect_lo: // intersection with vertical edge, low value
+      return interpolate(grid_y_p[p.r], grid_y_p[p.r+1], grid_z(p.r, p.c), grid_z(p.r + 1, p.c), vlo);
+    case vintersect_hi: // intersection with vertical edge, high value
+      return interpolate(grid_y_p[p.r], grid_y_p[p.r+1], grid_z(p.r, p.c), grid_z(p.r + 1, p.c), vhi);
+    default:
+      return 0;
+    }
+  }
+
+  // output coordinates of the point of entry i of the polygon grid
+  point entry_coords(int i) const {
+    const grid_point &p = polygon_grid.key(i);
+    switch(p.type) {
+    case grid:
+      return point(grid_x_p[p.c], grid_y_p[p.r]);
+    case hintersect_lo:
+    case hintersect_hi:
+      return point(polygon_grid.coord(i), grid_y_p[p.r]);
+    default:
+      return point(grid_x_p[p.c], polygon_grid.coord(i));
+    }
+  }
+
+  // adds the elementary polygons that band_cases lists for ternary index "index" to the
+  // polygon grid at cell (r, c); all polygons must be drawn clockwise for proper merging
+  void process_cell(int r, int c, int index) {
+    const band_case &bc = band_cases[index];
+
+    int variant = 0;
+    if (bc.saddle != saddle_none) {
+      variant = saddle_variant(bc.saddle, central_value(r, c), vlo, vhi);
+    }
+
+    const cell_polygons &cp = bc.variant[variant];
+    const int sizes[] = {cp.first_size, cp.second_size};
+    const unsigned char *v = cp.vertex;
+    for (int k = 0; k < 2 && sizes[k] > 0; k++) {
+      tmp_poly_size = 0;
+      for (int i = 0; i < sizes[k]; i++, v++) {
+        const cell_vertex_point &p = cell_vertex_points[*v];
+        poly_add(r + p.dr, c + p.dc, p.type);
+      }
+      poly_merge();
+    }
+  }
+
+public:
+  isobander(double *x, int lenx, double *y, int leny, const grid_values &z, int nrow, int ncol, double value_low = 0, double value_high = 0,
+            store_mode store = store_auto) :
+    grid_x_p(x), grid_y_p(y), grid_z(z.layout(nrow)), nrow(nrow), ncol(ncol),
+    vlo(value_low), vhi(value_high), z_lo(0), z_hi(0), interrupted(false), block_pruning(true), block_pw(0), block_cw(0),
+    rank_lo(-1), rank_hi(-1)
+  {
+
+    if (lenx != ncol) {throw std::invalid_argument("Number of x coordinates must match number of columns in density matrix.");}
+    if (leny != nrow) {throw std::invalid_argument("Number of y coordinates must match number of rows in density matrix.");}
+
+    polygon_grid.setup(nrow, ncol, store);
+  }
+
+  virtual ~isobander() {}
+
+  bool was_interrupted() {return interrupted;}
+
+  // points the engine to another grid with its coordinates, keeping all buffers; the
+  // vertex store is set up again only if the dimensions change. Any pyramid or level ranks
+  // belong to the previous grid and are dropped.
+  void set_grid(double *x, int lenx, double *y, int leny, const grid_values &z, int nrow_in, int ncol_in) {
+    if (lenx != ncol_in) {throw std::invalid_argument("Number of x coordinates must match number of columns in density matrix.");}
+    if (leny != nrow_in) {throw std::invalid_argument("Number of y coordinates must match number of rows in density matrix.");}
+
+    grid_x_p = x;
+    grid_y_p = y;
+    grid_z = z.layout(nrow_in);
+    if (nrow_in != nrow || ncol_in != ncol) {
+      nrow = nrow_in;
+      ncol = ncol_in;
+      polygon_grid.setup(nrow, ncol, store_auto);
+    }
+    pyramid.reset();
+    ranks.reset();
+  }
+
+  // adds the number of node allocations the node pools of this engine served instead of
+  // the heap, i.e. the mallocs eliminated, and the number of chunks they allocated instead
+  virtual void pool_stats(size_t &pooled, size_t &chunks) const {
+    pooled += polygon_grid.node_memory().pooled_allocations();
+    chunks += polygon_grid.node_memory().chunk_allocations();
+  }
+
+  // entries of the polygon grid on the columns in seam_columns, e.g. the columns a tile
+  // shares with its neighbors
+  void column_entries(const vector<int> &seam_columns, vector<int> &entries) const {
+    entries.clear();
+    for (size_t k = 0; k < polygon_grid.size(); k++) {
+      if (!polygon_grid.alive(k)) continue;
+      int c = polygon_grid.key(k).c;
+      if (find(seam_columns.begin(), seam_columns.end(), c) != seam_columns.end()) {
+        entries.push_back(k);
+      }
+    }
+  }
+
+  // select how polygon vertices are looked up; resets the polygon grid
+  void set_store_mode(store_mode mode) {
+    polygon_grid.setup(nrow, ncol, mode);
+  }
+
+  // enables or disables skipping of blocks of cells that the contour doesn't cross
+  void set_block_pruning(bool enable) {
+    block_pruning = enable;
+  }
+
+  // shares a pyramid built for the same grid, e.g. between engines on different threads
+  void set_pyramid(shared_ptr<const minmax_pyramid> p) {
+    pyramid = p;
+  }
+
+  // classifies through level ranks of the same grid whenever both cutoffs are among their
+  // cutoffs; the results are the same as without them
+  void set_ranks(shared_ptr<const level_ranks> r) {
+    ranks = r;
+  }
+
+  void set_value(double value_low, double value_high) {
+    vlo = value_low;
+    vhi = value_high;
+  }
+
+  virtual void calculate_contour() {
+    // clear polygon grid and associated internal variables
+    reset_grid();
+
+    // if (checkInterrupt()) {
+    //   interrupted = true;
+    //   return;
+    // }
+
+    // only the blocks the band crosses are classified, and within them only the cells that
+    // are neither entirely below nor entirely above the band are visited
+    find_blocks(vlo, vhi);
+    for (size_t i = 0; i < mixed_blocks.size(); i++) {
+      const minmax_pyramid::block &b = mixed_blocks[i];
+      classify_block(b, false);
+
+      // all polygons must be drawn clockwise for proper merging
+      for (size_t w = 0; w < block_active.size(); w++) {
+        size_t j = w / block_cw;
+        for (uint64_t bits = block_active[w]; bits; bits &= bits - 1) {
+          size_t r = 64 * (w % block_cw) + lowest_bit(bits);
+          process_cell(b.r0 + r, b.c0 + j, block_cell_index(j, r, false));
+        }
+      }
+    }
+
+    // blocks entirely within the band
+    for (size_t i = 0; i < interior_blocks.size(); i++) {
+      poly_block(interior_blocks[i]);
+    }
+  }
+
+  // collects the polygons of the last contour into a newly allocated resultStruct
+  resultStruct collect() {
+    collect_paths();
+    return make_result(x_out, y_out, id);
+  }
+
+  // hands the paths of the last collect_paths() over by swapping them with x, y, ids, so
+  // that no memory is allocated or copied
+  void swap_paths(vector<double> &x, vector<double> &y, vector<int> &ids) {
+    x_out.swap(x);
+    y_out.swap(y);
+    id.swap(ids);
+  }
+
+  // collects the polygons of the last contour into x_out, y_out, id
+  virtual void collect_paths() {
     // Early exit if calculate_contour was interrupted
     // if (was_interrupted()) {
     //   return R_NilValue;
     // }
 
-    // make polygons
-    vector<double> x_out, y_out; vector<int> id;  // vectors holding resulting polygon paths
-    int cur_id = 0;           // id counter for the polygon lines
+    // make polygons
+    x_out.clear(); y_out.clear(); id.clear();
+    path_key.clear(); path_begin.clear();
+    int cur_id = 0;           // id counter for the polygon lines
+
+    // iterate over all locations in the polygon grid in raster order, so every ring starts
+    // at its lowest vertex and the rings come in the order of their starts
+    polygon_grid.raster_order(raster_entries, raster_by_col, raster_count);
+    for (size_t j = 0; j < raster_entries.size(); j++) {
+      int k = raster_entries[j];
+      const point_connect &pc = polygon_grid.value(k);
+      if ((pc.collected && !pc.altpoint) ||
+          (pc.collected && pc.collected2 && pc.altpoint)) {
+        continue; // skip any grid points that are already fully collected
+      }
+
+      // we have found a new polygon line; process it
+      cur_id++;
+      path_key.push_back(polygon_grid.key(k));
+      path_begin.push_back(x_out.size());
+
+      // points are entries of the polygon grid
+      int start = k;
+      int cur = start;
+      int prev = pc.prev;
+      // if this point has an alternative and it hasn't been collected yet then we start there
+      if (pc.altpoint && !pc.collected2) prev = pc.prev2;
+
+      int i = 0;
+      do {
+        point p = entry_coords(cur);
+        x_out.push_back(p.x);
+        y_out.push_back(p.y);
+        id.push_back(cur_id);
+
+        // record that we have processed this point and proceed to next
+        point_connect &cur_pc = polygon_grid.value(cur);
+        if (cur_pc.altpoint && cur_pc.prev2 == prev) {
+          // if an alternative point exists and its previous point in the polygon
+          // corresponds to the recorded previous point, then that's the point
+          // we're working with here
+
+          // mark current point as collected and advance
+          cur_pc.collected2 = true;
+          int newcur = cur_pc.next2;
+          prev = cur;
+          cur = newcur;
+        } else {
+          // mark current point as collected and advance
+          cur_pc.collected = true;
+          int newcur = cur_pc.next;
+          prev = cur;
+          cur = newcur;
+        }
+        i++;
+        // if (i % 100000 == 0 && checkInterrupt()) {
+        //   interrupted = true;
+        //   return R_NilValue;
+        // }
+      } while (!(cur == start && pass_collected(cur, prev))); // keep going until we reach the start point again
+      // (a ring can pass through an alternative point twice, so arriving at start via the other connection doesn't count)
+    }
+    // // output variable
+    // SEXP res = PROTECT(Rf_allocVector(VECSXP, 3));
+    // SEXP names = PROTECT(Rf_allocVector(STRSXP, 3));
+    // SET_STRING_ELT(names, 0, Rf_mkChar("x"));
+    // SET_STRING_ELT(names, 1, Rf_mkChar("y"));
+    // SET_STRING_ELT(names, 2, Rf_mkChar("id"));
+    // Rf_setAttrib(res, Rf_install("names"), names);
+
+    // int final_size = x_out.size();
+    // SEXP x_final = SET_VECTOR_ELT(res, 0, Rf_allocVector(REALSXP, final_size));
+    // double* x_final_p = REAL(x_final);
+    // SEXP y_final = SET_VECTOR_ELT(res, 1, Rf_allocVector(REALSXP, final_size));
+    // double* y_final_p = REAL(y_final);
+    // SEXP id_final = SET_VECTOR_ELT(res, 2, Rf_allocVector(INTSXP, final_size));
+    // int* id_final_p = INTEGER(id_final);
+
+    // for (int i = 0; i < final_size; ++i) {
+    //   x_final_p[i] = x_out[i];
+    //   y_final_p[i] = y_out[i];
+    //   id_final_p[i] = id[i];
+    // }
+
+    // UNPROTECT(2);
+  }
+};
+
+
+class isoliner : public isobander {
+protected:
+
+  void line_start(int r, int c, point_type type) { // start a new line segment
+    tmp_poly[0].r = r;
+    tmp_poly[0].c = c;
+    tmp_poly[0].type = type;
+
+    tmp_poly_size = 1;
+  }
+
+  void line_add(int r, int c, point_type type) { // add point to line
+    tmp_poly[tmp_poly_size].r = r;
+    tmp_poly[tmp_poly_size].c = c;
+    tmp_poly[tmp_poly_size].type = type;
+
+    tmp_poly_size++;
+  }
+
+  // attach q to a free connection slot of p; for lines, prev and next are just the two
+  // neighbors of a point and carry no orientation, so segments join in O(1) without
+  // ever having to reverse an existing line
+  void line_connect(int p, int q) {
+    point_connect &pc = polygon_grid.value(p);
+    if (pc.next < 0) {
+      pc.next = q;
+    } else if (pc.prev < 0) {
+      pc.prev = q;
+    } else {
+      // should never go here
+      throw std::runtime_error("cannot merge line segment at interior of existing line segment");
+    }
+  }
+
+  // returns the neighbor of p that we don't arrive from when coming from q; all three are
+  // entries of the polygon grid, -1 for none
+  int line_follow(int p, int q) {
+    const point_connect &pc = polygon_grid.value(p);
+    return (pc.prev == q) ? pc.next : pc.prev;
+  }
+
+  // moves the lines of an engine that has contoured the sub-grid starting at column c0 and
+  // that pass through any of its entries seam over into this grid, where lines that end on
+  // a seam get joined with their continuation; the tile marks the lines it hands over as
+  // collected, so that it collects only the lines that don't touch a seam itself
+  void merge_seam_lines(isoliner &tile, int c0, const vector<int> &seam) {
+    merge_entries.assign(tile.polygon_grid.size(), -1);
+    merge_list.clear();
+
+    // every point of a line is reached from the seam point through its neighbors
+    vector<int> todo;
+    for (size_t j = 0; j < seam.size(); j++) {
+      if (tile.polygon_grid.value(seam[j]).collected) continue;
+      tile.polygon_grid.value(seam[j]).collected = true;
+      todo.push_back(seam[j]);
+
+      while (!todo.empty()) {
+        int k = todo.back();
+        todo.pop_back();
+        const point_connect &tpc = tile.polygon_grid.value(k);
+        const int neighbors[] = {tpc.prev, tpc.next};
+        for (int n = 0; n < 2; n++) {
+          int q = neighbors[n];
+          if (q < 0) continue;
+          line_connect(merged_entry(tile, k, c0), merged_entry(tile, q, c0));
+          if (!tile.polygon_grid.value(q).collected) {
+            tile.polygon_grid.value(q).collected = true;
+            todo.push_back(q);
+          }
+        }
+      }
+    }
+  }
+
+  void line_merge() { // merge current line segment to prior line segments
+    //cout << "merging points: " << tmp_poly[0] << " " << tmp_poly[1] << endl;
+
+    int p0 = find_or_add(tmp_poly[0]);
+    int p1 = find_or_add(tmp_poly[1]);
+    line_connect(p0, p1);
+    line_connect(p1, p0);
+
+    //cout << "new grid:" << endl;
+    //print_polygons_state();
+  }
+
+  // draws the isoline segments of the cell at r, c with cell index `index`
+  void process_line_cell(int r, int c, int index) {
+    // two-segment saddles
+    if (index == 5 && (central_value(r, c) < vlo)) {
+      index = 10;
+    } else if (index == 10 && (central_value(r, c) < vlo)) {
+      index = 5;
+    }
+
+    switch(index) {
+    case 0: break;
+    case 1:
+      line_start(r, c, vintersect_lo);
+      line_add(r+1, c, hintersect_lo);
+      line_merge();
+      break;
+    case 2:
+      line_start(r, c+1, vintersect_lo);
+      line_add(r+1, c, hintersect_lo);
+      line_merge();
+      break;
+    case 3:
+      line_start(r, c, vintersect_lo);
+      line_add(r, c+1, vintersect_lo);
+      line_merge();
+      break;
+    case 4:
+      line_start(r, c, hintersect_lo);
+      line_add(r, c+1, vintersect_lo);
+      line_merge();
+      break;
+    case 5:
+      // like case 2
+      line_start(r, c+1, vintersect_lo);
+      line_add(r+1, c, hintersect_lo);
+      line_merge();
+      // like case 7
+      line_start(r, c, hintersect_lo);
+      line_add(r, c, vintersect_lo);
+      line_merge();
+      break;
+    case 6:
+      line_start(r, c, hintersect_lo);
+      line_add(r+1, c, hintersect_lo);
+      line_merge();
+      break;
+    case 7:
+      line_start(r, c, hintersect_lo);
+      line_add(r, c, vintersect_lo);
+      line_merge();
+      break;
+    case 8:
+      line_start(r, c, hintersect_lo);
+      line_add(r, c, vintersect_lo);
+      line_merge();
+      break;
+    case 9:
+      line_start(r, c, hintersect_lo);
+      line_add(r+1, c, hintersect_lo);
+      line_merge();
+      break;
+    case 10:
+      // like case 1
+      line_start(r, c, vintersect_lo);
+      line_add(r+1, c, hintersect_lo);
+      line_merge();
+      // like case 4
+      line_start(r, c, hintersect_lo);
+      line_add(r, c+1, vintersect_lo);
+      line_merge();
+      break;
+    case 11:
+      line_start(r, c, hintersect_lo);
+      line_add(r, c+1, vintersect_lo);
+      line_merge();
+      break;
+    case 12:
+      line_start(r, c, vintersect_lo);
+      line_add(r, c+1, vintersect_lo);
+      line_merge();
+      break;
+    case 13:
+      line_start(r, c+1, vintersect_lo);
+      line_add(r+1, c, hintersect_lo);
+      line_merge();
+      break;
+    case 14:
+      line_start(r, c, vintersect_lo);
+      line_add(r+1, c, hintersect_lo);
+      line_merge();
+      break;
+    default: break; // catch everything, just in case
+    }
+  }
+
+public:
+  isoliner(double *x, int lenx, double *y, int leny, const grid_values &z, int nrow, int ncol, double value = 0,
+           store_mode store = store_auto) :
+    isobander(x, lenx, y, leny, z, nrow, ncol, value, 0, store) {}
+
+  void set_value(double value) {
+    vlo = value;
+  }
+
+  virtual void calculate_contour() {
+    // clear polygon grid and associated internal variables
+    reset_grid();
+
+    // if (checkInterrupt()) {
+    //   interrupted = true;
+    //   return;
+    // }
+
+    // only the blocks the isoline crosses are classified, and within them only the cells
+    // that don't have all corners on the same side of the value are visited
+    find_blocks(vlo, vlo);
+    for (size_t i = 0; i < mixed_blocks.size(); i++) {
+      const minmax_pyramid::block &b = mixed_blocks[i];
+      classify_block(b, true);
+
+      for (size_t w = 0; w < block_active.size(); w++) {
+        size_t j = w / block_cw;
+        for (uint64_t bits = block_active[w]; bits; bits &= bits - 1) {
+          size_t r = 64 * (w % block_cw) + lowest_bit(bits);
+          process_line_cell(b.r0 + r, b.c0 + j, block_cell_index(j, r, true));
+        }
+      }
+    }
+  }
+
+  virtual void collect_paths() {
+    // // Early exit if calculate_contour was interrupted
+    // if (was_interrupted()) {
+    //   return R_NilValue;
+    // }
+
+    // make line segments
+    x_out.clear(); y_out.clear(); id.clear();
+    path_key.clear(); path_begin.clear();
+    int cur_id = 0;           // id counter for individual line segments
+
+    // iterate over all locations in the polygon grid in raster order, so the lines come in
+    // the order of their lowest vertices. Closed lines start there and head towards the lower
+    // of its two neighbors, open lines start at their lower end; the output thus depends only
+    // on the contour, not on how the engine assembled it.
+    polygon_grid.raster_order(raster_entries, raster_by_col, raster_count);
+    for (size_t j = 0; j < raster_entries.size(); j++) {
+      int k = raster_entries[j];
+      //cout << polygon_grid.key(k) << " " << polygon_grid.value(k).collected << endl;
+      if (polygon_grid.value(k).collected) {
+        continue; // skip any grid points that are already collected
+      }
+
+      // we have found a new polygon line; process it
+      cur_id++;
+      path_key.push_back(polygon_grid.key(k));
+      path_begin.push_back(x_out.size());
+
+      // points are entries of the polygon grid, -1 for none
+      int start = k;
+      int cur = start;
+      int from = polygon_grid.value(cur).next; // walk backwards, as if we had arrived via next
+      bool closed = false;
+
+      int i = 0;
+      // back-track until we find the beginning of the line or circle around once
+      while (true) {
+        int back = line_follow(cur, from);
+        if (back < 0) break; // cur is the beginning of the line
+        from = cur;
+        cur = back;
+        i++;
+        // if (i % 100000 == 0 && checkInterrupt()) {
+        //   interrupted = true;
+        //   return R_NilValue;
+        // }
+        if (cur == start) {
+          closed = true;
+          break;
+        }
+      }
+
+      // walk forward, away from the point we arrived from (none if we start at the beginning of a line)
+      int prev = closed ? from : -1;
+      start = cur; // reset starting point
+      if (closed) {
+        int ahead = line_follow(cur, from);
+        if (raster_less(polygon_grid.key(from), polygon_grid.key(ahead))) {
+          prev = ahead; // turn around, towards the lower neighbor
+        }
+      }
+      size_t line_begin = x_out.size();
+      i = 0;
+      do {
+        //cout << cur << endl;
+        point p = entry_coords(cur);
+
+        x_out.push_back(p.x);
+        y_out.push_back(p.y);
+        id.push_back(cur_id);
+
+        // record that we have processed this point and proceed to next
+        polygon_grid.value(cur).collected = true;
+        int newcur = line_follow(cur, prev);
+        prev = cur;
+        cur = newcur;
+        i++;
+        // if (i % 100000 == 0 && checkInterrupt()) {
+        //   interrupted = true;
+        //   return R_NilValue;
+        // }
+      } while (!(cur == start || cur < 0)); // keep going until we reach the start point again
+      // if we're back to start, need to output that point one more time
+      if (cur == start) {
+        point p = entry_coords(cur);
+        x_out.push_back(p.x);
+        y_out.push_back(p.y);
+        id.push_back(cur_id);
+      } else if (raster_less(polygon_grid.key(prev), polygon_grid.key(start))) {
+        // open line whose other end, prev, is the lower one
+        reverse(x_out.begin() + line_begin, x_out.end());
+        reverse(y_out.begin() + line_begin, y_out.end());
+      }
+    }
+    // // output variable
+    // SEXP res = PROTECT(Rf_allocVector(VECSXP, 3));
+    // SEXP names = PROTECT(Rf_allocVector(STRSXP, 3));
+    // SET_STRING_ELT(names, 0, Rf_mkChar("x"));
+    // SET_STRING_ELT(names, 1, Rf_mkChar("y"));
+    // SET_STRING_ELT(names, 2, Rf_mkChar("id"));
+    // Rf_setAttrib(res, Rf_install("names"), names);
+
+    // int final_size = x_out.size();
+    // SEXP x_final = SET_VECTOR_ELT(res, 0, Rf_allocVector(REALSXP, final_size));
+    // double* x_final_p = REAL(x_final);
+    // SEXP y_final = SET_VECTOR_ELT(res, 1, Rf_allocVector(REALSXP, final_size));
+    // double* y_final_p = REAL(y_final);
+    // SEXP id_final = SET_VECTOR_ELT(res, 2, Rf_allocVector(INTSXP, final_size));
+    // int* id_final_p = INTEGER(id_final);
+
+    // for (int i = 0; i < final_size; ++i) {
+    //   x_final_p[i] = x_out[i];
+    //   y_final_p[i] = y_out[i];
+    //   id_final_p[i] = id[i];
+    // }
+  }
+};
+
+
+// directed edge between two vertices, by which the sweeping engines find the open chains
+// a finished vertex continues
+struct grid_edge {
+  grid_point from, to;
+
+  grid_edge(const grid_point &from_in = grid_point(), const grid_point &to_in = grid_point()) : from(from_in), to(to_in) {}
+};
+
+struct grid_edge_hasher {
+  size_t operator()(const grid_edge& e) const
+  {
+    grid_point_hasher h;
+    size_t h1 = h(e.from);
+    return h1 ^ (h(e.to) + 0x9e3779b9 + (h1 << 6) + (h1 >> 2));
+  }
+};
+
+bool operator==(const grid_edge &e1, const grid_edge &e2) {
+  return (e1.from == e2.from) && (e1.to == e2.to);
+}
+
+typedef pool_allocator<pair<const grid_edge, int> > chainmap_allocator;
+typedef unordered_map<grid_edge, int, grid_edge_hasher, equal_to<grid_edge>, chainmap_allocator> chainmap;
+
+// isoband engine that sweeps the grid one row of cells at a time
+//
+// Only the vertices on the active boundary, i.e. on the two grid rows spanned by the
+// current row of cells, are held in the polygon grid. Once a row of cells has been
+// processed, the vertices on its upper grid row can't change anymore. They are turned
+// into output coordinates and appended to open chains, and a ring is emitted as soon
+// as its chain closes. Working memory therefore scales with the number of columns plus
+// the size of the rings that are still open, not with the size of the grid.
+class isobander_sweep : public isobander {
+protected:
+  // finished vertex in an open chain
+  struct chain_node {
+    double x, y;
+    int next; // next node in the chain (or in the free list)
+  };
+
+  // chain of finished vertices; "in" enters its first and "out" leaves its last vertex
+  struct chain {
+    int head, tail;
+    grid_edge in, out;
+  };
+
+  vector<chain_node> nodes;
+  int free_node; // head of the list of free nodes
+  vector<chain> chains;
+  vector<int> free_chains;
+  unique_ptr<node_pool> chain_pool; // nodes of chain_by_in and chain_by_out
+  chainmap chain_by_in, chain_by_out;
+
+  // ternarized grid rows r and r+1 of the current row of cells, packed into three bit
+  // planes (lo, hi, nonfinite as in classify_kernels) of row_words words each
+  vector<uint64_t> tern_top, tern_bottom;
+  size_t row_words;
+
+  int cur_id;
+
+  vector<int> row_entries; // scratch for finish_row()
+  // entries of the last finished row, which the connections of the next row still refer to
+  vector<int> held_entries;
+
+  void ternarize_row(int r, vector<uint64_t> &t) {
+    uint64_t *lo = t.data(), *hi = lo + row_words, *nonfinite = hi + row_words;
+    if (grid_z.col_stride == 1) {
+      // the row is contiguous, e.g. in a row-major grid, so the kernels can classify it in place
+      if (!grid_z.floating()) fill(nonfinite, nonfinite + row_words, 0);
+      classify_values(kernels(), grid_z.window(r, 0).data, ncol, false, lo, hi, grid_z.floating() ? nonfinite : 0);
+      return;
+    }
+
+    fill(t.begin(), t.end(), 0);
+    for (int c = 0; c < ncol; c++) {
+      double z = grid_z(r, c);
+      lo[c / 64] |= static_cast<uint64_t>(z >= vlo && z < vhi) << (c % 64);
+      hi[c / 64] |= static_cast<uint64_t>(z >= vhi) << (c % 64);
+      nonfinite[c / 64] |= static_cast<uint64_t>(!isfinite(z)) << (c % 64);
+    }
+  }
+
+  // ternary state of grid column c of a packed row
+  int row_state(const vector<uint64_t> &t, int c) {
+    return packed_bit(t.data(), c) + 2 * packed_bit(t.data() + row_words, c);
+  }
+
+  int new_node(const point &p) {
+    int n;
+    if (free_node >= 0) {
+      n = free_node;
+      free_node = nodes[n].next;
+    } else {
+      n = nodes.size();
+      nodes.push_back(chain_node());
+    }
+    nodes[n].x = p.x;
+    nodes[n].y = p.y;
+    nodes[n].next = -1;
+    return n;
+  }
+
+  int new_chain(int n, const grid_edge &in, const grid_edge &out) {
+    chain ch = {n, n, in, out};
+    int i;
+    if (free_chains.empty()) {
+      i = chains.size();
+      chains.push_back(ch);
+    } else {
+      i = free_chains.back();
+      free_chains.pop_back();
+      chains[i] = ch;
+    }
+    chain_by_in[in] = i;
+    chain_by_out[out] = i;
+    return i;
+  }
+
+  // outputs a closed chain as a ring and releases its nodes
+  void emit_ring(int i) {
+    cur_id++;
+    int n = chains[i].head;
+    while (n >= 0) {
+      x_out.push_back(nodes[n].x);
+      y_out.push_back(nodes[n].y);
+      id.push_back(cur_id);
+
+      int next = nodes[n].next;
+      nodes[n].next = free_node;
+      free_node = n;
+      n = next;
+    }
+    free_chains.push_back(i);
+  }
+
+  // adds the finished connection a -> p -> b, with p at xy, to the open chains
+  void finish_connection(const grid_point &p, const point &xy, const grid_point &a, const grid_point &b) {
+    int n = new_node(xy);
+    grid_edge in(a, p), out(p, b);
+
+    chainmap::iterator il = chain_by_out.find(in);  // chain ending in a -> p
+    chainmap::iterator ir = chain_by_in.find(out);  // chain starting with p -> b
+    int left = (il == chain_by_out.end()) ? -1 : il->second;
+    int right = (ir == chain_by_in.end()) ? -1 : ir->second;
+
+    if (left < 0 && right < 0) {
+      new_chain(n, in, out);
+    } else if (right < 0) { // append to left chain
+      chain_by_out.erase(il);
+      nodes[chains[left].tail].next = n;
+      chains[left].tail = n;
+      chains[left].out = out;
+      chain_by_out[out] = left;
+    } else if (left < 0) { // prepend to right chain
+      chain_by_in.erase(ir);
+      nodes[n].next = chains[right].head;
+      chains[right].head = n;
+      chains[right].in = in;
+      chain_by_in[in] = right;
+    } else if (left != right) { // join the two chains
+      chain_by_out.erase(il);
+      chain_by_in.erase(ir);
+      chain_by_out.erase(chains[right].out);
+      nodes[chains[left].tail].next = n;
+      nodes[n].next = chains[right].head;
+      chains[left].tail = chains[right].tail;
+      chains[left].out = chains[right].out;
+      chain_by_out[chains[left].out] = left;
+      free_chains.push_back(right);
+    } else { // chain closes into a ring
+      chain_by_out.erase(il);
+      chain_by_in.erase(ir);
+      nodes[chains[left].tail].next = n;
+      chains[left].tail = n;
+      emit_ring(left);
+    }
+  }
+
+  // moves all vertices on grid row r out of the polygon grid and into the open chains, by
+  // column and point type; the store only holds the active boundary, so scanning its
+  // entries is much cheaper than looking up every point of a wide row. The entries of
+  // row r are only recycled once row r + 1 is finished, since its vertices refer to them.
+  void finish_row(int r) {
+    row_entries.clear();
+    for (size_t i = 0; i < polygon_grid.size(); i++) {
+      if (polygon_grid.alive(i) && polygon_grid.key(i).r == r) row_entries.push_back(i);
+    }
+    const vertex_store &store = polygon_grid;
+    sort(row_entries.begin(), row_entries.end(), [&store](int i, int j) {
+      return raster_less(store.key(i), store.key(j));
+    });
+
+    for (size_t i = 0; i < row_entries.size(); i++) {
+      int e = row_entries[i];
+      grid_point p = polygon_grid.key(e);
+      point xy = entry_coords(e);
+      point_connect pc = polygon_grid.value(e);
+      polygon_grid.erase(p, false);
+      finish_connection(p, xy, polygon_grid.key(pc.prev), polygon_grid.key(pc.next));
+      if (pc.altpoint) {
+        finish_connection(p, xy, polygon_grid.key(pc.prev2), polygon_grid.key(pc.next2));
+      }
+    }
+
+    for (size_t i = 0; i < held_entries.size(); i++) {
+      polygon_grid.recycle(held_entries[i]);
+    }
+    held_entries.swap(row_entries);
+  }
+
+  void reset_sweep() {
+    nodes.clear();
+    free_node = -1;
+    chains.clear();
+    free_chains.clear();
+    chain_by_in.clear();
+    chain_by_out.clear();
+    chain_pool->release();
+    held_entries.clear();
+    x_out.clear();
+    y_out.clear();
+    id.clear();
+    cur_id = 0;
+  }
+
+public:
+  // only the active boundary is stored, so a dense grid-sized index would defeat the purpose
+  isobander_sweep(double *x, int lenx, double *y, int leny, const grid_values &z, int nrow, int ncol, double value_low = 0, double value_high = 0) :
+    isobander(x, lenx, y, leny, z, nrow, ncol, value_low, value_high, store_hashed),
+    free_node(-1), chain_pool(new node_pool()),
+    chain_by_in(0, grid_edge_hasher(), equal_to<grid_edge>(), chainmap_allocator(chain_pool.get())),
+    chain_by_out(0, grid_edge_hasher(), equal_to<grid_edge>(), chainmap_allocator(chain_pool.get())),
+    tern_top(3 * ((ncol + 63) / 64)), tern_bottom(3 * ((ncol + 63) / 64)),
+    row_words((ncol + 63) / 64), cur_id(0) {}
+
+  virtual void pool_stats(size_t &pooled, size_t &chunks) const {
+    isobander::pool_stats(pooled, chunks);
+    pooled += chain_pool->pooled_allocations();
+    chunks += chain_pool->chunk_allocations();
+  }
+
+  virtual void calculate_contour() {
+    begin_sweep();
+    if (nrow > 0) {
+      sweep_rows(0, nrow - 1);
+    }
+    end_sweep();
+  }
+
+  // The sweep can also be run in steps, for grids that arrive in strips of rows: after
+  // begin_sweep(), every sweep_rows() call processes the rows of cells between grid rows
+  // r0 and r1, which grid_z must hold, and end_sweep() finishes the last grid row. The
+  // strips of consecutive calls overlap in one grid row, i.e. r0 is the r1 of the previous
+  // call, and grid_z may point elsewhere for every call.
+  void begin_sweep() {
+    // clear polygon grid, open chains, and output
+    reset_grid();
+    reset_sweep();
+    z_lo = grid_z.threshold(vlo);
+    z_hi = grid_z.threshold(vhi);
+  }
+
+  void sweep_rows(int r0, int r1) {
+    if (r0 == 0) {
+      ternarize_row(0, tern_bottom);
+    } // otherwise, row r0 was ternarized as the last row of the previous strip
+
+    for (int r = r0; r < r1; r++) {
+      tern_top.swap(tern_bottom);
+      ternarize_row(r + 1, tern_bottom);
+
+      // only cells whose corners aren't all below or all above the band contribute, and we
+      // don't draw any contours if at least one of the corners is NA
+      const uint64_t *top = tern_top.data(), *bottom = tern_bottom.data();
+      const size_t n = row_words;
+      for (int w = 0; 64 * w < ncol - 1; w++) {
+        uint64_t active =
+          (corners_any(top, bottom, w, n) | corners_differ(top + n, bottom + n, w, n)) &
+          ~corners_any(top + 2 * n, bottom + 2 * n, w, n);
+        if (64 * (w + 1) > ncol - 1) active &= (uint64_t(1) << ((ncol - 1) % 64)) - 1;
+
+        for (; active; active &= active - 1) {
+          int c = 64 * w + lowest_bit(active);
+          int index = 27*row_state(tern_top, c) + 9*row_state(tern_top, c + 1) + 3*row_state(tern_bottom, c + 1) + row_state(tern_bottom, c);
+          process_cell(r, c, index);
+        }
+      }
+
+      // row r is not touched by any later cell
+      finish_row(r);
+    }
+  }
+
+  void end_sweep() {
+    if (nrow > 0) {
+      finish_row(nrow - 1);
+    }
+
+    if (chains.size() != free_chains.size()) {
+      throw std::runtime_error("polygon sweep finished with unclosed rings");
+    }
+  }
+
+  // points the engine to the values of a strip whose first row is grid row r0
+  void set_strip(const grid_values &strip, int r0) {
+    grid_z = strip.window(-r0, 0);
+  }
+
+  // the rings emitted since the last call, which are removed from the engine
+  resultStruct take_rings() {
+    resultStruct result = make_result(x_out, y_out, id);
+    x_out.clear();
+    y_out.clear();
+    id.clear();
+    return result;
+  }
+
+  // bytes of working memory held by the engine: the active boundary, the open chains and
+  // the packed rows, but not the rings emitted so far
+  size_t working_memory() const {
+    return polygon_grid.memory() + nodes.capacity() * sizeof(chain_node) +
+      chains.capacity() * sizeof(chain) + free_chains.capacity() * sizeof(int) +
+      chain_pool->chunk_allocations() * node_pool::chunk_size +
+      (chain_by_in.bucket_count() + chain_by_out.bucket_count()) * sizeof(void*) +
+      (tern_top.capacity() + tern_bottom.capacity()) * sizeof(uint64_t) +
+      (row_entries.capacity() + held_entries.capacity()) * sizeof(int);
+  }
+
+  // the rings are emitted into x_out, y_out, id as soon as they close, so they are complete
+  // once calculate_contour() has finished
+  virtual void collect_paths() {}
+};
+
+// isoline engine that sweeps the grid one row of cells at a time, like isobander_sweep
+//
+// The vertices of a finished grid row leave the polygon grid for open chains. Lines have
+// no direction, so a chain can grow at either end; each end either continues to a vertex
+// that is still on the active boundary or is the end of the line. A line is emitted as
+// soon as both ends of its chain are line ends, or once the chain closes into a loop.
+class isoliner_sweep : public isoliner {
+protected:
+  // finished vertex in an open chain, with its neighbors in the chain (-1 for none); free
+  // nodes are listed through link[0]
+  struct line_node {
+    double x, y;
+    int link[2];
+  };
+
+  // chain of finished vertices; at end k, which is node end[k], the line continues along
+  // edge[k] if open[k] is set, and ends otherwise
+  struct line_chain {
+    int end[2];
+    bool open[2];
+    grid_edge edge[2];
+  };
+
+  vector<line_node> nodes;
+  int free_node; // head of the list of free nodes
+  vector<line_chain> chains;
+  vector<int> free_chains;
+  unique_ptr<node_pool> chain_pool; // nodes of chain_ends
+  chainmap chain_ends; // open chain ends by their edge, as 2 * chain + end
+
+  // grid rows r and r+1 of the current row of cells, binarized into two bit planes (at
+  // or above the value, nonfinite) of row_words words each
+  vector<uint64_t> bin_top, bin_bottom;
+  size_t row_words;
+
+  int cur_id;
+
+  vector<int> row_entries; // scratch for finish_row()
+  // entries of the last finished row, which the connections of the next row still refer to
+  vector<int> held_entries;
+
+  void binarize_row(int r, vector<uint64_t> &t) {
+    uint64_t *ge = t.data(), *nonfinite = ge + row_words;
+    if (grid_z.col_stride == 1) {
+      if (!grid_z.floating()) fill(nonfinite, nonfinite + row_words, 0);
+      classify_values(kernels(), grid_z.window(r, 0).data, ncol, true, ge, 0, grid_z.floating() ? nonfinite : 0);
+      return;
+    }
+
+    fill(t.begin(), t.end(), 0);
+    for (int c = 0; c < ncol; c++) {
+      double z = grid_z(r, c);
+      ge[c / 64] |= static_cast<uint64_t>(z >= vlo) << (c % 64);
+      nonfinite[c / 64] |= static_cast<uint64_t>(!isfinite(z)) << (c % 64);
+    }
+  }
+
+  int new_node(const point &p) {
+    int n;
+    if (free_node >= 0) {
+      n = free_node;
+      free_node = nodes[n].link[0];
+    } else {
+      n = nodes.size();
+      nodes.push_back(line_node());
+    }
+    nodes[n].x = p.x;
+    nodes[n].y = p.y;
+    nodes[n].link[0] = nodes[n].link[1] = -1;
+    return n;
+  }
+
+  void link_nodes(int a, int b) {
+    nodes[a].link[nodes[a].link[0] < 0 ? 0 : 1] = b;
+    nodes[b].link[nodes[b].link[0] < 0 ? 0 : 1] = a;
+  }
+
+  // sets end k of chain i to node n, continuing along e if open
+  void set_end(int i, int k, int n, bool open, const grid_edge &e) {
+    line_chain &ch = chains[i];
+    ch.end[k] = n;
+    ch.open[k] = open;
+    ch.edge[k] = e;
+    if (open) chain_ends[e] = 2 * i + k;
+  }
+
+  // outputs chain i as a line, starting at node start, and releases its nodes; a closed
+  // line repeats its first point at the end, as in isoliner::collect_paths()
+  void emit_line(int i, int start) {
+    cur_id++;
+    point first(nodes[start].x, nodes[start].y);
+    int prev = -1, n = start;
+    bool closed = false;
+    while (n >= 0) {
+      x_out.push_back(nodes[n].x);
+      y_out.push_back(nodes[n].y);
+      id.push_back(cur_id);
+
+      int next = (nodes[n].link[0] == prev) ? nodes[n].link[1] : nodes[n].link[0];
+      if (prev >= 0) {
+        nodes[prev].link[0] = free_node;
+        free_node = prev;
+      }
+      prev = n;
+      n = next;
+      if (n == start) {
+        closed = true;
+        break;
+      }
+    }
+    if (closed) {
+      x_out.push_back(first.x);
+      y_out.push_back(first.y);
+      id.push_back(cur_id);
+    }
+    nodes[prev].link[0] = free_node;
+    free_node = prev;
+    free_chains.push_back(i);
+  }
+
+  // adds the finished vertex p, with neighbors a and b (entries of the polygon grid, -1 for
+  // none) and at xy, to the open chains
+  void finish_vertex(const grid_point &p, const point &xy, int a, int b) {
+    int n = new_node(xy);
+    const int neighbors[] = {a, b};
+    grid_edge pending[2];
+    int found[2] = {-1, -1}; // chain ends that arrive at p, as 2 * chain + end
+
+    for (int k = 0; k < 2; k++) {
+      if (neighbors[k] < 0) continue;
+      const grid_point &q = polygon_grid.key(neighbors[k]);
+      chainmap::iterator it = chain_ends.find(grid_edge(q, p));
+      if (it != chain_ends.end()) {
+        found[k] = it->second;
+        chain_ends.erase(it);
+      } else {
+        pending[k] = grid_edge(p, q);
+      }
+    }
 
-    // iterate over all locations in the polygon grid
-    for (auto it = polygon_grid.begin(); it != polygon_grid.end(); it++) {
-      if (((it->second).collected && !(it->second).altpoint) ||
-          ((it->second).collected && (it->second).collected2 && (it->second).altpoint)) {
-        continue; // skip any grid points that are already fully collected
+    if (found[0] < 0 && found[1] < 0) {
+      int i;
+      if (free_chains.empty()) {
+        i = chains.size();
+        chains.push_back(line_chain());
+      } else {
+        i = free_chains.back();
+        free_chains.pop_back();
       }
+      set_end(i, 0, n, neighbors[0] >= 0, pending[0]);
+      set_end(i, 1, n, neighbors[1] >= 0, pending[1]);
+      return;
+    }
 
-      // we have found a new polygon line; process it
-      cur_id++;
+    if (found[0] < 0 || found[1] < 0) { // extend a chain at one end
+      int k = (found[0] >= 0) ? 0 : 1;
+      int i = found[k] / 2, e = found[k] % 2;
+      link_nodes(chains[i].end[e], n);
+      set_end(i, e, n, neighbors[1 - k] >= 0, pending[1 - k]);
+      if (!chains[i].open[0] && !chains[i].open[1]) emit_line(i, chains[i].end[0]);
+      return;
+    }
+
+    int left = found[0] / 2, el = found[0] % 2;
+    int right = found[1] / 2, er = found[1] % 2;
+    link_nodes(chains[left].end[el], n);
+    link_nodes(n, chains[right].end[er]);
+    if (left == right) { // chain closes into a loop
+      emit_line(left, n);
+      return;
+    }
+
+    // join the two chains; the far end of the right chain becomes end el of the left one
+    const line_chain &rc = chains[right];
+    set_end(left, el, rc.end[1 - er], rc.open[1 - er], rc.edge[1 - er]);
+    free_chains.push_back(right);
+    if (!chains[left].open[0] && !chains[left].open[1]) emit_line(left, chains[left].end[0]);
+  }
+
+  // moves all vertices on grid row r out of the polygon grid and into the open chains, as
+  // in isobander_sweep::finish_row()
+  void finish_row(int r) {
+    row_entries.clear();
+    for (size_t i = 0; i < polygon_grid.size(); i++) {
+      if (polygon_grid.alive(i) && polygon_grid.key(i).r == r) row_entries.push_back(i);
+    }
+    const vertex_store &store = polygon_grid;
+    sort(row_entries.begin(), row_entries.end(), [&store](int i, int j) {
+      return raster_less(store.key(i), store.key(j));
+    });
+
+    for (size_t i = 0; i < row_entries.size(); i++) {
+      int e = row_entries[i];
+      grid_point p = polygon_grid.key(e);
+      point xy = entry_coords(e);
+      point_connect pc = polygon_grid.value(e);
+      polygon_grid.erase(p, false);
+      finish_vertex(p, xy, pc.prev, pc.next);
+    }
+
+    for (size_t i = 0; i < held_entries.size(); i++) {
+      polygon_grid.recycle(held_entries[i]);
+    }
+    held_entries.swap(row_entries);
+  }
+
+  void reset_sweep() {
+    nodes.clear();
+    free_node = -1;
+    chains.clear();
+    free_chains.clear();
+    chain_ends.clear();
+    chain_pool->release();
+    held_entries.clear();
+    x_out.clear();
+    y_out.clear();
+    id.clear();
+    cur_id = 0;
+  }
+
+public:
+  isoliner_sweep(double *x, int lenx, double *y, int leny, const grid_values &z, int nrow, int ncol, double value = 0) :
+    isoliner(x, lenx, y, leny, z, nrow, ncol, value, store_hashed),
+    free_node(-1), chain_pool(new node_pool()),
+    chain_ends(0, grid_edge_hasher(), equal_to<grid_edge>(), chainmap_allocator(chain_pool.get())),
+    bin_top(2 * ((ncol + 63) / 64)), bin_bottom(2 * ((ncol + 63) / 64)),
+    row_words((ncol + 63) / 64), cur_id(0) {}
+
+  virtual void pool_stats(size_t &pooled, size_t &chunks) const {
+    isoliner::pool_stats(pooled, chunks);
+    pooled += chain_pool->pooled_allocations();
+    chunks += chain_pool->chunk_allocations();
+  }
+
+  virtual void calculate_contour() {
+    reset_grid();
+    reset_sweep();
+    z_lo = grid_z.threshold(vlo);
+    if (nrow == 0) return;
+
+    binarize_row(0, bin_bottom);
+    for (int r = 0; r < nrow - 1; r++) {
+      bin_top.swap(bin_bottom);
+      binarize_row(r + 1, bin_bottom);
+
+      // only cells whose corners aren't all on the same side of the value contribute, and
+      // we don't draw any contours if at least one of the corners is NA
+      const uint64_t *top = bin_top.data(), *bottom = bin_bottom.data();
+      const size_t n = row_words;
+      for (int w = 0; 64 * w < ncol - 1; w++) {
+        uint64_t active = corners_differ(top, bottom, w, n) & ~corners_any(top + n, bottom + n, w, n);
+        if (64 * (w + 1) > ncol - 1) active &= (uint64_t(1) << ((ncol - 1) % 64)) - 1;
+
+        for (; active; active &= active - 1) {
+          int c = 64 * w + lowest_bit(active);
+          int index = 8*packed_bit(top, c) + 4*packed_bit(top, c + 1) + 2*packed_bit(bottom, c + 1) + packed_bit(bottom, c);
+          process_line_cell(r, c, index);
+        }
+      }
+
+      // row r is not touched by any later cell
+      finish_row(r);
+    }
+    finish_row(nrow - 1);
+
+    if (chains.size() != free_chains.size()) {
+      throw std::runtime_error("line sweep finished with unfinished lines");
+    }
+  }
+
+  // the lines are emitted into x_out, y_out, id as soon as they are complete
+  virtual void collect_paths() {}
+};
+
+// number of threads to use for n_tasks independent tasks; n_threads <= 0 means one per core
+int thread_count(int n_threads, int n_tasks) {
+  if (n_threads <= 0) {
+    n_threads = thread::hardware_concurrency();
+  }
+  if (n_threads > n_tasks) n_threads = n_tasks;
+  return (n_threads < 1) ? 1 : n_threads;
+}
+
+// runs work() concurrently on n_threads threads, one of which is the calling thread;
+// the first exception thrown by any of them is rethrown once all threads have finished
+template <class Work>
+void run_threads(int n_threads, Work work) {
+  exception_ptr error;
+  mutex error_mutex;
+
+  auto guarded_work = [&]() {
+    try {
+      work();
+    } catch (...) {
+      lock_guard<mutex> lock(error_mutex);
+      if (!error) error = current_exception();
+    }
+  };
+
+  vector<thread> threads;
+  for (int i = 1; i < n_threads; i++) {
+    threads.push_back(thread(guarded_work));
+  }
+  guarded_work();
+  for (auto it = threads.begin(); it != threads.end(); it++) {
+    it->join();
+  }
+
+  if (error) rethrow_exception(error);
+}
+
+// level ranks only pay off once there are enough levels to amortize the ranking pass
+const int rank_min_levels = 8;
+
+// whether to classify n_levels levels with the given cutoffs through level ranks
+bool use_ranks(const vector<double> &cutoffs, int n_levels) {
+  return n_levels >= rank_min_levels && cutoffs.size() <= static_cast<size_t>(level_ranks::max_cutoffs);
+}
+
+// level ranks of z for the cutoffs of n_levels levels, or an empty pointer if there are
+// too few levels or too many distinct cutoffs
+shared_ptr<const level_ranks> make_ranks(const grid_values &z, int nrow, int ncol, const vector<double> &cutoffs, int n_levels) {
+  if (!use_ranks(cutoffs, n_levels)) {
+    return shared_ptr<const level_ranks>();
+  }
+  return make_shared<level_ranks>(z, nrow, ncol, cutoffs);
+}
+
+// all cutoffs of a set of bands
+vector<double> band_cutoffs(const double *values_low, const double *values_high, int n_bands) {
+  vector<double> cutoffs(values_low, values_low + n_bands);
+  cutoffs.insert(cutoffs.end(), values_high, values_high + n_bands);
+  return cutoffs;
+}
+
+// first column of each of n_tiles column tiles; neighboring tiles share one column, and
+// the last element holds the last column of the grid
+vector<int> tile_columns(int ncol, int n_tiles) {
+  vector<int> start(n_tiles + 1);
+  for (int i = 0; i <= n_tiles; i++) {
+    start[i] = static_cast<int>((static_cast<long long>(ncol - 1) * i) / n_tiles);
+  }
+  return start;
+}
+
+// columns that tile i of n_tiles, starting at the columns tile_start, shares with its
+// neighbors, in the tile's own column numbering
+vector<int> seam_columns(const vector<int> &tile_start, int i) {
+  int n_tiles = tile_start.size() - 1;
+  vector<int> columns;
+  if (i > 0) columns.push_back(0);
+  if (i < n_tiles - 1) columns.push_back(tile_start[i + 1] - tile_start[i]);
+  return columns;
+}
+
+// isoband engine that splits the grid into column tiles, contours each tile on its own
+// thread, and then stitches the polygons back together along the tile seams; for grids
+// stored column-major, every tile is a contiguous block of z values. Only the rings that
+// touch a seam go through this engine's polygon grid; every tile collects the rings that
+// lie entirely within it, on its own thread, and the paths are then interleaved.
+class isobander_tiled : public isobander {
+protected:
+  vector<unique_ptr<isobander> > tiles;
+  vector<int> tile_start;
+  vector<vector<int> > seam_entries; // per tile, its entries on the seams
+  int n_threads;
+
+public:
+  isobander_tiled(double *x, int lenx, double *y, int leny, const grid_values &z, int nrow, int ncol, int n_threads = 0, double value_low = 0, double value_high = 0) :
+    isobander(x, lenx, y, leny, z, nrow, ncol, value_low, value_high),
+    n_threads(thread_count(n_threads, ncol - 1))
+  {
+    tile_start = tile_columns(ncol, this->n_threads);
+    for (int i = 0; i < this->n_threads; i++) {
+      int c0 = tile_start[i], tile_ncol = tile_start[i+1] - c0 + 1;
+      tiles.push_back(unique_ptr<isobander>(
+        new isobander(x + c0, tile_ncol, y, leny, grid_z.window(0, c0), nrow, tile_ncol)
+      ));
+    }
+  }
+
+  virtual void pool_stats(size_t &pooled, size_t &chunks) const {
+    isobander::pool_stats(pooled, chunks);
+    for (size_t i = 0; i < tiles.size(); i++) {
+      tiles[i]->pool_stats(pooled, chunks);
+    }
+  }
+
+  virtual void calculate_contour() {
+    reset_grid();
+
+    seam_entries.resize(n_threads);
+    atomic<int> next_tile(0);
+    run_threads(n_threads, [&]() {
+      for (int i = next_tile++; i < n_threads; i = next_tile++) {
+        tiles[i]->set_value(vlo, vhi);
+        tiles[i]->calculate_contour();
+        tiles[i]->column_entries(seam_columns(tile_start, i), seam_entries[i]);
+      }
+    });
+
+    for (int i = 0; i < n_threads; i++) {
+      merge_seam_rings(*tiles[i], tile_start[i], seam_entries[i]);
+    }
+  }
+
+  virtual void collect_paths() {
+    isobander::collect_paths();
+
+    atomic<int> next_tile(0);
+    run_threads(n_threads, [&]() {
+      for (int i = next_tile++; i < n_threads; i = next_tile++) {
+        tiles[i]->collect_paths();
+      }
+    });
+
+    interleave_paths(tiles, tile_start);
+  }
+};
+
+// isoline engine that contours column tiles on separate threads and joins the lines
+// along the tile seams
+class isoliner_tiled : public isoliner {
+protected:
+  vector<unique_ptr<isoliner> > tiles;
+  vector<int> tile_start;
+  vector<vector<int> > seam_entries; // per tile, its entries on the seams
+  int n_threads;
+
+public:
+  isoliner_tiled(double *x, int lenx, double *y, int leny, const grid_values &z, int nrow, int ncol, int n_threads = 0, double value = 0) :
+    isoliner(x, lenx, y, leny, z, nrow, ncol, value),
+    n_threads(thread_count(n_threads, ncol - 1))
+  {
+    tile_start = tile_columns(ncol, this->n_threads);
+    for (int i = 0; i < this->n_threads; i++) {
+      int c0 = tile_start[i], tile_ncol = tile_start[i+1] - c0 + 1;
+      tiles.push_back(unique_ptr<isoliner>(
+        new isoliner(x + c0, tile_ncol, y, leny, grid_z.window(0, c0), nrow, tile_ncol)
+      ));
+    }
+  }
+
+  virtual void pool_stats(size_t &pooled, size_t &chunks) const {
+    isoliner::pool_stats(pooled, chunks);
+    for (size_t i = 0; i < tiles.size(); i++) {
+      tiles[i]->pool_stats(pooled, chunks);
+    }
+  }
+
+  virtual void calculate_contour() {
+    reset_grid();
+
+    seam_entries.resize(n_threads);
+    atomic<int> next_tile(0);
+    run_threads(n_threads, [&]() {
+      for (int i = next_tile++; i < n_threads; i = next_tile++) {
+        tiles[i]->set_value(vlo);
+        tiles[i]->calculate_contour();
+        tiles[i]->column_entries(seam_columns(tile_start, i), seam_entries[i]);
+      }
+    });
+
+    for (int i = 0; i < n_threads; i++) {
+      merge_seam_lines(*tiles[i], tile_start[i], seam_entries[i]);
+    }
+  }
+
+  virtual void collect_paths() {
+    isoliner::collect_paths();
+
+    atomic<int> next_tile(0);
+    run_threads(n_threads, [&]() {
+      for (int i = next_tile++; i < n_threads; i = next_tile++) {
+        tiles[i]->collect_paths();
+      }
+    });
+
+    interleave_paths(tiles, tile_start);
+  }
+};
+
+// isobands and isolines of a grid of any value type, with the given pyramid if there is one
+resultStruct* grid_isobands(double *x, int lenx, double *y, int leny, const grid_values &z, int nrow, int ncol, double *values_low, double *values_high, int n_bands,
+                            shared_ptr<const minmax_pyramid> pyramid = shared_ptr<const minmax_pyramid>()) {
+
+  isobander ib(x, lenx, y, leny, z, nrow, ncol, 0.0, 0.0);
+  ib.set_pyramid(pyramid);
+  ib.set_ranks(make_ranks(z, nrow, ncol, band_cutoffs(values_low, values_high, n_bands), n_bands));
+
+  resultStruct* returnstructs = new resultStruct[n_bands];
+
+  for (int i = 0; i < n_bands; ++i) {
+    ib.set_value(values_low[i], values_high[i]);
+    ib.calculate_contour();
+
+    resultStruct result = ib.collect();
+
+    returnstructs[i] = result;
+  }
+
+  return returnstructs;
+}
+
+resultStruct* grid_isolines(double *x, int lenx, double *y, int leny, const grid_values &z, int nrow, int ncol, double *values, int n_values,
+                            shared_ptr<const minmax_pyramid> pyramid = shared_ptr<const minmax_pyramid>()) {
+
+  isoliner il(x, lenx, y, leny, z, nrow, ncol);
+  il.set_pyramid(pyramid);
+  il.set_ranks(make_ranks(z, nrow, ncol, vector<double>(values, values + n_values), n_values));
+
+  resultStruct* returnstructs = new resultStruct[n_values];
+
+  for (int i = 0; i < n_values; ++i) {
+    il.set_value(values[i]);
+    il.calculate_contour();
+
+    resultStruct result = il.collect();
+
+    returnstructs[i] = result;
+  }
+
+  return returnstructs;
+}
+
+// message of the last error of an entry point that reports errors through its return
+// value instead of throwing, per thread
+static thread_local string last_error;
+
+// the result of f, or fail if f throws, keeping the message for isoband_last_error(); for
+// entry points whose errors must not cross the C boundary
+template<typename T, typename F>
+T catch_errors(F f, T fail) {
+  try {
+    return f();
+  } catch (const std::exception &e) {
+    last_error = e.what();
+  } catch (...) {
+    last_error = "Unknown error.";
+  }
+  return fail;
+}
+
+// the message of the last error reported by an entry point on this thread; valid until
+// the next error on the thread
+extern "C" const char* isoband_last_error() {
+  return last_error.c_str();
+}
+
+// the grid values of the typed entry points; z_type is a value_type, and strides of 1, 0
+// stand for column-major storage without gaps
+grid_values typed_grid(const void *z, int z_type, double z_offset, double z_scale, long long row_stride = 1, long long col_stride = 0) {
+  if (z_type < value_double || z_type > value_int32) {throw std::invalid_argument("Unknown type of grid values.");}
+
+  grid_values values(z, static_cast<value_type>(z_type), z_offset, z_scale, row_stride, col_stride);
+  if (!values.floating() && !(isfinite(z_offset) && isfinite(z_scale) && z_scale > 0)) {
+    throw std::invalid_argument("Integer grid values need a finite offset and a finite, positive scale.");
+  }
+  return values;
+}
+
+extern "C" resultStruct* isobands_impl(double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values_low, double *values_high, int n_bands) {
+  return grid_isobands(x, lenx, y, leny, z, nrow, ncol, values_low, values_high, n_bands);
+}
+
+extern "C" resultStruct* isolines_impl(double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values, int n_values) {
+  return grid_isolines(x, lenx, y, leny, z, nrow, ncol, values, n_values);
+}
+
+// like isobands_impl and isolines_impl, for grids of other value types without converting
+// them to double first: z_type is 0 for double, 1 for float, 2 for 16-bit and 3 for 32-bit
+// integers, and an integer z stands for the value z_offset + z_scale * z (use 0 and 1 for
+// plain integers); offset and scale are ignored for floating point values. Return null on
+// errors (see isoband_last_error()).
+extern "C" resultStruct* isobands_typed_impl(double *x, int lenx, double *y, int leny, const void *z, int z_type, double z_offset, double z_scale, int nrow, int ncol, double *values_low, double *values_high, int n_bands) {
+  return catch_errors([&]() {
+    return grid_isobands(x, lenx, y, leny, typed_grid(z, z_type, z_offset, z_scale), nrow, ncol, values_low, values_high, n_bands);
+  }, static_cast<resultStruct*>(0));
+}
+
+extern "C" resultStruct* isolines_typed_impl(double *x, int lenx, double *y, int leny, const void *z, int z_type, double z_offset, double z_scale, int nrow, int ncol, double *values, int n_values) {
+  return catch_errors([&]() {
+    return grid_isolines(x, lenx, y, leny, typed_grid(z, z_type, z_offset, z_scale), nrow, ncol, values, n_values);
+  }, static_cast<resultStruct*>(0));
+}
+
+// like isobands_typed_impl and isolines_typed_impl, for grids whose grid point r, c is
+// stored at z[r * row_stride + c * col_stride], with strides counted in values: a row-major
+// nrow x ncol array has row_stride = ncol and col_stride = 1, and a window into a larger
+// array passes its first value as z and keeps the strides of the larger array. Negative
+// strides flip the grid. Return null on errors, like isobands_typed_impl.
+extern "C" resultStruct* isobands_strided_impl(double *x, int lenx, double *y, int leny, const void *z, int z_type, double z_offset, double z_scale, long long row_stride, long long col_stride, int nrow, int ncol, double *values_low, double *values_high, int n_bands) {
+  return catch_errors([&]() {
+    if (row_stride == 0 || col_stride == 0) {throw std::invalid_argument("Grid strides must not be zero.");}
+    return grid_isobands(x, lenx, y, leny, typed_grid(z, z_type, z_offset, z_scale, row_stride, col_stride), nrow, ncol, values_low, values_high, n_bands);
+  }, static_cast<resultStruct*>(0));
+}
+
+extern "C" resultStruct* isolines_strided_impl(double *x, int lenx, double *y, int leny, const void *z, int z_type, double z_offset, double z_scale, long long row_stride, long long col_stride, int nrow, int ncol, double *values, int n_values) {
+  return catch_errors([&]() {
+    if (row_stride == 0 || col_stride == 0) {throw std::invalid_argument("Grid strides must not be zero.");}
+    return grid_isolines(x, lenx, y, leny, typed_grid(z, z_type, z_offset, z_scale, row_stride, col_stride), nrow, ncol, values, n_values);
+  }, static_cast<resultStruct*>(0));
+}
+
+// like isobands_impl, but delivers the bands in the ring-offset layout; the rings of every
+// band are grouped into polygons if polygons is non-zero
+extern "C" ringResultStruct* isobands_rings_impl(double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values_low, double *values_high, int n_bands, int polygons) {
+
+  isobander ib(x, lenx, y, leny, z, nrow, ncol, 0.0, 0.0);
+  ib.set_ranks(make_ranks(z, nrow, ncol, band_cutoffs(values_low, values_high, n_bands), n_bands));
+
+  ringResultStruct* returnstructs = new ringResultStruct[n_bands];
+  vector<double> xs, ys;
+  vector<int> ids;
+
+  for (int i = 0; i < n_bands; ++i) {
+    ib.set_value(values_low[i], values_high[i]);
+    ib.calculate_contour();
+    ib.collect_paths();
+    ib.swap_paths(xs, ys, ids);
+
+    returnstructs[i] = make_ring_result(xs, ys, ids, polygons != 0);
+  }
+
+  return returnstructs;
+}
+
+// like isolines_impl, but delivers the lines in the ring-offset layout, one ring per line
+extern "C" ringResultStruct* isolines_rings_impl(double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values, int n_values) {
+
+  isoliner il(x, lenx, y, leny, z, nrow, ncol);
+  il.set_ranks(make_ranks(z, nrow, ncol, vector<double>(values, values + n_values), n_values));
+
+  ringResultStruct* returnstructs = new ringResultStruct[n_values];
+  vector<double> xs, ys;
+  vector<int> ids;
+
+  for (int i = 0; i < n_values; ++i) {
+    il.set_value(values[i]);
+    il.calculate_contour();
+    il.collect_paths();
+    il.swap_paths(xs, ys, ids);
+
+    returnstructs[i] = make_ring_result(xs, ys, ids, false);
+  }
+
+  return returnstructs;
+}
+
+// like isobands_impl, but evaluates the bands concurrently on n_threads threads
+// (n_threads <= 0: one per core); every thread works with its own isobander, and all
+// of them share one min/max pyramid and the level ranks
+extern "C" resultStruct* isobands_impl_parallel(double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values_low, double *values_high, int n_bands, int n_threads) {
+
+  resultStruct* returnstructs = new resultStruct[n_bands];
+  atomic<int> next_band(0);
+  shared_ptr<const minmax_pyramid> pyramid = make_shared<minmax_pyramid>(z, nrow, ncol);
+  shared_ptr<const level_ranks> ranks = make_ranks(z, nrow, ncol, band_cutoffs(values_low, values_high, n_bands), n_bands);
+
+  run_threads(thread_count(n_threads, n_bands), [&]() {
+    isobander ib(x, lenx, y, leny, z, nrow, ncol, 0.0, 0.0);
+    ib.set_pyramid(pyramid);
+    ib.set_ranks(ranks);
+
+    for (int i = next_band++; i < n_bands; i = next_band++) {
+      ib.set_value(values_low[i], values_high[i]);
+      ib.calculate_contour();
+
+      returnstructs[i] = ib.collect();
+    }
+  });
+
+  return returnstructs;
+}
+
+// like isolines_impl, but evaluates the levels concurrently on n_threads threads
+// (n_threads <= 0: one per core); every thread works with its own isoliner, and all
+// of them share one min/max pyramid and the level ranks
+extern "C" resultStruct* isolines_impl_parallel(double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values, int n_values, int n_threads) {
+
+  resultStruct* returnstructs = new resultStruct[n_values];
+  atomic<int> next_value(0);
+  shared_ptr<const minmax_pyramid> pyramid = make_shared<minmax_pyramid>(z, nrow, ncol);
+  shared_ptr<const level_ranks> ranks = make_ranks(z, nrow, ncol, vector<double>(values, values + n_values), n_values);
+
+  run_threads(thread_count(n_threads, n_values), [&]() {
+    isoliner il(x, lenx, y, leny, z, nrow, ncol);
+    il.set_pyramid(pyramid);
+    il.set_ranks(ranks);
+
+    for (int i = next_value++; i < n_values; i = next_value++) {
+      il.set_value(values[i]);
+      il.calculate_contour();
+
+      returnstructs[i] = il.collect();
+    }
+  });
+
+  return returnstructs;
+}
+
+// like isobands_impl, but each band is contoured in column tiles on n_threads threads
+// (n_threads <= 0: one per core); useful for few levels on large grids
+extern "C" resultStruct* isobands_impl_tiled(double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values_low, double *values_high, int n_bands, int n_threads) {
+
+  isobander_tiled ib(x, lenx, y, leny, z, nrow, ncol, n_threads);
+
+  resultStruct* returnstructs = new resultStruct[n_bands];
+
+  for (int i = 0; i < n_bands; ++i) {
+    ib.set_value(values_low[i], values_high[i]);
+    ib.calculate_contour();
+
+    resultStruct result = ib.collect();
+
+    returnstructs[i] = result;
+  }
+
+  return returnstructs;
+}
+
+// like isolines_impl, but each level is contoured in column tiles on n_threads threads
+// (n_threads <= 0: one per core)
+extern "C" resultStruct* isolines_impl_tiled(double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values, int n_values, int n_threads) {
+
+  isoliner_tiled il(x, lenx, y, leny, z, nrow, ncol, n_threads);
+
+  resultStruct* returnstructs = new resultStruct[n_values];
+
+  for (int i = 0; i < n_values; ++i) {
+    il.set_value(values[i]);
+    il.calculate_contour();
+
+    resultStruct result = il.collect();
+
+    returnstructs[i] = result;
+  }
+
+  return returnstructs;
+}
+
+extern "C" resultStruct* isobands_sweep_impl(double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values_low, double *values_high, int n_bands) {
+
+  isobander_sweep ib(x, lenx, y, leny, z, nrow, ncol, 0.0, 0.0);
+
+  resultStruct* returnstructs = new resultStruct[n_bands];
+
+  for (int i = 0; i < n_bands; ++i) {
+    ib.set_value(values_low[i], values_high[i]);
+    ib.calculate_contour();
+
+    resultStruct result = ib.collect();
 
-      grid_point start = it->first;
-      grid_point cur = start;
-      grid_point prev = (it->second).prev;
-      // if this point has an alternative and it hasn't been collected yet then we start there
-      if ((it->second).altpoint && !(it->second).collected2) prev = (it->second).prev2;
+    returnstructs[i] = result;
+  }
 
-      int i = 0;
-      do {
-        point p = calc_point_coords(cur);
-        x_out.push_back(p.x);
-        y_out.push_back(p.y);
-        id.push_back(cur_id);
+  return returnstructs;
+}
 
-        // record that we have processed this point and proceed to next
-        if (polygon_grid[cur].altpoint && polygon_grid[cur].prev2 == prev) {
-          // if an alternative point exists and its previous point in the polygon
-          // corresponds to the recorded previous point, then that's the point
-          // we're working with here
+extern "C" resultStruct* isolines_sweep_impl(double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values, int n_values) {
 
-          // mark current point as collected and advance
-          polygon_grid[cur].collected2 = true;
-          grid_point newcur = polygon_grid[cur].next2;
-          prev = cur;
-          cur = newcur;
-        } else {
-          // mark current point as collected and advance
-          polygon_grid[cur].collected = true;
-          grid_point newcur = polygon_grid[cur].next;
-          prev = cur;
-          cur = newcur;
-        }
-        i++;
-        // if (i % 100000 == 0 && checkInterrupt()) {
-        //   interrupted = true;
-        //   return R_NilValue;
-        // }
-      } while (!(cur == start)); // keep going until we reach the start point again
-    }
-    // // output variable
-    // SEXP res = PROTECT(Rf_allocVector(VECSXP, 3));
-    // SEXP names = PROTECT(Rf_allocVector(STRSXP, 3));
-    // SET_STRING_ELT(names, 0, Rf_mkChar("x"));
-    // SET_STRING_ELT(names, 1, Rf_mkChar("y"));
-    // SET_STRING_ELT(names, 2, Rf_mkChar("id"));
-    // Rf_setAttrib(res, Rf_install("names"), names);
+  isoliner_sweep il(x, lenx, y, leny, z, nrow, ncol);
 
-    // int final_size = x_out.size();
-    // SEXP x_final = SET_VECTOR_ELT(res, 0, Rf_allocVector(REALSXP, final_size));
-    // double* x_final_p = REAL(x_final);
-    // SEXP y_final = SET_VECTOR_ELT(res, 1, Rf_allocVector(REALSXP, final_size));
-    // double* y_final_p = REAL(y_final);
-    // SEXP id_final = SET_VECTOR_ELT(res, 2, Rf_allocVector(INTSXP, final_size));
-    // int* id_final_p = INTEGER(id_final);
+  resultStruct* returnstructs = new resultStruct[n_values];
 
-    // for (int i = 0; i < final_size; ++i) {
-    //   x_final_p[i] = x_out[i];
-    //   y_final_p[i] = y_out[i];
-    //   id_final_p[i] = id[i];
-    // }
+  for (int i = 0; i < n_values; ++i) {
+    il.set_value(values[i]);
+    il.calculate_contour();
 
-    // UNPROTECT(2);
+    resultStruct result = il.collect();
 
-    int len = x_out.size();
+    returnstructs[i] = result;
+  }
 
-    double* xs = new double[len];
-    double* ys = new double[len];
-    int* ids = new int[len];
+  return returnstructs;
+}
 
-    copy(x_out.begin(), x_out.end(), xs);
-    copy(y_out.begin(), y_out.end(), ys);
-    copy(id.begin(), id.end(), ids);
+// releases an array of n results returned by isobands_impl, isolines_impl or any of
+// their variants, including the coordinate arrays of every result
+extern "C" void isoband_free_results(resultStruct *results, int n) {
+  if (!results) return;
+  for (int i = 0; i < n; i++) {
+    delete[] results[i].x;
+    delete[] results[i].y;
+    delete[] results[i].id;
+  }
+  delete[] results;
+}
 
-    return resultStruct{xs, ys, ids, len};
+// releases an array of n results returned by isobands_rings_impl or isolines_rings_impl
+extern "C" void isoband_free_ring_results(ringResultStruct *results, int n) {
+  if (!results) return;
+  for (int i = 0; i < n; i++) {
+    delete[] results[i].x;
+    delete[] results[i].y;
+    delete[] results[i].ring_offsets;
+    delete[] results[i].polygon_offsets;
   }
+  delete[] results;
+}
+
+// paths of one contour, as collected by an engine
+struct contour_paths {
+  vector<double> x, y;
+  vector<int> id;
 };
 
+// reusable state for callers that contour many grids of the same size, e.g. a service
+// working on fixed-size model grids: one isoband and one isoline engine with their vertex
+// stores and scratch buffers, and the min/max pyramid and level ranks of the current grid,
+// which are rebuilt in place on every call. Once everything has grown to its working size,
+// a call on a grid of the same size allocates nothing but its results.
+struct isoband_context {
+  unique_ptr<isobander> bander;
+  unique_ptr<isoliner> liner;
+  shared_ptr<minmax_pyramid> pyramid;
+  shared_ptr<level_ranks> ranks;
+  vector<double> cutoffs;
+  // paths of the levels of the last two-phase call; entries beyond n_paths only keep
+  // their memory for later calls
+  vector<contour_paths> paths;
+  int n_paths;
+  // whether pyramid was built by isoband_context_keep_index() and is used as it is until
+  // isoband_context_release_index()
+  bool index_kept;
+
+  isoband_context() : n_paths(0), index_kept(false) {}
+};
 
-class isoliner : public isobander {
-protected:
+// hands the pyramid and level ranks of grid z to engine, rebuilding those of ctx unless
+// ctx keeps an index; ctx->cutoffs holds the cutoffs of the n_levels levels
+void context_prepare(isoband_context *ctx, isobander &engine, double *z, int nrow, int ncol, int n_levels) {
+  if (ctx->index_kept) {
+    if (ctx->pyramid->rows() != nrow || ctx->pyramid->columns() != ncol) {
+      throw std::invalid_argument("Grid dimensions differ from those of the index kept in the context.");
+    }
+  } else if (ctx->pyramid) {
+    ctx->pyramid->build(z, nrow, ncol);
+  } else {
+    ctx->pyramid = make_shared<minmax_pyramid>(z, nrow, ncol);
+  }
+  engine.set_pyramid(ctx->pyramid);
 
-  void line_start(int r, int c, point_type type) { // start a new line segment
-    tmp_poly[0].r = r;
-    tmp_poly[0].c = c;
-    tmp_poly[0].type = type;
+  if (use_ranks(ctx->cutoffs, n_levels)) {
+    if (ctx->ranks) {
+      ctx->ranks->build(z, nrow, ncol, ctx->cutoffs);
+    } else {
+      ctx->ranks = make_shared<level_ranks>(z, nrow, ncol, ctx->cutoffs);
+    }
+    engine.set_ranks(ctx->ranks);
+  }
+}
 
-    tmp_poly_size = 1;
+// the isoband engine of ctx, set up for the grid and the cutoffs of the bands
+isobander& context_bander(isoband_context *ctx, double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values_low, double *values_high, int n_bands) {
+  if (ctx->bander) {
+    ctx->bander->set_grid(x, lenx, y, leny, z, nrow, ncol);
+  } else {
+    ctx->bander.reset(new isobander(x, lenx, y, leny, z, nrow, ncol));
   }
 
-  void line_add(int r, int c, point_type type) { // add point to line
-    tmp_poly[tmp_poly_size].r = r;
-    tmp_poly[tmp_poly_size].c = c;
-    tmp_poly[tmp_poly_size].type = type;
+  ctx->cutoffs.assign(values_low, values_low + n_bands);
+  ctx->cutoffs.insert(ctx->cutoffs.end(), values_high, values_high + n_bands);
+  context_prepare(ctx, *ctx->bander, z, nrow, ncol, n_bands);
+  return *ctx->bander;
+}
 
-    tmp_poly_size++;
+// the isoline engine of ctx, set up for the grid and the values of the isolines
+isoliner& context_liner(isoband_context *ctx, double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values, int n_values) {
+  if (ctx->liner) {
+    ctx->liner->set_grid(x, lenx, y, leny, z, nrow, ncol);
+  } else {
+    ctx->liner.reset(new isoliner(x, lenx, y, leny, z, nrow, ncol));
   }
 
-  void line_merge() { // merge current elementary polygon to prior polygons
-    //cout << "merging points: " << tmp_poly[0] << " " << tmp_poly[1] << endl;
+  ctx->cutoffs.assign(values, values + n_values);
+  context_prepare(ctx, *ctx->liner, z, nrow, ncol, n_values);
+  return *ctx->liner;
+}
 
-    int score = 2*polygon_grid.count(tmp_poly[1]) + polygon_grid.count(tmp_poly[0]);
+// moves the paths just collected by engine into slot i of ctx and returns their length
+int context_keep_paths(isoband_context *ctx, isobander &engine, int i) {
+  contour_paths &p = ctx->paths[i];
+  engine.swap_paths(p.x, p.y, p.id);
+  return p.x.size();
+}
 
-    switch(score) {
-    case 0: // completely unconnected line segment
-      polygon_grid[tmp_poly[0]].next = tmp_poly[1];
-      polygon_grid[tmp_poly[1]].prev = tmp_poly[0];
-      break;
-    case 1: // only first point connects
-      if (polygon_grid[tmp_poly[0]].next == grid_point()) {
-        polygon_grid[tmp_poly[0]].next = tmp_poly[1];
-        polygon_grid[tmp_poly[1]].prev = tmp_poly[0];
-      } else if (polygon_grid[tmp_poly[0]].prev == grid_point()) {
-        polygon_grid[tmp_poly[0]].prev = tmp_poly[1];
-        polygon_grid[tmp_poly[1]].next = tmp_poly[0];
-      } else {
-        // should never go here
-        throw std::runtime_error("cannot merge line segment at interior of existing line segment");
-      }
-      break;
-    case 2: // only second point connects
-      if (polygon_grid[tmp_poly[1]].next == grid_point()) {
-        polygon_grid[tmp_poly[1]].next = tmp_poly[0];
-        polygon_grid[tmp_poly[0]].prev = tmp_poly[1];
-      } else if (polygon_grid[tmp_poly[1]].prev == grid_point()) {
-        polygon_grid[tmp_poly[1]].prev = tmp_poly[0];
-        polygon_grid[tmp_poly[0]].next = tmp_poly[1];
-      } else {
-        // should never go here
-        throw std::runtime_error("cannot merge line segment at interior of existing line segment");
-      }
-      break;
-    case 3: // two-way merge
-      //cout << "two-way merge not implemented" << endl;
-      //break; // two-way merge doesn't work yet
-      {
-        int score2 =
-          8*(polygon_grid[tmp_poly[0]].next == grid_point()) +
-          4*(polygon_grid[tmp_poly[0]].prev == grid_point()) +
-          2*(polygon_grid[tmp_poly[1]].next == grid_point()) +
-          (polygon_grid[tmp_poly[1]].prev == grid_point());
-
-        switch(score2) {
-        case 9: // 1001
-          polygon_grid[tmp_poly[0]].next = tmp_poly[1];
-          polygon_grid[tmp_poly[1]].prev = tmp_poly[0];
-          break;
-        case 6: // 0110
-          polygon_grid[tmp_poly[0]].prev = tmp_poly[1];
-          polygon_grid[tmp_poly[1]].next = tmp_poly[0];
-          break;
-        case 10: // 1010
-          {
-            polygon_grid[tmp_poly[0]].next = tmp_poly[1];
-            polygon_grid[tmp_poly[1]].next = tmp_poly[0];
-
-            // need to reverse connections
-            grid_point cur = tmp_poly[1];
-            int i = 0;
-            do {
-              grid_point tmp = polygon_grid[cur].prev;
-              polygon_grid[cur].prev = polygon_grid[cur].next;
-              polygon_grid[cur].next = tmp;
-              cur = tmp;
-              i++;
-              // if (i % 100000 == 0 && checkInterrupt()) {
-              //   interrupted = true;
-              //   return;
-              // }
-            } while (!(cur == grid_point()));
-          }
-          break;
-        case 5: // 0101
-          {
-            polygon_grid[tmp_poly[0]].prev = tmp_poly[1];
-            polygon_grid[tmp_poly[1]].prev = tmp_poly[0];
-
-            // need to reverse connections
-            grid_point cur = tmp_poly[0];
-            int i = 0;
-            do {
-              grid_point tmp = polygon_grid[cur].next;
-              polygon_grid[cur].next = polygon_grid[cur].prev;
-              polygon_grid[cur].prev = tmp;
-              cur = tmp;
-              i++;
-              // if (i % 100000 == 0 && checkInterrupt()) {
-              //   interrupted = true;
-              //   return;
-              // }
-            } while (!(cur == grid_point()));
-          }
-          break;
-        default:  // should never go here
-          throw std::runtime_error("cannot merge line segment at interior of existing line segment");
-        }
-      }
-    break;
-    default:
-      throw std::runtime_error("unknown merge state");
+// makes room for the paths of n levels in ctx
+void context_reserve_paths(isoband_context *ctx, int n) {
+  if (static_cast<int>(ctx->paths.size()) < n) ctx->paths.resize(n);
+  ctx->n_paths = n;
+}
+
+extern "C" isoband_context* isoband_context_create() {
+  return catch_errors([&]() {
+    return new isoband_context();
+  }, static_cast<isoband_context*>(0));
+}
+
+extern "C" void isoband_context_destroy(isoband_context *ctx) {
+  delete ctx;
+}
+
+// builds the min/max index of the grid z and keeps it in ctx, so that the later calls on
+// ctx use it instead of rebuilding it for every grid; those calls must pass a grid of the
+// same dimensions, and the caller must not change the values of z until the index is
+// released with isoband_context_release_index(). Returns 0, or -1 on errors (see
+// isoband_last_error()), after which ctx keeps no index.
+extern "C" int isoband_context_keep_index(isoband_context *ctx, double *z, int nrow, int ncol) {
+  ctx->index_kept = false;
+  return catch_errors([&]() {
+    if (ctx->pyramid) {
+      ctx->pyramid->build(z, nrow, ncol);
+    } else {
+      ctx->pyramid = make_shared<minmax_pyramid>(z, nrow, ncol);
     }
+    ctx->index_kept = true;
+    return 0;
+  }, -1);
+}
 
-    //cout << "new grid:" << endl;
-    //print_polygons_state();
-  }
+// makes the later calls on ctx build the index of every grid again
+extern "C" void isoband_context_release_index(isoband_context *ctx) {
+  ctx->index_kept = false;
+}
 
-public:
-  isoliner(double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double value = 0) :
-    isobander(x, lenx, y, leny, z, nrow, ncol, value, 0) {}
+// like isobands_impl, but works with the engine and buffers kept in ctx; returns null on
+// errors (see isoband_last_error())
+extern "C" resultStruct* isoband_context_isobands(isoband_context *ctx, double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values_low, double *values_high, int n_bands) {
+  return catch_errors([&]() {
+    isobander &ib = context_bander(ctx, x, lenx, y, leny, z, nrow, ncol, values_low, values_high, n_bands);
 
-  void set_value(double value) {
-    vlo = value;
-  }
+    resultStruct* returnstructs = new resultStruct[n_bands];
 
-  virtual void calculate_contour() {
-    // clear polygon grid and associated internal variables
-    reset_grid();
+    for (int i = 0; i < n_bands; ++i) {
+      ib.set_value(values_low[i], values_high[i]);
+      ib.calculate_contour();
 
-    // setup matrix of binarized cell representations
-    vector<int> binarized(nrow*ncol);
-    vector<int>::iterator iv = binarized.begin();
-    for (int i = 0; i < nrow * ncol; ++i) {
-      *iv = (grid_z_p[i] >= vlo);
-      iv++;
+      returnstructs[i] = ib.collect();
     }
 
-    vector<int> cells((nrow - 1) * (ncol - 1));
-
-    for (int r = 0; r < nrow-1; r++) {
-      for (int c = 0; c < ncol-1; c++) {
-        int index;
-        if (!isfinite(grid_z_p[r + c * nrow]) || !isfinite(grid_z_p[r + (c + 1) * nrow]) ||
-            !isfinite(grid_z_p[r + 1 + c * nrow]) || !isfinite(grid_z_p[r + 1 + (c + 1) * nrow])) {
-          // we don't draw any contours if at least one of the corners is NA
-          index = 0;
-        } else {
-          index = 8*binarized[r + c * nrow] + 4*binarized[r + (c + 1) * nrow] + 2*binarized[r + 1 + (c + 1) * nrow] + 1*binarized[r + 1 + c * nrow];
-        }
+    return returnstructs;
+  }, static_cast<resultStruct*>(0));
+}
 
-        // two-segment saddles
-        if (index == 5 && (central_value(r, c) < vlo)) {
-          index = 10;
-        } else if (index == 10 && (central_value(r, c) < vlo)) {
-          index = 5;
-        }
+// like isolines_impl, but works with the engine and buffers kept in ctx; returns null on
+// errors (see isoband_last_error())
+extern "C" resultStruct* isoband_context_isolines(isoband_context *ctx, double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values, int n_values) {
+  return catch_errors([&]() {
+    isoliner &il = context_liner(ctx, x, lenx, y, leny, z, nrow, ncol, values, n_values);
 
-        cells[r + c * (nrow - 1)] = index;
-      }
-    }
+    resultStruct* returnstructs = new resultStruct[n_values];
 
-    // if (checkInterrupt()) {
-    //   interrupted = true;
-    //   return;
-    // }
+    for (int i = 0; i < n_values; ++i) {
+      il.set_value(values[i]);
+      il.calculate_contour();
 
-    for (int r = 0; r < nrow-1; r++) {
-      for (int c = 0; c < ncol-1; c++) {
-        switch(cells[r + c * (nrow - 1)]) {
-        case 0: break;
-        case 1:
-          line_start(r, c, vintersect_lo);
-          line_add(r+1, c, hintersect_lo);
-          line_merge();
-          break;
-        case 2:
-          line_start(r, c+1, vintersect_lo);
-          line_add(r+1, c, hintersect_lo);
-          line_merge();
-          break;
-        case 3:
-          line_start(r, c, vintersect_lo);
-          line_add(r, c+1, vintersect_lo);
-          line_merge();
-          break;
-        case 4:
-          line_start(r, c, hintersect_lo);
-          line_add(r, c+1, vintersect_lo);
-          line_merge();
-          break;
-        case 5:
-          // like case 2
-          line_start(r, c+1, vintersect_lo);
-          line_add(r+1, c, hintersect_lo);
-          line_merge();
-          // like case 7
-          line_start(r, c, hintersect_lo);
-          line_add(r, c, vintersect_lo);
-          line_merge();
-          break;
-        case 6:
-          line_start(r, c, hintersect_lo);
-          line_add(r+1, c, hintersect_lo);
-          line_merge();
-          break;
-        case 7:
-          line_start(r, c, hintersect_lo);
-          line_add(r, c, vintersect_lo);
-          line_merge();
-          break;
-        case 8:
-          line_start(r, c, hintersect_lo);
-          line_add(r, c, vintersect_lo);
-          line_merge();
-          break;
-        case 9:
-          line_start(r, c, hintersect_lo);
-          line_add(r+1, c, hintersect_lo);
-          line_merge();
-          break;
-        case 10:
-          // like case 1
-          line_start(r, c, vintersect_lo);
-          line_add(r+1, c, hintersect_lo);
-          line_merge();
-          // like case 4
-          line_start(r, c, hintersect_lo);
-          line_add(r, c+1, vintersect_lo);
-          line_merge();
-          break;
-        case 11:
-          line_start(r, c, hintersect_lo);
-          line_add(r, c+1, vintersect_lo);
-          line_merge();
-          break;
-        case 12:
-          line_start(r, c, vintersect_lo);
-          line_add(r, c+1, vintersect_lo);
-          line_merge();
-          break;
-        case 13:
-          line_start(r, c+1, vintersect_lo);
-          line_add(r+1, c, hintersect_lo);
-          line_merge();
-          break;
-        case 14:
-          line_start(r, c, vintersect_lo);
-          line_add(r+1, c, hintersect_lo);
-          line_merge();
-          break;
-        default: break; // catch everything, just in case
-        }
-      }
+      returnstructs[i] = il.collect();
     }
-  }
 
-  virtual resultStruct collect() {
-    // // Early exit if calculate_contour was interrupted
-    // if (was_interrupted()) {
-    //   return R_NilValue;
-    // }
+    return returnstructs;
+  }, static_cast<resultStruct*>(0));
+}
 
-    // make line segments
-    vector<double> x_out, y_out; vector<int> id;  // vectors holding resulting polygon paths
-    int cur_id = 0;           // id counter for individual line segments
+// Two-phase variants for callers that want the results in memory they own: the first
+// phase contours all levels, keeps their paths in ctx and stores the number of points of
+// level i in lengths[i]; the caller then allocates buffers of those sizes and has
+// isoband_context_fetch() fill them, so the final coordinates are written into caller
+// memory exactly once. The paths stay in ctx until the next call on it. Both return 0, or
+// -1 on errors (see isoband_last_error()), after which ctx holds no paths.
+extern "C" int isoband_context_isobands_sizes(isoband_context *ctx, double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values_low, double *values_high, int n_bands, int *lengths) {
+  int status = catch_errors([&]() {
+    isobander &ib = context_bander(ctx, x, lenx, y, leny, z, nrow, ncol, values_low, values_high, n_bands);
+    context_reserve_paths(ctx, n_bands);
+
+    for (int i = 0; i < n_bands; ++i) {
+      ib.set_value(values_low[i], values_high[i]);
+      ib.calculate_contour();
+      ib.collect_paths();
+
+      lengths[i] = context_keep_paths(ctx, ib, i);
+    }
+    return 0;
+  }, -1);
+  if (status != 0) ctx->n_paths = 0;
+  return status;
+}
 
-    // iterate over all locations in the polygon grid
-    for (auto it = polygon_grid.begin(); it != polygon_grid.end(); it++) {
-      //cout << it->first << " " << (it->second).collected << endl;
-      if ((it->second).collected) {
-        continue; // skip any grid points that are already collected
-      }
+extern "C" int isoband_context_isolines_sizes(isoband_context *ctx, double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values, int n_values, int *lengths) {
+  int status = catch_errors([&]() {
+    isoliner &il = context_liner(ctx, x, lenx, y, leny, z, nrow, ncol, values, n_values);
+    context_reserve_paths(ctx, n_values);
 
-      // we have found a new polygon line; process it
-      cur_id++;
+    for (int i = 0; i < n_values; ++i) {
+      il.set_value(values[i]);
+      il.calculate_contour();
+      il.collect_paths();
 
-      grid_point start = it->first;
-      grid_point cur = start;
+      lengths[i] = context_keep_paths(ctx, il, i);
+    }
+    return 0;
+  }, -1);
+  if (status != 0) ctx->n_paths = 0;
+  return status;
+}
 
-      int i = 0;
-      if (!(polygon_grid[cur].prev == grid_point())) {
-        // back-track until we find the beginning of the line or circle around once
-        do {
-          cur = polygon_grid[cur].prev;
-          i++;
-          // if (i % 100000 == 0 && checkInterrupt()) {
-          //   interrupted = true;
-          //   return R_NilValue;
-          // }
-        } while (!(cur == start || polygon_grid[cur].prev == grid_point()));
-      }
+// copies the paths of level i of the last two-phase call on ctx into x, y, id, which must
+// have room for the lengths[i] points reported by that call; returns 0, or -1 on errors
+// (see isoband_last_error())
+extern "C" int isoband_context_fetch(isoband_context *ctx, int i, double *x, double *y, int *id) {
+  return catch_errors([&]() {
+    if (i < 0 || i >= ctx->n_paths) {throw std::invalid_argument("No paths for this level; call isoband_context_isobands_sizes or isoband_context_isolines_sizes first.");}
+
+    const contour_paths &p = ctx->paths[i];
+    copy(p.x.begin(), p.x.end(), x);
+    copy(p.y.begin(), p.y.end(), y);
+    copy(p.id.begin(), p.id.end(), id);
+    return 0;
+  }, -1);
+}
 
-      start = cur; // reset starting point
-      i = 0;
-      do {
-        //cout << cur << endl;
-        point p = calc_point_coords(cur);
+// node allocation counters of the engines of ctx (see isobander::pool_stats): the number
+// of hash map nodes served from node pools instead of the heap, and the number of chunks
+// allocated for the pools
+extern "C" void isoband_context_pool_stats(isoband_context *ctx, long long *pooled, long long *chunks) {
+  size_t p = 0, c = 0;
+  if (ctx->bander) ctx->bander->pool_stats(p, c);
+  if (ctx->liner) ctx->liner->pool_stats(p, c);
+  *pooled = p;
+  *chunks = c;
+}
 
-        x_out.push_back(p.x);
-        y_out.push_back(p.y);
-        id.push_back(cur_id);
+// a grid in a memory-mapped file, with the min/max pyramid built on opening; the pyramid
+// takes one sequential pass over the file, after which every contour reads only the
+// blocks of the grid that it crosses
+struct isoband_grid_file {
+  unique_ptr<mapped_grid> file;
+  grid_values z;
+  shared_ptr<const minmax_pyramid> pyramid;
+
+  explicit isoband_grid_file(mapped_grid *f) : file(f) {
+    int nrow = file->rows(), ncol = file->columns();
+    z = typed_grid(file->data(), file->type(), 0, 1, file->is_row_major() ? ncol : 1, file->is_row_major() ? 1 : nrow);
+
+    file->advise_sequential(true);
+    pyramid = make_shared<minmax_pyramid>(z, nrow, ncol);
+    file->advise_sequential(false);
+  }
 
-        // record that we have processed this point and proceed to next
-        polygon_grid[cur].collected = true;
-        cur = polygon_grid[cur].next;
-        i++;
-        // if (i % 100000 == 0 && checkInterrupt()) {
-        //   interrupted = true;
-        //   return R_NilValue;
-        // }
-      } while (!(cur == start || cur == grid_point())); // keep going until we reach the start point again
-      // if we're back to start, need to output that point one more time
-      if (cur == start) {
-        point p = calc_point_coords(cur);
-        x_out.push_back(p.x);
-        y_out.push_back(p.y);
-        id.push_back(cur_id);
-      }
+  void check_coordinates(int lenx, int leny) const {
+    if (lenx != file->columns() || leny != file->rows()) {
+      throw std::invalid_argument("Number of x and y coordinates must match the columns and rows of the grid file.");
     }
-    // // output variable
-    // SEXP res = PROTECT(Rf_allocVector(VECSXP, 3));
-    // SEXP names = PROTECT(Rf_allocVector(STRSXP, 3));
-    // SET_STRING_ELT(names, 0, Rf_mkChar("x"));
-    // SET_STRING_ELT(names, 1, Rf_mkChar("y"));
-    // SET_STRING_ELT(names, 2, Rf_mkChar("id"));
-    // Rf_setAttrib(res, Rf_install("names"), names);
+  }
+};
 
-    // int final_size = x_out.size();
-    // SEXP x_final = SET_VECTOR_ELT(res, 0, Rf_allocVector(REALSXP, final_size));
-    // double* x_final_p = REAL(x_final);
-    // SEXP y_final = SET_VECTOR_ELT(res, 1, Rf_allocVector(REALSXP, final_size));
-    // double* y_final_p = REAL(y_final);
-    // SEXP id_final = SET_VECTOR_ELT(res, 2, Rf_allocVector(INTSXP, final_size));
-    // int* id_final_p = INTEGER(id_final);
+// opens a .npy file holding a two-dimensional float64, float32, int16 or int32 array in
+// the byte order of the machine, C or Fortran order; its rows are the grid rows. Returns
+// null if the file can't be opened or read (see isoband_last_error()).
+extern "C" isoband_grid_file* isoband_grid_open_npy(const char *path) {
+  return catch_errors([&]() {
+    return new isoband_grid_file(mapped_grid::open_npy(path));
+  }, static_cast<isoband_grid_file*>(0));
+}
 
-    // for (int i = 0; i < final_size; ++i) {
-    //   x_final_p[i] = x_out[i];
-    //   y_final_p[i] = y_out[i];
-    //   id_final_p[i] = id[i];
-    // }
+// opens a raw binary file with nrow x ncol values of type z_type (as for
+// isobands_typed_impl) starting at byte offset, row-major if row_major is non-zero and
+// column-major otherwise; returns null on errors, like isoband_grid_open_npy()
+extern "C" isoband_grid_file* isoband_grid_open_raw(const char *path, long long offset, int z_type, int nrow, int ncol, int row_major) {
+  return catch_errors([&]() {
+    return new isoband_grid_file(mapped_grid::open_raw(path, offset, z_type, nrow, ncol, row_major != 0));
+  }, static_cast<isoband_grid_file*>(0));
+}
 
-    int len = x_out.size();
+extern "C" void isoband_grid_size(isoband_grid_file *grid, int *nrow, int *ncol) {
+  *nrow = grid->file->rows();
+  *ncol = grid->file->columns();
+}
 
-    double* xs = new double[len];
-    double* ys = new double[len];
-    int* ids = new int[len];
+// like isobands_impl and isolines_impl, for a grid file; x and y must have one coordinate
+// per grid column and row. Return null on errors (see isoband_last_error()).
+extern "C" resultStruct* isoband_grid_isobands(isoband_grid_file *grid, double *x, int lenx, double *y, int leny, double *values_low, double *values_high, int n_bands) {
+  return catch_errors([&]() {
+    grid->check_coordinates(lenx, leny);
+    return grid_isobands(x, lenx, y, leny, grid->z, leny, lenx, values_low, values_high, n_bands, grid->pyramid);
+  }, static_cast<resultStruct*>(0));
+}
 
-    copy(x_out.begin(), x_out.end(), xs);
-    copy(y_out.begin(), y_out.end(), ys);
-    copy(id.begin(), id.end(), ids);
+extern "C" resultStruct* isoband_grid_isolines(isoband_grid_file *grid, double *x, int lenx, double *y, int leny, double *values, int n_values) {
+  return catch_errors([&]() {
+    grid->check_coordinates(lenx, leny);
+    return grid_isolines(x, lenx, y, leny, grid->z, leny, lenx, values, n_values, grid->pyramid);
+  }, static_cast<resultStruct*>(0));
+}
 
-    return resultStruct{xs, ys, ids, len};
-  }
-};
+// unmaps and closes a grid file
+extern "C" void isoband_grid_close(isoband_grid_file *grid) {
+  delete grid;
+}
 
+// a grid contoured in strips of rows, for grids too large to hold in memory: the caller
+// pushes the strips in order, every strip starting with the last row of the previous one,
+// and takes the rings that have closed after each push. Every band has its own sweep
+// engine, which carries the open boundary from one strip to the next, so memory scales
+// with the number of columns and the size of the rings still open, not with the number
+// of rows.
+struct isoband_stream {
+  vector<double> x, y;
+  grid_values z; // value type of the strips
+  int n_bands;
+  vector<unique_ptr<isobander_sweep> > bands;
+  int next_row; // first grid row of the next strip
+  bool finished;
+  bool failed; // whether a push went over the budget or threw while contouring
+  size_t memory_budget; // bytes; 0 for no limit
+
+  isoband_stream(double *x_in, int lenx, double *y_in, int leny, const grid_values &z_in, double *values_low, double *values_high, int n_bands, size_t memory_budget) :
+    x(x_in, x_in + lenx), y(y_in, y_in + leny), z(z_in), n_bands(n_bands), next_row(0), finished(false), failed(false), memory_budget(memory_budget)
+  {
+    for (int i = 0; i < n_bands; i++) {
+      bands.push_back(unique_ptr<isobander_sweep>(
+        new isobander_sweep(x.data(), lenx, y.data(), leny, z, leny, lenx, values_low[i], values_high[i])
+      ));
+      bands[i]->begin_sweep();
+    }
+    if (leny == 0) finish();
+  }
 
-extern "C" resultStruct* isobands_impl(double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values_low, double *values_high, int n_bands) {
+  int rows() const {return static_cast<int>(y.size());}
 
-  isobander ib(x, lenx, y, leny, z, nrow, ncol, 0.0, 0.0);
+  size_t working_memory() const {
+    size_t bytes = (x.capacity() + y.capacity()) * sizeof(double);
+    for (int i = 0; i < n_bands; i++) {
+      bytes += bands[i]->working_memory();
+    }
+    return bytes;
+  }
 
-  resultStruct* returnstructs = new resultStruct[n_bands];
+  // throws if the next strip can't have n_rows rows or the given strides
+  void check_strip(int n_rows, ptrdiff_t row_stride, ptrdiff_t col_stride) const {
+    if (failed) {throw std::invalid_argument("The stream has failed and takes no more strips.");}
+    if (finished) {throw std::invalid_argument("All rows of the grid have already been pushed.");}
+    if (n_rows < 1 || next_row + n_rows > rows()) {throw std::invalid_argument("Strip doesn't fit into the remaining rows of the grid.");}
+    if (row_stride == 0 || col_stride == 0) {throw std::invalid_argument("Grid strides must not be zero.");}
+  }
 
-  for (int i = 0; i < n_bands; ++i) {
-    ib.set_value(values_low[i], values_high[i]);
-    ib.calculate_contour();
+  // contours a strip that passed check_strip()
+  void push(const void *values, int n_rows, ptrdiff_t row_stride, ptrdiff_t col_stride) {
+    grid_values strip = z;
+    strip.data = values;
+    strip.row_stride = row_stride;
+    strip.col_stride = col_stride;
+    int r0 = next_row, r1 = next_row + n_rows - 1;
+    for (int i = 0; i < n_bands; i++) {
+      bands[i]->set_strip(strip, r0);
+      bands[i]->sweep_rows(r0, r1);
+    }
+    next_row = r1;
+    if (r1 == rows() - 1) finish();
 
-    resultStruct result = ib.collect();
+    if (memory_budget > 0 && working_memory() > memory_budget) {
+      throw std::runtime_error("Open contours exceed the memory budget of the stream.");
+    }
+  }
 
-    returnstructs[i] = result;
+  void finish() {
+    for (int i = 0; i < n_bands; i++) {
+      bands[i]->end_sweep();
+    }
+    finished = true;
   }
+};
 
-  return returnstructs;
+// starts contouring a grid with leny rows and lenx columns of type z_type (as for
+// isobands_typed_impl) into n_bands bands; memory_budget limits the working memory of the
+// stream in bytes, or is 0 for no limit. Returns null on errors (see isoband_last_error()).
+extern "C" isoband_stream* isoband_stream_create(double *x, int lenx, double *y, int leny, int z_type, double z_offset, double z_scale, double *values_low, double *values_high, int n_bands, long long memory_budget) {
+  return catch_errors([&]() {
+    if (memory_budget < 0) {throw std::invalid_argument("Memory budget must not be negative.");}
+    return new isoband_stream(x, lenx, y, leny, typed_grid(0, z_type, z_offset, z_scale), values_low, values_high, n_bands, static_cast<size_t>(memory_budget));
+  }, static_cast<isoband_stream*>(0));
 }
 
-extern "C" resultStruct* isolines_impl(double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values, int n_values) {
+// number of rows for the next strip such that the strip and the working memory of the
+// stream together stay within the budget, but at least 2; all remaining rows if the stream
+// has no budget; 0 once the stream has failed
+extern "C" int isoband_stream_strip_rows(isoband_stream *stream) {
+  if (stream->failed) return 0;
+  int remaining = stream->rows() - stream->next_row;
+  if (stream->memory_budget == 0) return remaining;
+
+  size_t used = stream->working_memory();
+  size_t row_bytes = max(static_cast<size_t>(1), stream->x.size() * stream->z.value_size());
+  size_t n = (used < stream->memory_budget) ? (stream->memory_budget - used) / row_bytes : 0;
+  return static_cast<int>(min(static_cast<size_t>(remaining), max(static_cast<size_t>(2), n)));
+}
 
-  isoliner il(x, lenx, y, leny, z, nrow, ncol);
+// contours the next strip of n_rows grid rows, with grid point r, c of the strip stored at
+// z[r * row_stride + c * col_stride]; the first strip starts at grid row 0, every later
+// one with the last row of the previous strip. Returns a stream_status: a strip that
+// doesn't fit is rejected and leaves the stream as it was; if the working memory of the
+// stream exceeds its budget afterwards, or contouring the strip fails, the stream fails,
+// and only the rings closed so far can still be taken from it. The message of an error is
+// in isoband_last_error().
+extern "C" int isoband_stream_push(isoband_stream *stream, const void *z, int n_rows, long long row_stride, long long col_stride) {
+  int status = catch_errors([&]() {
+    stream->check_strip(n_rows, row_stride, col_stride);
+    return static_cast<int>(stream_ok);
+  }, static_cast<int>(stream_rejected));
+  if (status != stream_ok) return stream->failed ? stream_failed : status;
+
+  status = catch_errors([&]() {
+    stream->push(z, n_rows, row_stride, col_stride);
+    return static_cast<int>(stream_ok);
+  }, static_cast<int>(stream_failed));
+  if (status != stream_ok) stream->failed = true;
+  return status;
+}
 
-  resultStruct* returnstructs = new resultStruct[n_values];
+// the rings of every band that have closed since the last call, as an array of n_bands
+// results to be released with isoband_free_results(); ring ids keep counting up across
+// calls, so the rings of all calls together are those of isobands_sweep_impl
+extern "C" resultStruct* isoband_stream_take(isoband_stream *stream) {
+  resultStruct* returnstructs = new resultStruct[stream->n_bands];
+  for (int i = 0; i < stream->n_bands; i++) {
+    returnstructs[i] = stream->bands[i]->take_rings();
+  }
+  return returnstructs;
+}
 
-  for (int i = 0; i < n_values; ++i) {
-    il.set_value(values[i]);
-    il.calculate_contour();
+// bytes of working memory held by the stream, not counting rings that haven't been taken
+extern "C" long long isoband_stream_memory(isoband_stream *stream) {
+  return static_cast<long long>(stream->working_memory());
+}
 
-    resultStruct result = il.collect();
+extern "C" void isoband_stream_destroy(isoband_stream *stream) {
+  delete stream;
+}
 
-    returnstructs[i] = result;
-  }
+// name of the SIMD instruction set used by the classification kernels on this CPU
+extern "C" const char* isoband_simd_level() {
+  return simd_level_name(best_simd_level());
+}
 
-  return returnstructs;
+// checks all SIMD classification kernels available on this CPU against the scalar ones;
+// returns the number of mismatches, i.e. 0 if everything is bit-identical
+extern "C" int isoband_kernel_selftest() {
+  return classify_selftest();
 }
@@ -0,0 +1,117 @@
+#ifndef ISOBAND_H
+#define ISOBAND_H
+
+// C interface of the contouring engines. Grids are passed as arrays of nrow x ncol values,
+// column-major like an R matrix unless an entry point takes strides, with lenx == ncol x
+// coordinates and leny == nrow y coordinates. Every entry point returning results returns
+// one per band or level, in arrays to be released with isoband_free_results() or
+// isoband_free_ring_results().
+
+// return type for extern C functions
+struct resultStruct {
+  double *x;
+  double *y;
+  int *id;
+  int len;
+};
+
+// return type for the ring-offset layout: ring k consists of the points ring_offsets[k] up
+// to ring_offsets[k + 1] - 1 of x and y, so ring_offsets has n_rings + 1 entries. If the
+// rings were grouped into polygons, polygon j consists of the rings polygon_offsets[j] up
+// to polygon_offsets[j + 1] - 1, its outer ring first; otherwise polygon_offsets is null.
+struct ringResultStruct {
+  double *x;
+  double *y;
+  int len;
+  int *ring_offsets;
+  int n_rings;
+  int *polygon_offsets;
+  int n_polygons;
+};
+
+// element types of the grid values z, passed as z_type
+enum value_type {
+  value_double,
+  value_float,
+  value_int16,
+  value_int32
+};
+
+// results of isoband_stream_push()
+enum stream_status {
+  stream_ok,       // the strip was contoured
+  stream_rejected, // the strip didn't fit; the stream is unchanged
+  stream_failed    // the stream went over its memory budget or failed while contouring
+};
+
+struct isoband_context;
+struct isoband_grid_file;
+struct isoband_stream;
+
+extern "C" {
+
+// plain, typed and strided grids; the typed and strided entry points report errors by
+// returning null, with the message in isoband_last_error()
+resultStruct* isobands_impl(double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values_low, double *values_high, int n_bands);
+resultStruct* isolines_impl(double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values, int n_values);
+resultStruct* isobands_typed_impl(double *x, int lenx, double *y, int leny, const void *z, int z_type, double z_offset, double z_scale, int nrow, int ncol, double *values_low, double *values_high, int n_bands);
+resultStruct* isolines_typed_impl(double *x, int lenx, double *y, int leny, const void *z, int z_type, double z_offset, double z_scale, int nrow, int ncol, double *values, int n_values);
+resultStruct* isobands_strided_impl(double *x, int lenx, double *y, int leny, const void *z, int z_type, double z_offset, double z_scale, long long row_stride, long long col_stride, int nrow, int ncol, double *values_low, double *values_high, int n_bands);
+resultStruct* isolines_strided_impl(double *x, int lenx, double *y, int leny, const void *z, int z_type, double z_offset, double z_scale, long long row_stride, long long col_stride, int nrow, int ncol, double *values, int n_values);
+
+// ring-offset layout
+ringResultStruct* isobands_rings_impl(double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values_low, double *values_high, int n_bands, int polygons);
+ringResultStruct* isolines_rings_impl(double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values, int n_values);
+
+// parallel, tiled and sweeping engines
+resultStruct* isobands_impl_parallel(double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values_low, double *values_high, int n_bands, int n_threads);
+resultStruct* isolines_impl_parallel(double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values, int n_values, int n_threads);
+resultStruct* isobands_impl_tiled(double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values_low, double *values_high, int n_bands, int n_threads);
+resultStruct* isolines_impl_tiled(double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values, int n_values, int n_threads);
+resultStruct* isobands_sweep_impl(double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values_low, double *values_high, int n_bands);
+resultStruct* isolines_sweep_impl(double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values, int n_values);
+
+void isoband_free_results(resultStruct *results, int n);
+void isoband_free_ring_results(ringResultStruct *results, int n);
+
+// the message of the last error reported by an entry point through its return value
+const char* isoband_last_error();
+
+// reusable contexts; the entry points that can fail report errors by returning null or
+// -1, with the message in isoband_last_error()
+isoband_context* isoband_context_create();
+void isoband_context_destroy(isoband_context *ctx);
+resultStruct* isoband_context_isobands(isoband_context *ctx, double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values_low, double *values_high, int n_bands);
+resultStruct* isoband_context_isolines(isoband_context *ctx, double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values, int n_values);
+int isoband_context_isobands_sizes(isoband_context *ctx, double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values_low, double *values_high, int n_bands, int *lengths);
+int isoband_context_isolines_sizes(isoband_context *ctx, double *x, int lenx, double *y, int leny, double *z, int nrow, int ncol, double *values, int n_values, int *lengths);
+int isoband_context_fetch(isoband_context *ctx, int i, double *x, double *y, int *id);
+void isoband_context_pool_stats(isoband_context *ctx, long long *pooled, long long *chunks);
+int isoband_context_keep_index(isoband_context *ctx, double *z, int nrow, int ncol);
+void isoband_context_release_index(isoband_context *ctx);
+
+// grids in memory-mapped files; these entry points report errors by returning null, with
+// the message in isoband_last_error()
+isoband_grid_file* isoband_grid_open_npy(const char *path);
+isoband_grid_file* isoband_grid_open_raw(const char *path, long long offset, int z_type, int nrow, int ncol, int row_major);
+void isoband_grid_size(isoband_grid_file *grid, int *nrow, int *ncol);
+resultStruct* isoband_grid_isobands(isoband_grid_file *grid, double *x, int lenx, double *y, int leny, double *values_low, double *values_high, int n_bands);
+resultStruct* isoband_grid_isolines(isoband_grid_file *grid, double *x, int lenx, double *y, int leny, double *values, int n_values);
+void isoband_grid_close(isoband_grid_file *grid);
+
+// grids streamed in strips of rows; errors are reported by returning null or a
+// stream_status, with the message in isoband_last_error()
+isoband_stream* isoband_stream_create(double *x, int lenx, double *y, int leny, int z_type, double z_offset, double z_scale, double *values_low, double *values_high, int n_bands, long long memory_budget);
+int isoband_stream_strip_rows(isoband_stream *stream);
+int isoband_stream_push(isoband_stream *stream, const void *z, int n_rows, long long row_stride, long long col_stride);
+resultStruct* isoband_stream_take(isoband_stream *stream);
+long long isoband_stream_memory(isoband_stream *stream);
+void isoband_stream_destroy(isoband_stream *stream);
+
+// classification kernels
+const char* isoband_simd_level();
+int isoband_kernel_selftest();
+
+}
+
+#endif // ISOBAND_H
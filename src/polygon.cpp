@@ -1,4 +1,5 @@
 #include <iostream>
+#include <algorithm>
 using namespace std;
 
 #include "polygon.h"
@@ -25,3 +26,34 @@ ostream & operator<<(ostream &out, const in_polygon_type &t) {
   }
   return out;
 }
+
+// one edge of the point-in-ring test, from point j to point i: returns true if p lies on
+// the edge, and otherwise flips in if a ray from p in positive x direction crosses it
+static inline bool on_edge_or_cross(const point &p, double xi, double yi, double xj, double yj, bool &in) {
+  if ((xi == p.x && yi == p.y) ||
+      ((p.x - xj) * (yi - yj) == (p.y - yj) * (xi - xj) &&
+       min(xi, xj) <= p.x && p.x <= max(xi, xj) && min(yi, yj) <= p.y && p.y <= max(yi, yj))) {
+    return true;
+  }
+  if ((yi > p.y) != (yj > p.y) && p.x < (xj - xi) * (p.y - yi) / (yj - yi) + xi) {
+    in = !in;
+  }
+  return false;
+}
+
+in_polygon_type point_in_ring(const point &p, const double *x, const double *y, int n) {
+  bool in = false;
+  for (int i = 0, j = n - 1; i < n; j = i++) {
+    if (on_edge_or_cross(p, x[i], y[i], x[j], y[j], in)) return undetermined;
+  }
+  return in ? inside : outside;
+}
+
+in_polygon_type point_in_ring(const point &p, const double *x, const double *y, int n, const int *edges, int n_edges) {
+  bool in = false;
+  for (int k = 0; k < n_edges; k++) {
+    int i = edges[k], j = (i == 0) ? n - 1 : i - 1;
+    if (on_edge_or_cross(p, x[i], y[i], x[j], y[j], in)) return undetermined;
+  }
+  return in ? inside : outside;
+}
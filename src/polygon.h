@@ -25,4 +25,13 @@ enum in_polygon_type {
   undetermined // point lies right on the boundary
 };
 
+// whether p lies inside, outside or on the boundary of the closed ring of the n points
+// (x[i], y[i]); the ring's last point connects back to its first
+in_polygon_type point_in_ring(const point &p, const double *x, const double *y, int n);
+
+// the same, looking only at the n_edges edges into the points i listed in edges (the edge
+// into point 0 comes from point n - 1); the result is that of the whole ring as long as
+// edges includes every edge whose y range contains p.y
+in_polygon_type point_in_ring(const point &p, const double *x, const double *y, int n, const int *edges, int n_edges);
+
 #endif // POLYGON_H
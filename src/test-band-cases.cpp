@@ -0,0 +1,962 @@
+#include <testthat.h>
+
+#include <vector>
+#include <cmath>
+#include <limits>
+using namespace std;
+
+#include "band_cases.h"
+
+// the elementary polygons of a cell as process_cell() computed them before the polygon
+// table, with the case switch of that version: the cell is at r = c = 0, every vertex is
+// recorded as its cell_vertex, and the central value of saddle cells is vc
+struct switch_band_cases {
+  double vlo, vhi, vc;
+  vector<vector<int> > polygons;
+  vector<int> tmp_poly;
+
+  switch_band_cases(double vlo, double vhi, double vc) : vlo(vlo), vhi(vhi), vc(vc) {}
+
+  double central_value(int, int) {
+    return vc;
+  }
+
+  void poly_start(int r, int c, point_type type) {
+    tmp_poly.clear();
+    poly_add(r, c, type);
+  }
+
+  void poly_add(int r, int c, point_type type) {
+    int v = 0;
+    while (cell_vertex_points[v].dr != r || cell_vertex_points[v].dc != c || cell_vertex_points[v].type != type) v++;
+    tmp_poly.push_back(v);
+  }
+
+  void poly_merge() {
+    polygons.push_back(tmp_poly);
+  }
+
+  void process_cell(int r, int c, int index) {
+    switch(index) {
+    // doing cases out of order, sorted by type, is easier to keep track of
+
+    // no contour
+    case 0: break;
+    case 80: break;
+
+    // single triangle
+    case 1: // 0001
+      poly_start(r, c, vintersect_lo);
+      poly_add(r+1, c, hintersect_lo);
+      poly_add(r+1, c, grid);
+      poly_merge();
+      break;
+    case 3: // 0010
+      poly_start(r, c+1, vintersect_lo);
+      poly_add(r+1, c+1, grid);
+      poly_add(r+1, c, hintersect_lo);
+      poly_merge();
+      break;
+    case 9: // 0100
+      poly_start(r, c, hintersect_lo);
+      poly_add(r, c+1, grid);
+      poly_add(r, c+1, vintersect_lo);
+      poly_merge();
+      break;
+    case 27: // 1000
+      poly_start(r, c, vintersect_lo);
+      poly_add(r, c, grid);
+      poly_add(r, c, hintersect_lo);
+      poly_merge();
+      break;
+    case 79: // 2221
+      poly_start(r, c, vintersect_hi);
+      poly_add(r+1, c, hintersect_hi);
+      poly_add(r+1, c, grid);
+      poly_merge();
+      break;
+    case 77: // 2212
+      poly_start(r, c+1, vintersect_hi);
+      poly_add(r+1, c+1, grid);
+      poly_add(r+1, c, hintersect_hi);
+      poly_merge();
+      break;
+    case 71: // 2122
+      poly_start(r, c, hintersect_hi);
+      poly_add(r, c+1, grid);
+      poly_add(r, c+1, vintersect_hi);
+      poly_merge();
+      break;
+    case 53: // 1222
+      poly_start(r, c, vintersect_hi);
+      poly_add(r, c, grid);
+      poly_add(r, c, hintersect_hi);
+      poly_merge();
+      break;
+
+      // single trapezoid
+    case 78: // 2220
+      poly_start(r, c, vintersect_hi);
+      poly_add(r+1, c, hintersect_hi);
+      poly_add(r+1, c, hintersect_lo);
+      poly_add(r, c, vintersect_lo);
+      poly_merge();
+      break;
+    case 74: // 2202
+      poly_start(r+1, c, hintersect_hi);
+      poly_add(r, c+1, vintersect_hi);
+      poly_add(r, c+1, vintersect_lo);
+      poly_add(r+1, c, hintersect_lo);
+      poly_merge();
+      break;
+    case 62: // 2022
+      poly_start(r, c+1, vintersect_hi);
+      poly_add(r, c, hintersect_hi);
+      poly_add(r, c, hintersect_lo);
+      poly_add(r, c+1, vintersect_lo);
+      poly_merge();
+      break;
+    case 26: // 0222
+      poly_start(r, c, hintersect_hi);
+      poly_add(r, c, vintersect_hi);
+      poly_add(r, c, vintersect_lo);
+      poly_add(r, c, hintersect_lo);
+      poly_merge();
+      break;
+    case 2: // 0002
+      poly_start(r, c, vintersect_lo);
+      poly_add(r+1, c, hintersect_lo);
+      poly_add(r+1, c, hintersect_hi);
+      poly_add(r, c, vintersect_hi);
+      poly_merge();
+      break;
+    case 6: // 0020
+      poly_start(r+1, c, hintersect_lo);
+      poly_add(r, c+1, vintersect_lo);
+      poly_add(r, c+1, vintersect_hi);
+      poly_add(r+1, c, hintersect_hi);
+      poly_merge();
+      break;
+    case 18: // 0200
+      poly_start(r, c+1, vintersect_lo);
+      poly_add(r, c, hintersect_lo);
+      poly_add(r, c, hintersect_hi);
+      poly_add(r, c+1, vintersect_hi);
+      poly_merge();
+      break;
+    case 54: // 2000
+      poly_start(r, c, hintersect_lo);
+      poly_add(r, c, vintersect_lo);
+      poly_add(r, c, vintersect_hi);
+      poly_add(r, c, hintersect_hi);
+      poly_merge();
+      break;
+
+      // single rectangle
+    case 4: // 0011
+      poly_start(r, c, vintersect_lo);
+      poly_add(r, c+1, vintersect_lo);
+      poly_add(r+1, c+1, grid);
+      poly_add(r+1, c, grid);
+      poly_merge();
+      break;
+    case 12: // 0110
+      poly_start(r, c, hintersect_lo);
+      poly_add(r, c+1, grid);
+      poly_add(r+1, c+1, grid);
+      poly_add(r+1, c, hintersect_lo);
+      poly_merge();
+      break;
+    case 36: // 1100
+      poly_start(r, c, grid);
+      poly_add(r, c+1, grid);
+      poly_add(r, c+1, vintersect_lo);
+      poly_add(r, c, vintersect_lo);
+      poly_merge();
+      break;
+    case 28: // 1001
+      poly_start(r, c, hintersect_lo);
+      poly_add(r+1, c, hintersect_lo);
+      poly_add(r+1, c, grid);
+      poly_add(r, c, grid);
+      poly_merge();
+      break;
+    case 76: // 2211
+      poly_start(r, c, vintersect_hi);
+      poly_add(r, c+1, vintersect_hi);
+      poly_add(r+1, c+1, grid);
+      poly_add(r+1, c, grid);
+      poly_merge();
+      break;
+    case 68: // 2112
+      poly_start(r, c, hintersect_hi);
+      poly_add(r, c+1, grid);
+      poly_add(r+1, c+1, grid);
+      poly_add(r+1, c, hintersect_hi);
+      poly_merge();
+      break;
+    case 44: // 1122
+      poly_start(r, c, grid);
+      poly_add(r, c+1, grid);
+      poly_add(r, c+1, vintersect_hi);
+      poly_add(r, c, vintersect_hi);
+      poly_merge();
+      break;
+    case 52: // 1221
+      poly_start(r, c, hintersect_hi);
+      poly_add(r+1, c, hintersect_hi);
+      poly_add(r+1, c, grid);
+      poly_add(r, c, grid);
+      poly_merge();
+      break;
+    case 72: // 2200
+      poly_start(r, c, vintersect_hi);
+      poly_add(r, c+1, vintersect_hi);
+      poly_add(r, c+1, vintersect_lo);
+      poly_add(r, c, vintersect_lo);
+      poly_merge();
+      break;
+    case 56: // 2002
+      poly_start(r, c, hintersect_hi);
+      poly_add(r, c, hintersect_lo);
+      poly_add(r+1, c, hintersect_lo);
+      poly_add(r+1, c, hintersect_hi);
+      poly_merge();
+      break;
+    case 8: // 0022
+      poly_start(r, c, vintersect_lo);
+      poly_add(r, c+1, vintersect_lo);
+      poly_add(r, c+1, vintersect_hi);
+      poly_add(r, c, vintersect_hi);
+      poly_merge();
+      break;
+    case 24: // 0220
+      poly_start(r, c, hintersect_lo);
+      poly_add(r, c, hintersect_hi);
+      poly_add(r+1, c, hintersect_hi);
+      poly_add(r+1, c, hintersect_lo);
+      poly_merge();
+      break;
+
+    // single square
+    case 40: // 1111
+      poly_start(r, c, grid);
+      poly_add(r, c+1, grid);
+      poly_add(r+1, c+1, grid);
+      poly_add(r+1, c, grid);
+      poly_merge();
+      break;
+
+    // single pentagon
+    case 49: // 1211
+      poly_start(r, c, grid);
+      poly_add(r, c, hintersect_hi);
+      poly_add(r, c+1, vintersect_hi);
+      poly_add(r+1, c+1, grid);
+      poly_add(r+1, c, grid);
+      poly_merge();
+      break;
+    case 67: // 2111
+      poly_start(r+1, c, grid);
+      poly_add(r, c, vintersect_hi);
+      poly_add(r, c, hintersect_hi);
+      poly_add(r, c+1, grid);
+      poly_add(r+1, c+1, grid);
+      poly_merge();
+      break;
+    case 41: // 1112
+      poly_start(r, c, grid);
+      poly_add(r, c+1, grid);
+      poly_add(r+1, c+1, grid);
+      poly_add(r+1, c, hintersect_hi);
+      poly_add(r, c, vintersect_hi);
+      poly_merge();
+      break;
+    case 43: // 1121
+      poly_start(r, c, grid);
+      poly_add(r, c+1, grid);
+      poly_add(r, c+1, vintersect_hi);
+      poly_add(r+1, c, hintersect_hi);
+      poly_add(r+1, c, grid);
+      poly_merge();
+      break;
+    case 31: // 1011
+      poly_start(r, c, grid);
+      poly_add(r, c, hintersect_lo);
+      poly_add(r, c+1, vintersect_lo);
+      poly_add(r+1, c+1, grid);
+      poly_add(r+1, c, grid);
+      poly_merge();
+      break;
+    case 13: // 0111
+      poly_start(r+1, c, grid);
+      poly_add(r, c, vintersect_lo);
+      poly_add(r, c, hintersect_lo);
+      poly_add(r, c+1, grid);
+      poly_add(r+1, c+1, grid);
+      poly_merge();
+      break;
+    case 39: // 1110
+      poly_start(r, c, grid);
+      poly_add(r, c+1, grid);
+      poly_add(r+1, c+1, grid);
+      poly_add(r+1, c, hintersect_lo);
+      poly_add(r, c, vintersect_lo);
+      poly_merge();
+      break;
+    case 37: // 1101
+      poly_start(r, c, grid);
+      poly_add(r, c+1, grid);
+      poly_add(r, c+1, vintersect_lo);
+      poly_add(r+1, c, hintersect_lo);
+      poly_add(r+1, c, grid);
+      poly_merge();
+      break;
+    case 45: // 1200
+      poly_start(r, c, grid);
+      poly_add(r, c, hintersect_hi);
+      poly_add(r, c+1, vintersect_hi);
+      poly_add(r, c+1, vintersect_lo);
+      poly_add(r, c, vintersect_lo);
+      poly_merge();
+      break;
+    case 15: // 0120
+      poly_start(r, c+1, grid);
+      poly_add(r, c+1, vintersect_hi);
+      poly_add(r+1, c, hintersect_hi);
+      poly_add(r+1, c, hintersect_lo);
+      poly_add(r, c, hintersect_lo);
+      poly_merge();
+      break;
+    case 5: // 0012
+      poly_start(r, c, vintersect_lo);
+      poly_add(r, c+1, vintersect_lo);
+      poly_add(r+1, c+1, grid);
+      poly_add(r+1, c, hintersect_hi);
+      poly_add(r, c, vintersect_hi);
+      poly_merge();
+      break;
+    case 55: // 2001
+      poly_start(r+1, c, grid);
+      poly_add(r, c, vintersect_hi);
+      poly_add(r, c, hintersect_hi);
+      poly_add(r, c, hintersect_lo);
+      poly_add(r+1, c, hintersect_lo);
+      poly_merge();
+      break;
+    case 35: // 1022
+      poly_start(r, c, grid);
+      poly_add(r, c, hintersect_lo);
+      poly_add(r, c+1, vintersect_lo);
+      poly_add(r, c+1, vintersect_hi);
+      poly_add(r, c, vintersect_hi);
+      poly_merge();
+      break;
+    case 65: // 2102
+      poly_start(r, c+1, grid);
+      poly_add(r, c+1, vintersect_lo);
+      poly_add(r+1, c, hintersect_lo);
+      poly_add(r+1, c, hintersect_hi);
+      poly_add(r, c, hintersect_hi);
+      poly_merge();
+      break;
+    case 75: // 2210
+      poly_start(r, c, vintersect_hi);
+      poly_add(r, c+1, vintersect_hi);
+      poly_add(r+1, c+1, grid);
+      poly_add(r+1, c, hintersect_lo);
+      poly_add(r, c, vintersect_lo);
+      poly_merge();
+      break;
+    case 25: // 0221
+      poly_start(r+1, c, grid);
+      poly_add(r, c, vintersect_lo);
+      poly_add(r, c, hintersect_lo);
+      poly_add(r, c, hintersect_hi);
+      poly_add(r+1, c, hintersect_hi);
+      poly_merge();
+      break;
+    case 29: // 1002
+      poly_start(r, c, grid);
+      poly_add(r, c, hintersect_lo);
+      poly_add(r+1, c, hintersect_lo);
+      poly_add(r+1, c, hintersect_hi);
+      poly_add(r, c, vintersect_hi);
+      poly_merge();
+      break;
+    case 63: // 2100
+      poly_start(r, c+1, grid);
+      poly_add(r, c+1, vintersect_lo);
+      poly_add(r, c, vintersect_lo);
+      poly_add(r, c, vintersect_hi);
+      poly_add(r, c, hintersect_hi);
+      poly_merge();
+      break;
+    case 21: // 0210
+      poly_start(r+1, c+1, grid);
+      poly_add(r+1, c, hintersect_lo);
+      poly_add(r, c, hintersect_lo);
+      poly_add(r, c, hintersect_hi);
+      poly_add(r, c+1, vintersect_hi);
+      poly_merge();
+      break;
+    case 7: // 0021
+      poly_start(r+1, c, grid);
+      poly_add(r, c, vintersect_lo);
+      poly_add(r, c+1, vintersect_lo);
+      poly_add(r, c+1, vintersect_hi);
+      poly_add(r+1, c, hintersect_hi);
+      poly_merge();
+      break;
+    case 51: // 1220
+      poly_start(r, c, grid);
+      poly_add(r, c, hintersect_hi);
+      poly_add(r+1, c, hintersect_hi);
+      poly_add(r+1, c, hintersect_lo);
+      poly_add(r, c, vintersect_lo);
+      poly_merge();
+      break;
+    case 17: // 0122
+      poly_start(r, c+1, grid);
+      poly_add(r, c+1, vintersect_hi);
+      poly_add(r, c, vintersect_hi);
+      poly_add(r, c, vintersect_lo);
+      poly_add(r, c, hintersect_lo);
+      poly_merge();
+      break;
+    case 59: // 2012
+      poly_start(r+1, c+1, grid);
+      poly_add(r+1, c, hintersect_hi);
+      poly_add(r, c, hintersect_hi);
+      poly_add(r, c, hintersect_lo);
+      poly_add(r, c+1, vintersect_lo);
+      poly_merge();
+      break;
+    case 73: // 2201
+      poly_start(r+1, c, grid);
+      poly_add(r, c, vintersect_hi);
+      poly_add(r, c+1, vintersect_hi);
+      poly_add(r, c+1, vintersect_lo);
+      poly_add(r+1, c, hintersect_lo);
+      poly_merge();
+      break;
+
+      // single hexagon
+    case 22: // 0211
+      poly_start(r+1, c, grid);
+      poly_add(r, c, vintersect_lo);
+      poly_add(r, c, hintersect_lo);
+      poly_add(r, c, hintersect_hi);
+      poly_add(r, c+1, vintersect_hi);
+      poly_add(r+1, c+1, grid);
+      poly_merge();
+      break;
+    case 66: // 2110
+      poly_start(r, c+1, grid);
+      poly_add(r+1, c+1, grid);
+      poly_add(r+1, c, hintersect_lo);
+      poly_add(r, c, vintersect_lo);
+      poly_add(r, c, vintersect_hi);
+      poly_add(r, c, hintersect_hi);
+      poly_merge();
+      break;
+    case 38: // 1102
+      poly_start(r, c, grid);
+      poly_add(r, c+1, grid);
+      poly_add(r, c+1, vintersect_lo);
+      poly_add(r+1, c, hintersect_lo);
+      poly_add(r+1, c, hintersect_hi);
+      poly_add(r, c, vintersect_hi);
+      poly_merge();
+      break;
+    case 34: // 1021
+      poly_start(r, c, grid);
+      poly_add(r, c, hintersect_lo);
+      poly_add(r, c+1, vintersect_lo);
+      poly_add(r, c+1, vintersect_hi);
+      poly_add(r+1, c, hintersect_hi);
+      poly_add(r+1, c, grid);
+      poly_merge();
+      break;
+    case 58: // 2011
+      poly_start(r+1, c, grid);
+      poly_add(r, c, vintersect_hi);
+      poly_add(r, c, hintersect_hi);
+      poly_add(r, c, hintersect_lo);
+      poly_add(r, c+1, vintersect_lo);
+      poly_add(r+1, c+1, grid);
+      poly_merge();
+      break;
+    case 14: // 0112
+      poly_start(r, c+1, grid);
+      poly_add(r+1, c+1, grid);
+      poly_add(r+1, c, hintersect_hi);
+      poly_add(r, c, vintersect_hi);
+      poly_add(r, c, vintersect_lo);
+      poly_add(r, c, hintersect_lo);
+      poly_merge();
+      break;
+    case 42: // 1120
+      poly_start(r, c, grid);
+      poly_add(r, c+1, grid);
+      poly_add(r, c+1, vintersect_hi);
+      poly_add(r+1, c, hintersect_hi);
+      poly_add(r+1, c, hintersect_lo);
+      poly_add(r, c, vintersect_lo);
+      poly_merge();
+      break;
+    case 46: // 1201
+      poly_start(r, c, grid);
+      poly_add(r, c, hintersect_hi);
+      poly_add(r, c+1, vintersect_hi);
+      poly_add(r, c+1, vintersect_lo);
+      poly_add(r+1, c, hintersect_lo);
+      poly_add(r+1, c, grid);
+      poly_merge();
+      break;
+    case 64: // 2101
+      poly_start(r+1, c, grid);
+      poly_add(r, c, vintersect_hi);
+      poly_add(r, c, hintersect_hi);
+      poly_add(r, c+1, grid);
+      poly_add(r, c+1, vintersect_lo);
+      poly_add(r+1, c, hintersect_lo);
+      poly_merge();
+      break;
+    case 16: // 0121
+      poly_start(r, c+1, grid);
+      poly_add(r, c+1, vintersect_hi);
+      poly_add(r+1, c, hintersect_hi);
+      poly_add(r+1, c, grid);
+      poly_add(r, c, vintersect_lo);
+      poly_add(r, c, hintersect_lo);
+      poly_merge();
+      break;
+    case 32: // 1012
+      poly_start(r, c, grid);
+      poly_add(r, c, hintersect_lo);
+      poly_add(r, c+1, vintersect_lo);
+      poly_add(r+1, c+1, grid);
+      poly_add(r+1, c, hintersect_hi);
+      poly_add(r, c, vintersect_hi);
+      poly_merge();
+      break;
+    case 48: // 1210
+      poly_start(r, c, grid);
+      poly_add(r, c, hintersect_hi);
+      poly_add(r, c+1, vintersect_hi);
+      poly_add(r+1, c+1, grid);
+      poly_add(r+1, c, hintersect_lo);
+      poly_add(r, c, vintersect_lo);
+      poly_merge();
+      break;
+
+    // 6-sided saddle
+    case 10: // 0101
+      {
+        double vc = central_value(r, c);
+        if (vc < vlo) {
+          poly_start(r+1, c, grid);
+          poly_add(r, c, vintersect_lo);
+          poly_add(r+1, c, hintersect_lo);
+          poly_merge();
+          poly_start(r, c+1, grid);
+          poly_add(r, c+1, vintersect_lo);
+          poly_add(r, c, hintersect_lo);
+          poly_merge();
+        } else {
+          poly_start(r+1, c, grid);
+          poly_add(r, c, vintersect_lo);
+          poly_add(r, c, hintersect_lo);
+          poly_add(r, c+1, grid);
+          poly_add(r, c+1, vintersect_lo);
+          poly_add(r+1, c, hintersect_lo);
+          poly_merge();
+        }
+      }
+      break;
+    case 30: // 1010
+      {
+        double vc = central_value(r, c);
+        if (vc < vlo) {
+          poly_start(r, c, grid);
+          poly_add(r, c, hintersect_lo);
+          poly_add(r, c, vintersect_lo);
+          poly_merge();
+          poly_start(r+1, c+1, grid);
+          poly_add(r+1, c, hintersect_lo);
+          poly_add(r, c+1, vintersect_lo);
+          poly_merge();
+        } else {
+          poly_start(r, c, grid);
+          poly_add(r, c, hintersect_lo);
+          poly_add(r, c+1, vintersect_lo);
+          poly_add(r+1, c+1, grid);
+          poly_add(r+1, c, hintersect_lo);
+          poly_add(r, c, vintersect_lo);
+          poly_merge();
+        }
+      }
+      break;
+    case 70: // 2121
+      {
+        double vc = central_value(r, c);
+        if (vc >= vhi) {
+          poly_start(r+1, c, grid);
+          poly_add(r, c, vintersect_hi);
+          poly_add(r+1, c, hintersect_hi);
+          poly_merge();
+          poly_start(r, c+1, grid);
+          poly_add(r, c+1, vintersect_hi);
+          poly_add(r, c, hintersect_hi);
+          poly_merge();
+        } else {
+          poly_start(r+1, c, grid);
+          poly_add(r, c, vintersect_hi);
+          poly_add(r, c, hintersect_hi);
+          poly_add(r, c+1, grid);
+          poly_add(r, c+1, vintersect_hi);
+          poly_add(r+1, c, hintersect_hi);
+          poly_merge();
+        }
+      }
+      break;
+    case 50: // 1212
+      {
+        double vc = central_value(r, c);
+        if (vc >= vhi) {
+          poly_start(r, c, grid);
+          poly_add(r, c, hintersect_hi);
+          poly_add(r, c, vintersect_hi);
+          poly_merge();
+          poly_start(r+1, c+1, grid);
+          poly_add(r+1, c, hintersect_hi);
+          poly_add(r, c+1, vintersect_hi);
+          poly_merge();
+        } else {
+          poly_start(r, c, grid);
+          poly_add(r, c, hintersect_hi);
+          poly_add(r, c+1, vintersect_hi);
+          poly_add(r+1, c+1, grid);
+          poly_add(r+1, c, hintersect_hi);
+          poly_add(r, c, vintersect_hi);
+          poly_merge();
+        }
+      }
+      break;
+
+    // 7-sided saddle
+    case 69: // 2120
+      {
+        double vc = central_value(r, c);
+        if (vc >= vhi) {
+          poly_start(r, c+1, grid);
+          poly_add(r, c+1, vintersect_hi);
+          poly_add(r, c, hintersect_hi);
+          poly_merge();
+          poly_start(r, c, vintersect_hi);
+          poly_add(r+1, c, hintersect_hi);
+          poly_add(r+1, c, hintersect_lo);
+          poly_add(r, c, vintersect_lo);
+          poly_merge();
+        } else {
+          poly_start(r, c+1, grid);
+          poly_add(r, c+1, vintersect_hi);
+          poly_add(r+1, c, hintersect_hi);
+          poly_add(r+1, c, hintersect_lo);
+          poly_add(r, c, vintersect_lo);
+          poly_add(r, c, vintersect_hi);
+          poly_add(r, c, hintersect_hi);
+          poly_merge();
+        }
+      }
+      break;
+    case 61: // 2021
+      {
+        double vc = central_value(r, c);
+          if (vc >= vhi) {
+            poly_start(r+1, c, grid);
+            poly_add(r, c, vintersect_hi);
+            poly_add(r+1, c, hintersect_hi);
+            poly_merge();
+            poly_start(r, c+1, vintersect_hi);
+            poly_add(r, c, hintersect_hi);
+            poly_add(r, c, hintersect_lo);
+            poly_add(r, c+1, vintersect_lo);
+            poly_merge();
+          } else {
+            poly_start(r+1, c, grid);
+            poly_add(r, c, vintersect_hi);
+            poly_add(r, c, hintersect_hi);
+            poly_add(r, c, hintersect_lo);
+            poly_add(r, c+1, vintersect_lo);
+            poly_add(r, c+1, vintersect_hi);
+            poly_add(r+1, c, hintersect_hi);
+            poly_merge();
+          }
+        }
+      break;
+    case 47: // 1202
+      {
+        double vc = central_value(r, c);
+        if (vc >= vhi) {
+          poly_start(r, c, grid);
+          poly_add(r, c, hintersect_hi);
+          poly_add(r, c, vintersect_hi);
+          poly_merge();
+          poly_start(r+1, c, hintersect_hi);
+          poly_add(r, c+1, vintersect_hi);
+          poly_add(r, c+1, vintersect_lo);
+          poly_add(r+1, c, hintersect_lo);
+          poly_merge();
+        } else {
+          poly_start(r, c, grid);
+          poly_add(r, c, hintersect_hi);
+          poly_add(r, c+1, vintersect_hi);
+          poly_add(r, c+1, vintersect_lo);
+          poly_add(r+1, c, hintersect_lo);
+          poly_add(r+1, c, hintersect_hi);
+          poly_add(r, c, vintersect_hi);
+          poly_merge();
+        }
+      }
+      break;
+    case 23: // 0212
+      {
+        double vc = central_value(r, c);
+        if (vc >= vhi) {
+          poly_start(r+1, c+1, grid);
+          poly_add(r+1, c, hintersect_hi);
+          poly_add(r, c+1, vintersect_hi);
+          poly_merge();
+          poly_start(r, c, hintersect_hi);
+          poly_add(r, c, vintersect_hi);
+          poly_add(r, c, vintersect_lo);
+          poly_add(r, c, hintersect_lo);
+          poly_merge();
+        } else {
+          poly_start(r+1, c+1, grid);
+          poly_add(r+1, c, hintersect_hi);
+          poly_add(r, c, vintersect_hi);
+          poly_add(r, c, vintersect_lo);
+          poly_add(r, c, hintersect_lo);
+          poly_add(r, c, hintersect_hi);
+          poly_add(r, c+1, vintersect_hi);
+          poly_merge();
+        }
+      }
+      break;
+    case 11: // 0102
+      {
+        double vc = central_value(r, c);
+        if (vc < vlo) {
+          poly_start(r, c+1, grid);
+          poly_add(r, c+1, vintersect_lo);
+          poly_add(r, c, hintersect_lo);
+          poly_merge();
+          poly_start(r, c, vintersect_lo);
+          poly_add(r+1, c, hintersect_lo);
+          poly_add(r+1, c, hintersect_hi);
+          poly_add(r, c, vintersect_hi);
+          poly_merge();
+        } else {
+          poly_start(r, c+1, grid);
+          poly_add(r, c+1, vintersect_lo);
+          poly_add(r+1, c, hintersect_lo);
+          poly_add(r+1, c, hintersect_hi);
+          poly_add(r, c, vintersect_hi);
+          poly_add(r, c, vintersect_lo);
+          poly_add(r, c, hintersect_lo);
+          poly_merge();
+        }
+      }
+      break;
+    case 19: // 0201
+      {
+        double vc = central_value(r, c);
+        if (vc < vlo) {
+          poly_start(r+1, c, grid);
+          poly_add(r, c, vintersect_lo);
+          poly_add(r+1, c, hintersect_lo);
+          poly_merge();
+          poly_start(r, c+1, vintersect_lo);
+          poly_add(r, c, hintersect_lo);
+          poly_add(r, c, hintersect_hi);
+          poly_add(r, c+1, vintersect_hi);
+          poly_merge();
+        } else {
+          poly_start(r+1, c, grid);
+          poly_add(r, c, vintersect_lo);
+          poly_add(r, c, hintersect_lo);
+          poly_add(r, c, hintersect_hi);
+          poly_add(r, c+1, vintersect_hi);
+          poly_add(r, c+1, vintersect_lo);
+          poly_add(r+1, c, hintersect_lo);
+          poly_merge();
+        }
+      }
+      break;
+    case 33: // 1020
+      {
+        double vc = central_value(r, c);
+        if (vc < vlo) {
+          poly_start(r, c, grid);
+          poly_add(r, c, hintersect_lo);
+          poly_add(r, c, vintersect_lo);
+          poly_merge();
+          poly_start(r+1, c, hintersect_lo);
+          poly_add(r, c+1, vintersect_lo);
+          poly_add(r, c+1, vintersect_hi);
+          poly_add(r+1, c, hintersect_hi);
+          poly_merge();
+        } else {
+          poly_start(r, c, grid);
+          poly_add(r, c, hintersect_lo);
+          poly_add(r, c+1, vintersect_lo);
+          poly_add(r, c+1, vintersect_hi);
+          poly_add(r+1, c, hintersect_hi);
+          poly_add(r+1, c, hintersect_lo);
+          poly_add(r, c, vintersect_lo);
+          poly_merge();
+        }
+      }
+      break;
+    case 57: // 2010
+      {
+        double vc = central_value(r, c);
+        if (vc < vlo) {
+          poly_start(r+1, c+1, grid);
+          poly_add(r+1, c, hintersect_lo);
+          poly_add(r, c+1, vintersect_lo);
+          poly_merge();
+          poly_start(r, c, hintersect_lo);
+          poly_add(r, c, vintersect_lo);
+          poly_add(r, c, vintersect_hi);
+          poly_add(r, c, hintersect_hi);
+          poly_merge();
+        } else {
+          poly_start(r+1, c+1, grid);
+          poly_add(r+1, c, hintersect_lo);
+          poly_add(r, c, vintersect_lo);
+          poly_add(r, c, vintersect_hi);
+          poly_add(r, c, hintersect_hi);
+          poly_add(r, c, hintersect_lo);
+          poly_add(r, c+1, vintersect_lo);
+          poly_merge();
+        }
+      }
+      break;
+
+    // 8-sided saddle
+  case 60: // 2020
+    {
+      double vc = central_value(r, c);
+      if (vc < vlo) {
+        poly_start(r, c, vintersect_hi);
+        poly_add(r, c, hintersect_hi);
+        poly_add(r, c, hintersect_lo);
+        poly_add(r, c, vintersect_lo);
+        poly_merge();
+        poly_start(r, c+1, vintersect_hi);
+        poly_add(r+1, c, hintersect_hi);
+        poly_add(r+1, c, hintersect_lo);
+        poly_add(r, c+1, vintersect_lo);
+        poly_merge();
+      } else if (vc >= vhi) {
+        poly_start(r, c, vintersect_hi);
+        poly_add(r+1, c, hintersect_hi);
+        poly_add(r+1, c, hintersect_lo);
+        poly_add(r, c, vintersect_lo);
+        poly_merge();
+        poly_start(r, c+1, vintersect_hi);
+        poly_add(r, c, hintersect_hi);
+        poly_add(r, c, hintersect_lo);
+        poly_add(r, c+1, vintersect_lo);
+        poly_merge();
+      } else {
+        poly_start(r, c, vintersect_hi);
+        poly_add(r, c, hintersect_hi);
+        poly_add(r, c, hintersect_lo);
+        poly_add(r, c+1, vintersect_lo);
+        poly_add(r, c+1, vintersect_hi);
+        poly_add(r+1, c, hintersect_hi);
+        poly_add(r+1, c, hintersect_lo);
+        poly_add(r, c, vintersect_lo);
+        poly_merge();
+      }
+    }
+    break;
+    case 20: // 0202
+      {
+        double vc = central_value(r, c);
+        if (vc < vlo) {
+          poly_start(r, c, vintersect_lo);
+          poly_add(r+1, c, hintersect_lo);
+          poly_add(r+1, c, hintersect_hi);
+          poly_add(r, c, vintersect_hi);
+          poly_merge();
+          poly_start(r, c+1, vintersect_lo);
+          poly_add(r, c, hintersect_lo);
+          poly_add(r, c, hintersect_hi);
+          poly_add(r, c+1, vintersect_hi);
+          poly_merge();
+        } else if (vc >= vhi) {
+          poly_start(r, c, vintersect_lo);
+          poly_add(r, c, hintersect_lo);
+          poly_add(r, c, hintersect_hi);
+          poly_add(r, c, vintersect_hi);
+          poly_merge();
+          poly_start(r, c+1, vintersect_lo);
+          poly_add(r+1, c, hintersect_lo);
+          poly_add(r+1, c, hintersect_hi);
+          poly_add(r, c+1, vintersect_hi);
+          poly_merge();
+        } else {
+          poly_start(r, c, vintersect_lo);
+          poly_add(r, c, hintersect_lo);
+          poly_add(r, c, hintersect_hi);
+          poly_add(r, c+1, vintersect_hi);
+          poly_add(r, c+1, vintersect_lo);
+          poly_add(r+1, c, hintersect_lo);
+          poly_add(r+1, c, hintersect_hi);
+          poly_add(r, c, vintersect_hi);
+          poly_merge();
+        }
+      }
+      break;
+    }
+  }
+};
+
+// the elementary polygons of a cell according to band_cases
+vector<vector<int> > table_polygons(int index, double vlo, double vhi, double vc) {
+  const band_case &bc = band_cases[index];
+  const cell_polygons &cp = bc.variant[saddle_variant(bc.saddle, vc, vlo, vhi)];
+  const int sizes[] = {cp.first_size, cp.second_size};
+  const unsigned char *v = cp.vertex;
+
+  vector<vector<int> > polygons;
+  for (int k = 0; k < 2 && sizes[k] > 0; k++) {
+    polygons.push_back(vector<int>(v, v + sizes[k]));
+    v += sizes[k];
+  }
+  return polygons;
+}
+
+context("Isoband polygon table") {
+  test_that("the table matches the case switch it replaced") {
+    // central values below, on and between the cutoffs, above them, and NA
+    const double vlo = 1, vhi = 2;
+    const double central[] = {0, 1, 1.5, 2, 3, numeric_limits<double>::quiet_NaN()};
+
+    bool all_same = true;
+    for (int index = 0; index < 81; index++) {
+      for (int k = 0; k < 6; k++) {
+        switch_band_cases old_cases(vlo, vhi, central[k]);
+        old_cases.process_cell(0, 0, index);
+        if (old_cases.polygons != table_polygons(index, vlo, vhi, central[k])) all_same = false;
+      }
+    }
+    expect_true(all_same);
+  }
+}
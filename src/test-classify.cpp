@@ -0,0 +1,11 @@
+#include <testthat.h>
+
+#include "isoband.h"
+#include "classify.h"
+
+context("Classification kernels") {
+  test_that("the SIMD kernels match the scalar ones") {
+    expect_true(classify_selftest() == 0);
+    expect_true(isoband_kernel_selftest() == 0);
+  }
+}
@@ -0,0 +1,126 @@
+#include <testthat.h>
+
+#include <vector>
+#include <string>
+#include <cmath>
+using namespace std;
+
+#include "isoband.h"
+#include "test-results.h"
+
+context("Contouring contexts") {
+  test_that("a kept index is used until it is released") {
+    const int n = 120;
+    vector<double> x(n), y(n), z(n * n);
+    for (int i = 0; i < n; i++) {
+      x[i] = i;
+      y[i] = i;
+    }
+    for (int r = 0; r < n; r++) {
+      for (int c = 0; c < n; c++) {
+        z[r + c * n] = floor(4 * sin(r * 0.05) * cos(c * 0.07));
+      }
+    }
+    double lo[] = {-2, 0.5}, hi[] = {0, 3}, values[] = {-1.5, 0.5};
+
+    isoband_context *ctx = isoband_context_create();
+    expect_true(isoband_context_keep_index(ctx, &z[0], n, n) == 0);
+
+    resultStruct *bands = isobands_impl(&x[0], n, &y[0], n, &z[0], n, n, lo, hi, 2);
+    resultStruct *ctx_bands = isoband_context_isobands(ctx, &x[0], n, &y[0], n, &z[0], n, n, lo, hi, 2);
+    expect_true(same_results(bands, ctx_bands, 2));
+    resultStruct *lines = isolines_impl(&x[0], n, &y[0], n, &z[0], n, n, values, 2);
+    resultStruct *ctx_lines = isoband_context_isolines(ctx, &x[0], n, &y[0], n, &z[0], n, n, values, 2);
+    expect_true(same_results(lines, ctx_lines, 2));
+
+    // a grid of other dimensions doesn't fit the kept index
+    expect_true(isoband_context_isobands(ctx, &x[0], n - 1, &y[0], n, &z[0], n, n - 1, lo, hi, 2) == 0);
+    expect_true(string(isoband_last_error()).find("index kept in the context") != string::npos);
+
+    // once released, the index follows the values of the grid again
+    isoband_context_release_index(ctx);
+    for (size_t i = 0; i < z.size(); i++) z[i] = -z[i];
+    resultStruct *flipped = isobands_impl(&x[0], n, &y[0], n, &z[0], n, n, lo, hi, 2);
+    resultStruct *ctx_flipped = isoband_context_isobands(ctx, &x[0], n, &y[0], n, &z[0], n, n, lo, hi, 2);
+    expect_true(same_results(flipped, ctx_flipped, 2));
+    expect_false(same_results(bands, flipped, 2));
+
+    isoband_free_results(ctx_flipped, 2);
+    isoband_free_results(flipped, 2);
+    isoband_free_results(ctx_lines, 2);
+    isoband_free_results(lines, 2);
+    isoband_free_results(ctx_bands, 2);
+    isoband_free_results(bands, 2);
+    isoband_context_destroy(ctx);
+  }
+
+  test_that("contexts give the results of isobands_impl and isolines_impl") {
+    // grids of changing sizes, so that the context has to grow and shrink its buffers
+    test_grid grids[] = {test_grid(157, 131), test_grid(40, 90), test_grid(157, 131)};
+    double *lo = const_cast<double*>(test_lo), *hi = const_cast<double*>(test_hi);
+
+    isoband_context *ctx = isoband_context_create();
+    for (int k = 0; k < 3; k++) {
+      test_grid &g = grids[k];
+      resultStruct *bands = isobands_impl(&g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], g.nrow, g.ncol, lo, hi, test_n_bands);
+      resultStruct *ctx_bands = isoband_context_isobands(ctx, &g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], g.nrow, g.ncol, lo, hi, test_n_bands);
+      expect_true(same_results(bands, ctx_bands, test_n_bands));
+
+      resultStruct *lines = isolines_impl(&g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], g.nrow, g.ncol, lo, test_n_bands);
+      resultStruct *ctx_lines = isoband_context_isolines(ctx, &g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], g.nrow, g.ncol, lo, test_n_bands);
+      expect_true(same_results(lines, ctx_lines, test_n_bands));
+
+      isoband_free_results(ctx_lines, test_n_bands);
+      isoband_free_results(lines, test_n_bands);
+      isoband_free_results(ctx_bands, test_n_bands);
+      isoband_free_results(bands, test_n_bands);
+    }
+    isoband_context_destroy(ctx);
+  }
+
+  test_that("two-phase calls fill caller buffers with the results of the plain entry points") {
+    test_grid g(157, 131);
+    double *lo = const_cast<double*>(test_lo), *hi = const_cast<double*>(test_hi);
+
+    isoband_context *ctx = isoband_context_create();
+    for (int lines = 0; lines < 2; lines++) {
+      resultStruct *plain;
+      vector<int> lengths(test_n_bands);
+      if (lines) {
+        plain = isolines_impl(&g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], g.nrow, g.ncol, lo, test_n_bands);
+        isoband_context_isolines_sizes(ctx, &g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], g.nrow, g.ncol, lo, test_n_bands, &lengths[0]);
+      } else {
+        plain = isobands_impl(&g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], g.nrow, g.ncol, lo, hi, test_n_bands);
+        isoband_context_isobands_sizes(ctx, &g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], g.nrow, g.ncol, lo, hi, test_n_bands, &lengths[0]);
+      }
+
+      // fetch the levels in reverse, into buffers of the reported sizes followed by a
+      // sentinel that must stay untouched
+      vector<vector<double> > xs(test_n_bands), ys(test_n_bands);
+      vector<vector<int> > ids(test_n_bands);
+      vector<resultStruct> fetched(test_n_bands);
+      bool sentinels_kept = true;
+      for (int i = test_n_bands - 1; i >= 0; i--) {
+        xs[i].assign(lengths[i] + 1, -1);
+        ys[i].assign(lengths[i] + 1, -1);
+        ids[i].assign(lengths[i] + 1, -1);
+        if (isoband_context_fetch(ctx, i, &xs[i][0], &ys[i][0], &ids[i][0]) != 0) sentinels_kept = false;
+        if (xs[i].back() != -1 || ys[i].back() != -1 || ids[i].back() != -1) sentinels_kept = false;
+        resultStruct r = {&xs[i][0], &ys[i][0], &ids[i][0], lengths[i]};
+        fetched[i] = r;
+      }
+      expect_true(same_results(plain, &fetched[0], test_n_bands));
+      expect_true(sentinels_kept);
+
+      // there are no paths beyond the last level
+      double unused = -1;
+      int unused_id = -1;
+      expect_true(isoband_context_fetch(ctx, test_n_bands, &unused, &unused, &unused_id) != 0);
+      expect_true(string(isoband_last_error()).find("No paths for this level") != string::npos);
+      expect_true(unused == -1 && unused_id == -1);
+
+      isoband_free_results(plain, test_n_bands);
+    }
+    isoband_context_destroy(ctx);
+  }
+}
@@ -0,0 +1,94 @@
+#include <testthat.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "isoband.h"
+#include "test-results.h"
+
+// writes size bytes of data to path, after a header
+static void write_file(const char *path, const string &header, const void *data, size_t size) {
+  FILE *f = fopen(path, "wb");
+  fwrite(header.data(), 1, header.size(), f);
+  fwrite(data, 1, size, f);
+  fclose(f);
+}
+
+// a version 1.0 .npy header for a C-order float32 array of nrow x ncol values, in the byte
+// order of the machine
+static string npy_header(int nrow, int ncol) {
+  string dict = "{'descr': '=f4', 'fortran_order': False, 'shape': (" + to_string(nrow) + ", " + to_string(ncol) + "), }";
+  size_t len = (10 + dict.size() + 1 + 63) / 64 * 64 - 10;
+  dict.append(len - dict.size() - 1, ' ');
+  dict += '\n';
+  return string("\x93NUMPY\x01\x00", 8) + char(len & 255) + char(len >> 8) + dict;
+}
+
+context("Grid files") {
+  test_that("grid files give the results of the in-memory entry points") {
+    test_grid g(157, 131);
+    double *lo = const_cast<double*>(test_lo), *hi = const_cast<double*>(test_hi);
+    const char *path = "isoband-test-grid";
+
+    // a raw column-major file of doubles after a 64-byte header, which is isobands_impl's grid
+    write_file(path, string(64, 'x'), &g.z[0], g.z.size() * sizeof(double));
+    isoband_grid_file *grid = isoband_grid_open_raw(path, 64, value_double, g.nrow, g.ncol, 0);
+    expect_true(grid != 0);
+    int nrow = 0, ncol = 0;
+    isoband_grid_size(grid, &nrow, &ncol);
+    expect_true(nrow == g.nrow && ncol == g.ncol);
+
+    resultStruct *bands = isobands_impl(&g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], g.nrow, g.ncol, lo, hi, test_n_bands);
+    resultStruct *file_bands = isoband_grid_isobands(grid, &g.x[0], g.ncol, &g.y[0], g.nrow, lo, hi, test_n_bands);
+    expect_true(same_results(bands, file_bands, test_n_bands));
+    resultStruct *lines = isolines_impl(&g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], g.nrow, g.ncol, lo, test_n_bands);
+    resultStruct *file_lines = isoband_grid_isolines(grid, &g.x[0], g.ncol, &g.y[0], g.nrow, lo, test_n_bands);
+    expect_true(same_results(lines, file_lines, test_n_bands));
+    isoband_free_results(file_lines, test_n_bands);
+    isoband_free_results(lines, test_n_bands);
+    isoband_free_results(file_bands, test_n_bands);
+    isoband_free_results(bands, test_n_bands);
+    isoband_grid_close(grid);
+
+    // a row-major .npy file of floats, which is the typed grid with row strides of ncol
+    vector<float> zf(g.z.size());
+    for (int r = 0; r < g.nrow; r++) {
+      for (int c = 0; c < g.ncol; c++) {
+        zf[r * g.ncol + c] = static_cast<float>(g.z[r + c * g.nrow]);
+      }
+    }
+    write_file(path, npy_header(g.nrow, g.ncol), &zf[0], zf.size() * sizeof(float));
+    grid = isoband_grid_open_npy(path);
+    expect_true(grid != 0);
+
+    bands = isobands_strided_impl(&g.x[0], g.ncol, &g.y[0], g.nrow, &zf[0], value_float, 0, 1, g.ncol, 1, g.nrow, g.ncol, lo, hi, test_n_bands);
+    file_bands = isoband_grid_isobands(grid, &g.x[0], g.ncol, &g.y[0], g.nrow, lo, hi, test_n_bands);
+    expect_true(same_results(bands, file_bands, test_n_bands));
+    lines = isolines_strided_impl(&g.x[0], g.ncol, &g.y[0], g.nrow, &zf[0], value_float, 0, 1, g.ncol, 1, g.nrow, g.ncol, lo, test_n_bands);
+    file_lines = isoband_grid_isolines(grid, &g.x[0], g.ncol, &g.y[0], g.nrow, lo, test_n_bands);
+    expect_true(same_results(lines, file_lines, test_n_bands));
+    isoband_free_results(file_lines, test_n_bands);
+    isoband_free_results(lines, test_n_bands);
+    isoband_free_results(file_bands, test_n_bands);
+    isoband_free_results(bands, test_n_bands);
+
+    // coordinates that don't fit the grid
+    expect_true(isoband_grid_isobands(grid, &g.x[0], g.ncol - 1, &g.y[0], g.nrow, lo, hi, test_n_bands) == 0);
+    expect_true(string(isoband_last_error()).find("must match the columns and rows") != string::npos);
+    isoband_grid_close(grid);
+
+    remove(path);
+  }
+
+  test_that("errors are reported through the return value") {
+    isoband_grid_file *grid = isoband_grid_open_npy("no-such-directory/grid.npy");
+    expect_true(grid == 0);
+    expect_true(string(isoband_last_error()).find("Cannot open grid file") != string::npos);
+
+    grid = isoband_grid_open_raw("no-such-directory/grid.bin", 0, value_double, 10, 10, 0);
+    expect_true(grid == 0);
+    expect_true(string(isoband_last_error()).find("Cannot open grid file") != string::npos);
+  }
+}
@@ -0,0 +1,28 @@
+#include <testthat.h>
+
+#include "isoband.h"
+#include "test-results.h"
+
+context("Parallel levels") {
+  test_that("levels evaluated on several threads match isobands_impl and isolines_impl") {
+    test_grid g(157, 131);
+    double *lo = const_cast<double*>(test_lo), *hi = const_cast<double*>(test_hi);
+    resultStruct *bands = isobands_impl(&g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], g.nrow, g.ncol, lo, hi, test_n_bands);
+    resultStruct *lines = isolines_impl(&g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], g.nrow, g.ncol, lo, test_n_bands);
+
+    // one thread, fewer threads than levels, more threads than levels, one per core
+    const int n_threads[] = {1, 3, 16, 0};
+    for (int k = 0; k < 4; k++) {
+      resultStruct *par_bands = isobands_impl_parallel(&g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], g.nrow, g.ncol, lo, hi, test_n_bands, n_threads[k]);
+      expect_true(same_results(bands, par_bands, test_n_bands));
+      resultStruct *par_lines = isolines_impl_parallel(&g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], g.nrow, g.ncol, lo, test_n_bands, n_threads[k]);
+      expect_true(same_results(lines, par_lines, test_n_bands));
+
+      isoband_free_results(par_lines, test_n_bands);
+      isoband_free_results(par_bands, test_n_bands);
+    }
+
+    isoband_free_results(lines, test_n_bands);
+    isoband_free_results(bands, test_n_bands);
+  }
+}
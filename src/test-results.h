@@ -0,0 +1,122 @@
+#ifndef TEST_RESULTS_H
+#define TEST_RESULTS_H
+
+// helpers for the Catch tests of the C interface
+
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <utility>
+
+#include "isoband.h"
+
+// a grid of nrow x ncol values with coordinates 0, 1, 2, ...: overlapping hills and
+// valleys, plateaus with values exactly on the test cutoffs, and a few NA values, so that
+// contours close, nest, run into the grid boundary and split at saddles
+struct test_grid {
+  int nrow, ncol;
+  std::vector<double> x, y, z;
+
+  test_grid(int nrow, int ncol) : nrow(nrow), ncol(ncol), x(ncol), y(nrow), z(nrow * ncol) {
+    for (int c = 0; c < ncol; c++) x[c] = c;
+    for (int r = 0; r < nrow; r++) y[r] = 0.5 * r;
+    for (int c = 0; c < ncol; c++) {
+      for (int r = 0; r < nrow; r++) {
+        double v = 3 * sin(r * 0.11) * cos(c * 0.07) + sin(r * 0.37 + c * 0.23);
+        if ((r / 9 + c / 7) % 5 == 0) v = floor(v + 0.5);
+        if ((r * 31 + c * 17) % 211 == 0) v = std::numeric_limits<double>::quiet_NaN();
+        z[r + c * nrow] = v;
+      }
+    }
+  }
+};
+
+// band and line cutoffs for test grids; enough of them that the engines classify through
+// level ranks
+const int test_n_bands = 9;
+const double test_lo[test_n_bands] = {-4, -3, -2, -1, -0.5, 0, 0.5, 1, 2};
+const double test_hi[test_n_bands] = {-3, -2, -1, -0.5, 0, 0.5, 1, 2, 4};
+
+// whether the n results in a and b have the same points, in the same order
+inline bool same_results(const resultStruct *a, const resultStruct *b, int n) {
+  for (int i = 0; i < n; i++) {
+    if (a[i].len != b[i].len) return false;
+    size_t len = a[i].len;
+    if (memcmp(a[i].x, b[i].x, len * sizeof(double)) != 0 ||
+        memcmp(a[i].y, b[i].y, len * sizeof(double)) != 0 ||
+        memcmp(a[i].id, b[i].id, len * sizeof(int)) != 0) return false;
+  }
+  return true;
+}
+
+// the rings of a result, each in its smallest rotation, in sorted order
+inline std::vector<std::vector<std::pair<double, double> > > sorted_rings(const resultStruct &res) {
+  std::vector<std::vector<std::pair<double, double> > > rings;
+  for (int i = 0; i < res.len; i++) {
+    if (i == 0 || res.id[i] != res.id[i - 1]) rings.push_back(std::vector<std::pair<double, double> >());
+    rings.back().push_back(std::make_pair(res.x[i], res.y[i]));
+  }
+  // a ring may pass through a point twice, so take the smallest of its rotations
+  for (size_t k = 0; k < rings.size(); k++) {
+    std::vector<std::pair<double, double> > rotated = rings[k];
+    for (size_t i = 1; i < rotated.size(); i++) {
+      std::rotate(rotated.begin(), rotated.begin() + 1, rotated.end());
+      if (rotated < rings[k]) rings[k] = rotated;
+    }
+  }
+  std::sort(rings.begin(), rings.end());
+  return rings;
+}
+
+// whether the n results in a and b have the same rings, in any order and each starting at
+// any of its points
+inline bool same_rings(const resultStruct *a, const resultStruct *b, int n) {
+  for (int i = 0; i < n; i++) {
+    if (sorted_rings(a[i]) != sorted_rings(b[i])) return false;
+  }
+  return true;
+}
+
+// the lines of a result in sorted order, each in the smaller of its two directions; a
+// closed line, which repeats its first point at the end, starts at the point and heads in
+// the direction that makes it smallest
+inline std::vector<std::vector<std::pair<double, double> > > sorted_lines(const resultStruct &res) {
+  typedef std::vector<std::pair<double, double> > line;
+  std::vector<line> lines;
+  for (int i = 0; i < res.len; i++) {
+    if (i == 0 || res.id[i] != res.id[i - 1]) lines.push_back(line());
+    lines.back().push_back(std::make_pair(res.x[i], res.y[i]));
+  }
+  for (size_t k = 0; k < lines.size(); k++) {
+    line forward = lines[k], backward(forward.rbegin(), forward.rend());
+    if (forward.size() > 1 && forward.front() == forward.back()) {
+      forward.pop_back();
+      backward.pop_back();
+      line best = std::min(forward, backward);
+      for (size_t i = 1; i < forward.size(); i++) {
+        std::rotate(forward.begin(), forward.begin() + 1, forward.end());
+        std::rotate(backward.begin(), backward.begin() + 1, backward.end());
+        best = std::min(best, std::min(forward, backward));
+      }
+      best.push_back(best.front());
+      lines[k] = best;
+    } else {
+      lines[k] = std::min(forward, backward);
+    }
+  }
+  std::sort(lines.begin(), lines.end());
+  return lines;
+}
+
+// whether the n results in a and b have the same lines, in any order and direction, and
+// closed lines starting at any of their points
+inline bool same_lines(const resultStruct *a, const resultStruct *b, int n) {
+  for (int i = 0; i < n; i++) {
+    if (sorted_lines(a[i]) != sorted_lines(b[i])) return false;
+  }
+  return true;
+}
+
+#endif // TEST_RESULTS_H
@@ -0,0 +1,62 @@
+#include <testthat.h>
+
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+using namespace std;
+
+#include "isoband.h"
+#include "polygon.h"
+
+context("Ring-offset layout") {
+  test_that("nested and sibling rings are grouped into polygons") {
+    // blocks x blocks square targets side by side, each a set of concentric square
+    // annuli: grid points at odd Chebyshev distance d < m from the block center lie in the
+    // band, so every block has m / 2 annuli nested inside one another, each a polygon
+    // with one hole
+    const int blocks = 20, m = 8, size = 2 * m + 1, n = blocks * size;
+    vector<double> x(n), y(n), z(n * n);
+    for (int i = 0; i < n; i++) {
+      x[i] = i;
+      y[i] = i;
+    }
+    for (int r = 0; r < n; r++) {
+      for (int c = 0; c < n; c++) {
+        int d = max(abs(r % size - m), abs(c % size - m));
+        z[r + c * n] = d % 2;
+      }
+    }
+    double lo = 0.5, hi = 1.5;
+
+    ringResultStruct *res = isobands_rings_impl(&x[0], n, &y[0], n, &z[0], n, n, &lo, &hi, 1, 1);
+    const ringResultStruct &rr = res[0];
+    expect_true(rr.n_polygons == blocks * blocks * m / 2);
+    expect_true(rr.n_rings == 2 * rr.n_polygons);
+
+    bool all_holes_inside = true;
+    for (int j = 0; j < rr.n_polygons; j++) {
+      if (rr.polygon_offsets[j + 1] - rr.polygon_offsets[j] != 2) {
+        all_holes_inside = false;
+        continue;
+      }
+      int outer = rr.polygon_offsets[j], hole = outer + 1;
+      int o0 = rr.ring_offsets[outer], n_outer = rr.ring_offsets[outer + 1] - o0;
+      for (int i = rr.ring_offsets[hole]; i < rr.ring_offsets[hole + 1]; i++) {
+        if (point_in_ring(point(rr.x[i], rr.y[i]), rr.x + o0, rr.y + o0, n_outer) != inside) {
+          all_holes_inside = false;
+        }
+      }
+    }
+    expect_true(all_holes_inside);
+    expect_true(rr.polygon_offsets[rr.n_polygons] == rr.n_rings);
+
+    // the same rings as without grouping
+    ringResultStruct *flat = isobands_rings_impl(&x[0], n, &y[0], n, &z[0], n, n, &lo, &hi, 1, 0);
+    expect_true(flat[0].n_rings == rr.n_rings);
+    expect_true(flat[0].len == rr.len);
+    expect_true(flat[0].polygon_offsets == 0);
+
+    isoband_free_ring_results(flat, 1);
+    isoband_free_ring_results(res, 1);
+  }
+}
@@ -0,0 +1,124 @@
+#include <testthat.h>
+
+#include <vector>
+#include <cmath>
+#include <string>
+using namespace std;
+
+#include "isoband.h"
+#include "test-results.h"
+
+// the rings of a stream of n_bands bands, taken after every push
+struct taken_rings {
+  vector<vector<double> > x, y;
+  vector<vector<int> > id;
+
+  explicit taken_rings(int n_bands) : x(n_bands), y(n_bands), id(n_bands) {}
+
+  void take(isoband_stream *stream) {
+    resultStruct *res = isoband_stream_take(stream);
+    for (size_t i = 0; i < x.size(); i++) {
+      x[i].insert(x[i].end(), res[i].x, res[i].x + res[i].len);
+      y[i].insert(y[i].end(), res[i].y, res[i].y + res[i].len);
+      id[i].insert(id[i].end(), res[i].id, res[i].id + res[i].len);
+    }
+    isoband_free_results(res, x.size());
+  }
+
+  // the rings of all pushes, as results pointing into this
+  vector<resultStruct> results() {
+    vector<resultStruct> res(x.size());
+    for (size_t i = 0; i < x.size(); i++) {
+      resultStruct r = {x[i].data(), y[i].data(), id[i].data(), static_cast<int>(x[i].size())};
+      res[i] = r;
+    }
+    return res;
+  }
+};
+
+context("Streamed grids") {
+  test_that("streamed strips give the bands of the whole grid") {
+    test_grid g(157, 131);
+    double *lo = const_cast<double*>(test_lo), *hi = const_cast<double*>(test_hi);
+    resultStruct *bands = isobands_impl(&g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], g.nrow, g.ncol, lo, hi, test_n_bands);
+    resultStruct *swept = isobands_sweep_impl(&g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], g.nrow, g.ncol, lo, hi, test_n_bands);
+
+    // strips of 2 to 11 rows, pushed straight from the column-major grid
+    isoband_stream *stream = isoband_stream_create(&g.x[0], g.ncol, &g.y[0], g.nrow, value_double, 0, 1, lo, hi, test_n_bands, 0);
+    taken_rings taken(test_n_bands);
+    for (int r0 = 0, k = 0; r0 < g.nrow - 1; k++) {
+      int n_rows = min(2 + k % 10, g.nrow - r0);
+      expect_true(isoband_stream_push(stream, &g.z[r0], n_rows, 1, g.nrow) == stream_ok);
+      taken.take(stream);
+      r0 += n_rows - 1;
+    }
+    isoband_stream_destroy(stream);
+    expect_true(same_results(swept, &taken.results()[0], test_n_bands));
+    expect_true(same_rings(bands, &taken.results()[0], test_n_bands));
+
+    // row-major strips of 30 rows of floats
+    vector<float> zf(g.z.size());
+    for (int r = 0; r < g.nrow; r++) {
+      for (int c = 0; c < g.ncol; c++) {
+        zf[r * g.ncol + c] = static_cast<float>(g.z[r + c * g.nrow]);
+      }
+    }
+    resultStruct *float_bands = isobands_strided_impl(&g.x[0], g.ncol, &g.y[0], g.nrow, &zf[0], value_float, 0, 1, g.ncol, 1, g.nrow, g.ncol, lo, hi, test_n_bands);
+    stream = isoband_stream_create(&g.x[0], g.ncol, &g.y[0], g.nrow, value_float, 0, 1, lo, hi, test_n_bands, 0);
+    taken_rings float_taken(test_n_bands);
+    for (int r0 = 0; r0 < g.nrow - 1; ) {
+      int n_rows = min(30, g.nrow - r0);
+      expect_true(isoband_stream_push(stream, &zf[r0 * g.ncol], n_rows, g.ncol, 1) == stream_ok);
+      float_taken.take(stream);
+      r0 += n_rows - 1;
+    }
+    isoband_stream_destroy(stream);
+    expect_true(same_rings(float_bands, &float_taken.results()[0], test_n_bands));
+
+    isoband_free_results(float_bands, test_n_bands);
+    isoband_free_results(swept, test_n_bands);
+    isoband_free_results(bands, test_n_bands);
+  }
+
+  test_that("pushes report errors as a status") {
+    const int n = 200;
+    vector<double> x(n), y(n), z(n * n);
+    for (int i = 0; i < n; i++) {
+      x[i] = i;
+      y[i] = i;
+    }
+    for (int r = 0; r < n; r++) {
+      for (int c = 0; c < n; c++) {
+        z[r + c * n] = sin(r * 0.3) * cos(c * 0.3);
+      }
+    }
+    double lo = 0, hi = 0.5;
+
+    expect_true(isoband_stream_create(&x[0], n, &y[0], n, value_double, 0, 1, &lo, &hi, 1, -1) == 0);
+    expect_true(string(isoband_last_error()) == "Memory budget must not be negative.");
+
+    // a rejected strip leaves the stream as it was
+    isoband_stream *stream = isoband_stream_create(&x[0], n, &y[0], n, value_double, 0, 1, &lo, &hi, 1, 0);
+    expect_true(isoband_stream_push(stream, &z[0], n + 1, 1, n) == stream_rejected);
+    expect_true(isoband_stream_push(stream, &z[0], n, 0, n) == stream_rejected);
+    expect_true(isoband_stream_push(stream, &z[0], n, 1, n) == stream_ok);
+    expect_true(isoband_stream_push(stream, &z[0], 2, 1, n) == stream_rejected);
+    resultStruct *taken = isoband_stream_take(stream);
+    resultStruct *swept = isobands_sweep_impl(&x[0], n, &y[0], n, &z[0], n, n, &lo, &hi, 1);
+    expect_true(taken[0].len == swept[0].len);
+    isoband_free_results(swept, 1);
+    isoband_free_results(taken, 1);
+    isoband_stream_destroy(stream);
+
+    // a stream over its budget fails, but keeps the rings closed so far
+    stream = isoband_stream_create(&x[0], n, &y[0], n, value_double, 0, 1, &lo, &hi, 1, 20000);
+    expect_true(isoband_stream_push(stream, &z[0], n / 2, 1, n) == stream_failed);
+    expect_true(string(isoband_last_error()) == "Open contours exceed the memory budget of the stream.");
+    expect_true(isoband_stream_strip_rows(stream) == 0);
+    expect_true(isoband_stream_push(stream, &z[n / 2 - 1], 2, 1, n) == stream_failed);
+    taken = isoband_stream_take(stream);
+    expect_true(taken[0].len > 0);
+    isoband_free_results(taken, 1);
+    isoband_stream_destroy(stream);
+  }
+}
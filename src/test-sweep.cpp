@@ -0,0 +1,48 @@
+#include <testthat.h>
+
+#include <vector>
+#include <cmath>
+using namespace std;
+
+#include "isoband.h"
+#include "test-results.h"
+
+context("Sweeping engines") {
+  test_that("the isoline sweep gives the lines of isolines_impl") {
+    // grids narrower and wider than a word of packed columns
+    test_grid grids[] = {test_grid(157, 131), test_grid(40, 30), test_grid(3, 200)};
+    double *lo = const_cast<double*>(test_lo);
+
+    for (int k = 0; k < 3; k++) {
+      test_grid &g = grids[k];
+      resultStruct *lines = isolines_impl(&g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], g.nrow, g.ncol, lo, test_n_bands);
+      resultStruct *swept = isolines_sweep_impl(&g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], g.nrow, g.ncol, lo, test_n_bands);
+      expect_true(same_lines(lines, swept, test_n_bands));
+
+      isoband_free_results(swept, test_n_bands);
+      isoband_free_results(lines, test_n_bands);
+    }
+  }
+
+  test_that("the isoline sweep closes loops and ends lines at the grid boundary") {
+    const int n = 60;
+    vector<double> x(n), y(n), z(n * n);
+    for (int i = 0; i < n; i++) {
+      x[i] = i;
+      y[i] = i;
+    }
+    for (int r = 0; r < n; r++) {
+      for (int c = 0; c < n; c++) {
+        z[r + c * n] = sin(r * 0.2) * cos(c * 0.15) + 0.01 * c;
+      }
+    }
+    double values[] = {-0.5, 0, 0.5};
+
+    resultStruct *lines = isolines_impl(&x[0], n, &y[0], n, &z[0], n, n, values, 3);
+    resultStruct *swept = isolines_sweep_impl(&x[0], n, &y[0], n, &z[0], n, n, values, 3);
+    expect_true(same_lines(lines, swept, 3));
+
+    isoband_free_results(swept, 3);
+    isoband_free_results(lines, 3);
+  }
+}
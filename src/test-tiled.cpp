@@ -0,0 +1,32 @@
+#include <testthat.h>
+
+#include "isoband.h"
+#include "test-results.h"
+
+context("Tiled contours") {
+  test_that("contours stitched from column tiles match isobands_impl and isolines_impl") {
+    // a wide grid, and one narrower than the number of tiles of some of the runs
+    test_grid grids[] = {test_grid(157, 131), test_grid(60, 5)};
+    double *lo = const_cast<double*>(test_lo), *hi = const_cast<double*>(test_hi);
+
+    for (int k = 0; k < 2; k++) {
+      test_grid &g = grids[k];
+      resultStruct *bands = isobands_impl(&g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], g.nrow, g.ncol, lo, hi, test_n_bands);
+      resultStruct *lines = isolines_impl(&g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], g.nrow, g.ncol, lo, test_n_bands);
+
+      const int n_threads[] = {1, 2, 3, 7, 0};
+      for (int t = 0; t < 5; t++) {
+        resultStruct *tiled_bands = isobands_impl_tiled(&g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], g.nrow, g.ncol, lo, hi, test_n_bands, n_threads[t]);
+        expect_true(same_results(bands, tiled_bands, test_n_bands));
+        resultStruct *tiled_lines = isolines_impl_tiled(&g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], g.nrow, g.ncol, lo, test_n_bands, n_threads[t]);
+        expect_true(same_results(lines, tiled_lines, test_n_bands));
+
+        isoband_free_results(tiled_lines, test_n_bands);
+        isoband_free_results(tiled_bands, test_n_bands);
+      }
+
+      isoband_free_results(lines, test_n_bands);
+      isoband_free_results(bands, test_n_bands);
+    }
+  }
+}
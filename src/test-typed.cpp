@@ -0,0 +1,56 @@
+#include <testthat.h>
+
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "isoband.h"
+#include "test-results.h"
+
+context("Typed and strided grids") {
+  test_that("a row-major window gives the results of isobands_impl and isolines_impl") {
+    test_grid g(57, 43);
+    double *lo = const_cast<double*>(test_lo), *hi = const_cast<double*>(test_hi);
+
+    // the grid as a window into a larger row-major array, two rows and three columns in
+    const int prow = g.nrow + 4, pcol = g.ncol + 5;
+    vector<double> parent(prow * pcol, 0);
+    for (int r = 0; r < g.nrow; r++) {
+      for (int c = 0; c < g.ncol; c++) {
+        parent[(r + 2) * pcol + c + 3] = g.z[r + c * g.nrow];
+      }
+    }
+    const double *window = &parent[2 * pcol + 3];
+
+    resultStruct *bands = isobands_impl(&g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], g.nrow, g.ncol, lo, hi, test_n_bands);
+    resultStruct *strided_bands = isobands_strided_impl(&g.x[0], g.ncol, &g.y[0], g.nrow, window, value_double, 0, 1, pcol, 1, g.nrow, g.ncol, lo, hi, test_n_bands);
+    expect_true(same_results(bands, strided_bands, test_n_bands));
+
+    resultStruct *lines = isolines_impl(&g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], g.nrow, g.ncol, lo, test_n_bands);
+    resultStruct *strided_lines = isolines_strided_impl(&g.x[0], g.ncol, &g.y[0], g.nrow, window, value_double, 0, 1, pcol, 1, g.nrow, g.ncol, lo, test_n_bands);
+    expect_true(same_results(lines, strided_lines, test_n_bands));
+
+    isoband_free_results(strided_lines, test_n_bands);
+    isoband_free_results(lines, test_n_bands);
+    isoband_free_results(strided_bands, test_n_bands);
+    isoband_free_results(bands, test_n_bands);
+  }
+
+  test_that("errors are reported through the return value") {
+    test_grid g(10, 10);
+    double *lo = const_cast<double*>(test_lo), *hi = const_cast<double*>(test_hi);
+    vector<short> zi(g.nrow * g.ncol, 0);
+
+    expect_true(isobands_typed_impl(&g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], 7, 0, 1, g.nrow, g.ncol, lo, hi, test_n_bands) == 0);
+    expect_true(string(isoband_last_error()) == "Unknown type of grid values.");
+
+    expect_true(isolines_typed_impl(&g.x[0], g.ncol, &g.y[0], g.nrow, &zi[0], value_int16, 0, -1, g.nrow, g.ncol, lo, test_n_bands) == 0);
+    expect_true(string(isoband_last_error()).find("finite, positive scale") != string::npos);
+
+    expect_true(isobands_strided_impl(&g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], value_double, 0, 1, 0, g.nrow, g.nrow, g.ncol, lo, hi, test_n_bands) == 0);
+    expect_true(string(isoband_last_error()) == "Grid strides must not be zero.");
+
+    expect_true(isolines_strided_impl(&g.x[0], g.ncol, &g.y[0], g.nrow, &g.z[0], 9, 0, 1, 1, g.nrow, g.nrow, g.ncol, lo, test_n_bands) == 0);
+    expect_true(string(isoband_last_error()) == "Unknown type of grid values.");
+  }
+}